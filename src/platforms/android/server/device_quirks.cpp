@@ -47,6 +47,9 @@ char const* const gralloc_cannot_be_closed_safely_opt = "enable-gralloc-cannot-b
 char const* const width_alignment_opt = "enable-width-alignment-quirk";
 char const* const fb_ion_heap_opt = "fb-ion-heap";
 char const* const working_egl_sync_opt = "use-eglsync-quirk";
+char const* const composition_search_budget_opt = "hwc-composition-search-budget";
+char const* const pipelined_commit_opt = "hwc-pipelined-commit";
+char const* const idle_refresh_opt = "hwc-idle-refresh";
 std::string const egl_sync_default = "default";
 std::string const egl_sync_force_on = "force_on";
 std::string const egl_sync_force_off = "force_off";
@@ -162,7 +165,10 @@ mga::DeviceQuirks::DeviceQuirks(
       enable_width_alignment_quirk{true},
       clear_fb_context_fence_{clear_fb_context_fence_for(device_name)},
       fb_ion_heap_{device_has_fb_ion_heap(device_name, true)},
-      working_egl_sync_{device_has_working_egl_sync(gpu_info, egl_sync_default)}
+      working_egl_sync_{device_has_working_egl_sync(gpu_info, egl_sync_default)},
+      composition_search_budget_{0},
+      pipelined_commit_{false},
+      idle_refresh_time_{0}
 {
 }
 
@@ -180,7 +186,10 @@ mga::DeviceQuirks::DeviceQuirks(PropertiesWrapper const& properties, mo::Option
       clear_fb_context_fence_{clear_fb_context_fence_for(device_name)},
       fb_ion_heap_{device_has_fb_ion_heap(device_name, options.get(fb_ion_heap_opt, true))},
       working_egl_sync_{device_has_working_egl_sync(
-        gpu_info, options.get(working_egl_sync_opt, egl_sync_default.c_str()))}
+        gpu_info, options.get(working_egl_sync_opt, egl_sync_default.c_str()))},
+      composition_search_budget_{options.get(composition_search_budget_opt, 0)},
+      pipelined_commit_{options.get(pipelined_commit_opt, false)},
+      idle_refresh_time_{options.get(idle_refresh_opt, 0)}
 {
 }
 
@@ -219,6 +228,21 @@ bool mga::DeviceQuirks::working_egl_sync() const
     return working_egl_sync_;
 }
 
+std::chrono::microseconds mga::DeviceQuirks::composition_search_budget() const
+{
+    return composition_search_budget_;
+}
+
+bool mga::DeviceQuirks::pipelined_commit() const
+{
+    return pipelined_commit_;
+}
+
+std::chrono::milliseconds mga::DeviceQuirks::idle_refresh_time() const
+{
+    return idle_refresh_time_;
+}
+
 void mga::DeviceQuirks::add_options(boost::program_options::options_description& config)
 {
     config.add_options()
@@ -236,5 +260,17 @@ void mga::DeviceQuirks::add_options(boost::program_options::options_description&
           "[platform-specific] device has ion heap for framebuffer allocation available [{true, false}]")
          (working_egl_sync_opt,
           boost::program_options::value<std::string>()->default_value(egl_sync_default),
-          "[platform-specific] use KHR_reusable_sync extension [{default, force_on, force_off}]");
+          "[platform-specific] use KHR_reusable_sync extension [{default, force_on, force_off}]")
+         (composition_search_budget_opt,
+          boost::program_options::value<int>()->default_value(0),
+          "[platform-specific] microseconds per frame to spend looking for the hwc composition with the least "
+          "gl composition, 0 to accept the first one [{0-16000}]")
+         (pipelined_commit_opt,
+          boost::program_options::value<bool>()->default_value(false),
+          "[platform-specific] call hwc set() on a commit thread, overlapping the composition of the next "
+          "frame [{true,false}]")
+         (idle_refresh_opt,
+          boost::program_options::value<int>()->default_value(0),
+          "[platform-specific] milliseconds without a frame posted before a display drops to its lowest "
+          "refresh rate, 0 to stay at the configured rate [{0-5000}]");
 }
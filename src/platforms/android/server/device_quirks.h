@@ -21,6 +21,7 @@
 
 #include <hybris/properties/properties.h>
 #include <string>
+#include <chrono>
 
 namespace boost{ namespace program_options {class options_description;}}
 
@@ -73,6 +74,12 @@ public:
     bool clear_fb_context_fence() const;
     int fb_gralloc_bits() const;
     bool working_egl_sync() const;
+    //time allowed per frame for trying out different hwc compositions, zero if disabled
+    std::chrono::microseconds composition_search_budget() const;
+    //true if the hwc set() may run on a thread of its own, while the next frame is composited
+    bool pipelined_commit() const;
+    //time without frames before a display idles at its lowest refresh rate, zero if disabled
+    std::chrono::milliseconds idle_refresh_time() const;
 
     static void add_options(boost::program_options::options_description& config);
 
@@ -88,6 +95,9 @@ private:
     bool const clear_fb_context_fence_;
     bool const fb_ion_heap_;
     bool const working_egl_sync_; 
+    std::chrono::microseconds const composition_search_budget_;
+    bool const pipelined_commit_;
+    std::chrono::milliseconds const idle_refresh_time_;
 };
 }
 }
@@ -30,6 +30,7 @@
 #include "server_render_window.h"
 #include "display_buffer.h"
 #include "hwc_layerlist.h"
+#include "hwc_cursor.h"
 #include "mir_native_window.h"
 #include "mir/geometry/rectangle.h"
 #include "mir/graphics/event_handler_register.h"
@@ -37,6 +38,7 @@
 #include "mir/fd.h"
 
 #include <memory>
+#include <cmath>
 #include <boost/throw_exception.hpp>
 #include <fcntl.h>
 
@@ -110,6 +112,18 @@ void set_powermode_all_displays(
         power_mode_safe(mga::DisplayName::external, control, config.external(), intended_mode); 
 }
 
+//displays with the same refresh rate reach their deadlines together, so share one set()
+bool independent_cadence(mga::DisplayConfiguration& config)
+{
+    auto const& primary = config.primary();
+    auto const& external = config.external();
+    if (!external.connected || primary.modes.empty() || external.modes.empty())
+        return false;
+    auto const primary_hz = primary.modes[primary.current_mode_index].vrefresh_hz;
+    auto const external_hz = external.modes[external.current_mode_index].vrefresh_hz;
+    return std::abs(primary_hz - external_hz) > 0.5;
+}
+
 std::unique_ptr<mga::ConfigurableDisplayBuffer> create_display_buffer(
     std::shared_ptr<mga::DisplayDevice> const& display_device,
     mga::DisplayName name,
@@ -118,7 +132,8 @@ std::unique_ptr<mga::ConfigurableDisplayBuffer> create_display_buffer(
     std::shared_ptr<mgl::ProgramFactory> const& gl_program_factory,
     mga::PbufferGLContext const& gl_context,
     std::shared_ptr<mga::NativeWindowReport> const& report,
-    mga::OverlayOptimization overlay_option)
+    mga::OverlayOptimization overlay_option,
+    std::shared_ptr<mga::HwcCursor> const& cursor)
 {
     std::shared_ptr<mga::FramebufferBundle> fbs{display_buffer_builder.create_framebuffers(config)};
     auto cache = std::make_shared<mga::InterpreterCache>();
@@ -135,7 +150,8 @@ std::unique_ptr<mga::ConfigurableDisplayBuffer> create_display_buffer(
         *gl_program_factory,
         mg::transformation(config.orientation),
         config.extents(),
-        overlay_option));
+        overlay_option,
+        cursor));
 }
 }
 
@@ -150,11 +166,6 @@ mga::Display::Display(
     native_window_report{native_window_report},
     display_buffer_builder{display_buffer_builder},
     hwc_config{display_buffer_builder->create_hwc_configuration()},
-    hotplug_subscription{hwc_config->subscribe_to_config_changes(
-        std::bind(&mga::Display::on_hotplug, this),
-        std::bind(&mga::Display::on_vsync, this,
-                                           std::placeholders::_1,
-                                           std::placeholders::_2))},
     config(
         hwc_config->active_config_for(mga::DisplayName::primary),
         mir_power_mode_off,
@@ -162,6 +173,7 @@ mga::Display::Display(
         mir_power_mode_off),
     gl_context{config.primary().current_format, *gl_config, *display_report},
     display_device(display_buffer_builder->create_display_device()),
+    cursor(display_buffer_builder->create_cursor()),
     display_change_pipe(new DisplayChangePipe),
     gl_program_factory(gl_program_factory),
     displays(
@@ -174,9 +186,16 @@ mga::Display::Display(
             gl_program_factory,
             gl_context,
             native_window_report,
-            overlay_option),
-            [this] { on_hotplug(); }), //Recover from exception by forcing a configuration change
-    overlay_option(overlay_option)
+            overlay_option,
+            cursor),
+            [this] { on_hotplug(); }, //Recover from exception by forcing a configuration change
+            [this](DisplayName name, unsigned int frames) { hwc_config->request_vsync(name, frames); }),
+    overlay_option(overlay_option),
+    hotplug_subscription{hwc_config->subscribe_to_config_changes(
+        std::bind(&mga::Display::on_hotplug, this),
+        std::bind(&mga::Display::on_vsync, this,
+                                           std::placeholders::_1,
+                                           std::placeholders::_2))}
 {
     //Some drivers (depending on kernel state) incorrectly report an error code indicating that the display is already on. Ignore the first failure.
     set_powermode_all_displays(*hwc_config, config, mir_power_mode_on);
@@ -192,8 +211,12 @@ mga::Display::Display(
                 gl_program_factory,
                 gl_context,
                 native_window_report,
-                overlay_option));
+                overlay_option,
+                cursor));
     }
+    displays.set_independent_cadence(independent_cadence(config));
+    display_device->subscribe_to_presentation(
+        std::bind(&mga::Display::on_presented, this, std::placeholders::_1, std::placeholders::_2));
 
     display_report->report_successful_setup_of_native_resources();
 
@@ -205,6 +228,7 @@ mga::Display::Display(
 
 mga::Display::~Display() noexcept
 {
+    display_device->subscribe_to_presentation({});
     set_powermode_all_displays(*hwc_config, config, mir_power_mode_off);
 }
 
@@ -231,7 +255,7 @@ void mga::Display::update_configuration(std::lock_guard<std::mutex> const&) cons
 void mga::Display::for_each_display_sync_group(std::function<void(mg::DisplaySyncGroup&)> const& f)
 {
     std::lock_guard<decltype(configuration_mutex)> lock{configuration_mutex};
-    f(displays);
+    displays.for_each_sync_group(f);
 }
 
 std::unique_ptr<mg::DisplayConfiguration> mga::Display::configuration() const
@@ -256,32 +280,82 @@ void mga::Display::on_hotplug()
     display_change_pipe->notify_change();
 }
 
+/* Vsync is only on while frames are being posted, so a gap between vsyncs is the frames that
+ * went by while it was off. They are counted as if they had been delivered. */
 void mga::Display::on_vsync(DisplayName name, mg::Frame::Timestamp timestamp)
 {
-    std::lock_guard<decltype(vsync_mutex)> lock{vsync_mutex};
-    /*
-     * XXX It's presently useful but idealistically inefficient that we
-     *     get a callback on every frame, even when the compositor is idle.
-     *     (LP: #1374318)
-     *     Although we possibly shouldn't fix that at all because the
-     *     call to increment_with_timestamp would produce incorrect MSC values
-     *     if it were to miss a physical frame. The X11 platform has that
-     *     problem already, but it's less important for production use than
-     *     Android.
-     */
-    auto& f = last_frame[as_output_id(name).as_value()];
-    f.increment_with_timestamp(timestamp);
-    display_report->report_vsync(as_output_id(name).as_value(), f.load());
+    auto& counter = frame_counters[as_hwc_display(name)];
+    mg::Frame frame;
+    {
+        std::lock_guard<decltype(vsync_mutex)> lock{vsync_mutex};
+        auto frames = counter.load();
+        auto const interval = timestamp.nanoseconds - frames.vsync.ust.nanoseconds;
+
+        int64_t vsyncs{1};
+        if (frames.vsync.msc != 0)
+        {
+            auto& period = vsync_periods[as_hwc_display(name)];
+            vsyncs = period.vsyncs_in(interval);
+            frames.period = period.period();
+        }
+
+        frames.vsync.msc += vsyncs;
+        frames.vsync.ust = timestamp;
+        counter.store(frames);
+        frame = frames.vsync;
+    }
+    display_report->report_vsync(as_output_id(name).as_value(), frame);
+    displays.on_vsync(name, frame);
+}
+
+/* The retire fence of a frame signals on the vsync that puts the frame on the display, and
+ * that vsync's callback can come either side of it. A present time clearly after the last
+ * vsync counted belongs to the next one. */
+void mga::Display::on_presented(DisplayName name, mg::Frame::Timestamp timestamp)
+{
+    auto& counter = frame_counters[as_hwc_display(name)];
+    auto const tolerance = std::chrono::milliseconds{2};
+    mg::Frame presented;
+    {
+        std::lock_guard<decltype(vsync_mutex)> lock{vsync_mutex};
+        auto frames = counter.load();
+        presented.ust = timestamp;
+        presented.msc = frames.vsync.msc;
+        if (timestamp.nanoseconds > frames.vsync.ust.nanoseconds + tolerance)
+            presented.msc++;
+        frames.presented = presented;
+        counter.store(frames);
+    }
+    display_report->report_vsync(as_output_id(name).as_value(), presented);
 }
 
 mg::Frame mga::Display::last_frame_on(unsigned output_id) const
 {
-    std::lock_guard<decltype(vsync_mutex)> lock{vsync_mutex};
-    auto last = last_frame.find(output_id);
-    if (last == last_frame.end())
+    //output ids are one more than the hwc display
+    if ((output_id == 0) || (output_id > frame_counters.size()))
+        return {};
+
+    auto const frames = frame_counters[output_id - 1].load();
+    if (frames.vsync.msc == 0)
          return {};  // Not an error. It might be a valid output_id pre-vsync
-    else
-         return last->second.load();
+
+    //where a frame was shown on the last vsync, its present time is the more accurate
+    auto frame = frames.vsync;
+    if (frames.presented.msc == frame.msc)
+        frame.ust = frames.presented.ust;
+
+    //while vsync is off, the frames since the last one are worked out from the period
+    if (frames.period.count() > 0)
+    {
+        auto const now = mg::Frame::Timestamp::now(CLOCK_MONOTONIC);
+        auto const vsyncs = (now.nanoseconds - frame.ust.nanoseconds) / frames.period;
+        if (vsyncs > 1)
+        {
+            frame.msc += vsyncs;
+            frame.ust.nanoseconds += frames.period * vsyncs;
+        }
+    }
+    return frame;
 }
 
 void mga::Display::register_configuration_change_handler(
@@ -312,9 +386,10 @@ void mga::Display::resume()
 {
 }
 
+//without a cursor layer, the cursor is composited with the other renderables
 auto mga::Display::create_hardware_cursor() -> std::shared_ptr<Cursor>
 {
-    return nullptr;
+    return cursor;
 }
 
 std::unique_ptr<mg::VirtualOutput> mga::Display::create_virtual_output(int width, int height)
@@ -354,9 +429,24 @@ bool mga::Display::apply_if_configuration_preserves_display_buffers(
      *
      * Take the configuration lock to ensure consistency between our checking for external
      * connections and configure's checking.
+     *
+     * A change to a mode of another size does need new display buffers.
      */
     std::lock_guard<decltype(configuration_mutex)> lock{configuration_mutex};
-    if (!config.external().connected || displays.display_present(mga::DisplayName::external))
+    bool resizes_display{false};
+    conf.for_each_output([&](mg::DisplayConfigurationOutput const& output)
+    {
+        if ((output.id != config.primary().id) && (output.id != config.external().id))
+            return;
+        auto const& current = config[output.id];
+        if ((output.current_mode_index != current.current_mode_index) &&
+            (output.current_mode_index < current.modes.size()) &&
+            (current.modes[output.current_mode_index].size != current.modes[current.current_mode_index].size))
+            resizes_display = true;
+    });
+
+    if (!resizes_display &&
+        (!config.external().connected || displays.display_present(mga::DisplayName::external)))
     {
         configure_locked(conf, lock);
         return true;
@@ -383,7 +473,8 @@ void mga::Display::configure_locked(
                 gl_program_factory,
                 gl_context,
                 native_window_report,
-                overlay_option));
+                overlay_option,
+                cursor));
     if ((!config.external().connected) && displays.display_present(mga::DisplayName::external))
         displays.remove(mga::DisplayName::external);
 
@@ -393,6 +484,9 @@ void mga::Display::configure_locked(
             if (output.current_format != config[output.id].current_format)
                 BOOST_THROW_EXCEPTION(std::logic_error("could not change display buffer format"));
 
+            if (output.current_mode_index != config[output.id].current_mode_index)
+                change_mode(output.id, output.current_mode_index);
+
             config[output.id].orientation = output.orientation;
             config[output.id].form_factor = output.form_factor;
             config[output.id].scale = output.scale;
@@ -411,4 +505,48 @@ void mga::Display::configure_locked(
                 displays.configure(mga::DisplayName::external, output.power_mode, transform, output.extents());
             }
         });
+    displays.set_independent_cadence(independent_cadence(config));
+}
+
+/* A mode of another size needs display buffers of that size */
+void mga::Display::change_mode(mg::DisplayConfigurationOutputId id, size_t mode_index)
+{
+    mga::DisplayName name;
+    if (config.primary().id == id)
+        name = mga::DisplayName::primary;
+    else if ((config.external().id == id) && config.external().connected)
+        name = mga::DisplayName::external;
+    else
+        BOOST_THROW_EXCEPTION(std::logic_error("could not change the mode of the display"));
+
+    auto& output = config[id];
+    if (mode_index >= output.modes.size())
+        BOOST_THROW_EXCEPTION(std::logic_error("invalid display mode"));
+
+    hwc_config->set_active_mode(name, mode_index);
+    {
+        //the new mode may refresh at another rate, which is learned again from its vsyncs
+        std::lock_guard<decltype(vsync_mutex)> lock{vsync_mutex};
+        auto& counter = frame_counters[as_hwc_display(name)];
+        auto frames = counter.load();
+        frames.period = std::chrono::nanoseconds{0};
+        counter.store(frames);
+        vsync_periods[as_hwc_display(name)].reset();
+    }
+    auto const resized = (output.modes[mode_index].size != output.modes[output.current_mode_index].size);
+    output.current_mode_index = mode_index;
+    if (resized)
+    {
+        displays.add(name,
+            create_display_buffer(
+                display_device,
+                name,
+                *display_buffer_builder,
+                output,
+                gl_program_factory,
+                gl_context,
+                native_window_report,
+                overlay_option,
+                cursor));
+    }
 }
@@ -21,18 +21,19 @@
 
 #include "mir/graphics/display.h"
 #include "mir/graphics/frame.h"
-#include "mir/graphics/atomic_frame.h"
 #include "mir/renderer/gl/context_source.h"
 #include "gl_context.h"
 #include "display_group.h"
 #include "hwc_configuration.h"
 #include "display_configuration.h"
 #include "overlay_optimization.h"
+#include "frame_counter.h"
+#include "vsync_period.h"
 
 #include <memory>
 #include <mutex>
 #include <array>
-#include <unordered_map>
+#include <chrono>
 
 namespace mir
 {
@@ -51,6 +52,7 @@ class ConfigurableDisplayBuffer;
 class DisplayChangePipe;
 class DisplayDevice;
 class NativeWindowReport;
+class HwcCursor;
 
 class Display : public graphics::Display,
                 public graphics::NativeDisplay,
@@ -96,6 +98,7 @@ public:
 private:
     void on_hotplug();
     void on_vsync(DisplayName, graphics::Frame::Timestamp);
+    void on_presented(DisplayName, graphics::Frame::Timestamp);
 
     std::shared_ptr<DisplayReport> const display_report;
     std::shared_ptr<NativeWindowReport> const native_window_report;
@@ -103,10 +106,10 @@ private:
     std::mutex mutable configuration_mutex;
     bool mutable configuration_dirty{false};
     std::unique_ptr<HwcConfiguration> const hwc_config;
-    ConfigChangeSubscription const hotplug_subscription;
     DisplayConfiguration mutable config;
     PbufferGLContext gl_context;
     std::shared_ptr<DisplayDevice> display_device;
+    std::shared_ptr<HwcCursor> const cursor;
     std::unique_ptr<DisplayChangePipe> display_change_pipe;
     std::shared_ptr<gl::ProgramFactory> const gl_program_factory;
     DisplayGroup mutable displays;
@@ -116,9 +119,16 @@ private:
     void configure_locked(
         graphics::DisplayConfiguration const& new_configuration,
         std::lock_guard<decltype(configuration_mutex)> const&);
+    void change_mode(DisplayConfigurationOutputId id, size_t mode_index);
+
+    //serializes the vsync and present times coming in. last_frame_on() does not wait for it.
+    std::mutex vsync_mutex;
+    std::array<VsyncPeriod, HWC_NUM_DISPLAY_TYPES> vsync_periods;
+    std::array<FrameCounter, HWC_NUM_DISPLAY_TYPES> frame_counters;
 
-    std::mutex mutable vsync_mutex;
-    std::unordered_map<unsigned,AtomicFrame> last_frame;
+    //the events come in on the hwc's threads, so they start after, and stop before,
+    //the members they reach are there
+    ConfigChangeSubscription const hotplug_subscription;
 };
 
 }
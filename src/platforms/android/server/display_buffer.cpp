@@ -21,6 +21,7 @@
 #include "display_buffer.h"
 #include "display_device.h"
 #include "hwc_layerlist.h"
+#include "hwc_cursor.h"
 
 #include <boost/throw_exception.hpp>
 #include <stdexcept>
@@ -43,6 +44,23 @@ mga::DisplayBuffer::DisplayBuffer(
     glm::mat2 const& transform,
     geom::Rectangle area,
     mga::OverlayOptimization overlay_option)
+    : DisplayBuffer(display_name, std::move(layer_list), fb_bundle, display_device, native_window,
+                    shared_gl_context, program_factory, transform, area, overlay_option, nullptr)
+{
+}
+
+mga::DisplayBuffer::DisplayBuffer(
+    mga::DisplayName display_name,
+    std::unique_ptr<LayerList> layer_list,
+    std::shared_ptr<FramebufferBundle> const& fb_bundle,
+    std::shared_ptr<DisplayDevice> const& display_device,
+    std::shared_ptr<ANativeWindow> const& native_window,
+    mga::GLContext const& shared_gl_context,
+    mgl::ProgramFactory const& program_factory,
+    glm::mat2 const& transform,
+    geom::Rectangle area,
+    mga::OverlayOptimization overlay_option,
+    std::shared_ptr<HwcCursor> const& cursor)
     : display_name(display_name),
       layer_list(std::move(layer_list)),
       fb_bundle{fb_bundle},
@@ -53,8 +71,14 @@ mga::DisplayBuffer::DisplayBuffer(
       overlay_enabled{overlay_option == mga::OverlayOptimization::enabled},
       transform{transform},
       area{area},
-      power_mode_{mir_power_mode_on}
+      power_mode_{mir_power_mode_on},
+      cursor{cursor}
 {
+    if (mga::is_hwc_transform(transform))
+    {
+        this->layer_list->set_transformation(transform, area.size);
+        overlay_program.set_transformation(transform, area.size);
+    }
 }
 
 geom::Rectangle mga::DisplayBuffer::view_area() const
@@ -74,13 +98,19 @@ void mga::DisplayBuffer::release_current()
 
 bool mga::DisplayBuffer::overlay(RenderableList const& renderlist)
 {
-    glm::mat2 static const no_transformation(1, 0, 0, 1);
-    if (!overlay_enabled ||
-        !display_device->compatible_renderlist(renderlist) ||
-        transform != no_transformation)
+    if (!overlay_enabled || !mga::is_hwc_transform(transform))
+        return false;
+
+    //hidden renderables would take up overlays, or force the others to be composited with gl
+    auto const visible = mga::visible_renderables(renderlist);
+    if (!display_device->compatible_renderlist(visible))
         return false;
 
-    layer_list->update_list(renderlist, area.top_left - geom::Point());
+    //the hwc composites this frame, so a cursor drawn into the last fb target gets its layer back
+    gl_cursor = nullptr;
+    if (cursor)
+        layer_list->set_cursor(cursor->renderable_for(display_name, area, transform));
+    layer_list->update_list(visible, area.top_left - geom::Point());
 
     bool needs_commit{false};
     for (auto& layer : *layer_list)
@@ -91,7 +121,21 @@ bool mga::DisplayBuffer::overlay(RenderableList const& renderlist)
 
 void mga::DisplayBuffer::swap_buffers()
 {
+    if (cursor)
+    {
+        //the fb target is already drawn, so a cursor the hwc would not show goes in with it
+        auto cursor_renderable = cursor->renderable_for(display_name, area, transform);
+        if (cursor_renderable && layer_list->cursor_rejected())
+            gl_cursor = cursor_renderable->id();
+        if (cursor_renderable && (cursor_renderable->id() == gl_cursor))
+        {
+            overlay_program.draw_over({cursor_renderable}, area.top_left - geom::Point());
+            cursor_renderable = nullptr;
+        }
+        layer_list->set_cursor(cursor_renderable);
+    }
     layer_list->update_list({}, area.top_left - geom::Point());
+    overlay_program.invalidate_damage();
     //HWC 1.0 cannot call eglSwapBuffers() on the display context
     if (display_device->can_swap_buffers())
         gl_context.swap_buffers();
@@ -112,9 +156,15 @@ void mga::DisplayBuffer::configure(MirPowerMode power_mode,
 {
     power_mode_ = power_mode;
     area = a;
-    if (power_mode_ != mir_power_mode_on)
+    //a dozing display still shows the buffers it was last given
+    if (power_mode_ == mir_power_mode_off)
         display_device->content_cleared();
     transform = trans;
+    if (mga::is_hwc_transform(transform))
+    {
+        layer_list->set_transformation(transform, area.size);
+        overlay_program.set_transformation(transform, area.size);
+    }
 }
 
 mga::DisplayContents mga::DisplayBuffer::contents()
@@ -39,6 +39,7 @@ namespace android
 class DisplayDevice;
 class FramebufferBundle;
 class LayerList;
+class HwcCursor;
 
 class DisplayBuffer : public ConfigurableDisplayBuffer,
                       public NativeDisplayBuffer,
@@ -58,6 +59,19 @@ public:
         glm::mat2 const& transform,
         geometry::Rectangle area,
         OverlayOptimization overlay_option);
+    //as above, with the cursor shown in a cursor layer
+    DisplayBuffer(
+        DisplayName,
+        std::unique_ptr<LayerList> layer_list,
+        std::shared_ptr<FramebufferBundle> const& fb_bundle,
+        std::shared_ptr<DisplayDevice> const& display_device,
+        std::shared_ptr<ANativeWindow> const& native_window,
+        GLContext const& shared_gl_context,
+        gl::ProgramFactory const& program_factory,
+        glm::mat2 const& transform,
+        geometry::Rectangle area,
+        OverlayOptimization overlay_option,
+        std::shared_ptr<HwcCursor> const& cursor);
 
     geometry::Rectangle view_area() const override;
     void make_current() override;
@@ -84,6 +98,10 @@ private:
     glm::mat2 transform;
     geometry::Rectangle area;
     MirPowerMode power_mode_;
+    std::shared_ptr<HwcCursor> const cursor;
+    //the cursor image the hwc would not show over a frame drawn by the compositor, until the hwc
+    //composites a frame again
+    Renderable::ID gl_cursor{nullptr};
 };
 
 }
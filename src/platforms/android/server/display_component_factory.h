@@ -34,6 +34,7 @@ class GraphicBufferAllocator;
 namespace android
 {
 class HwcConfiguration;
+class HwcCursor;
 
 //TODO: this name needs improvement.
 class DisplayComponentFactory
@@ -45,6 +46,8 @@ public:
     virtual std::unique_ptr<DisplayDevice> create_display_device() = 0;
     virtual std::unique_ptr<HwcConfiguration> create_hwc_configuration() = 0;
     virtual std::unique_ptr<LayerList> create_layer_list() = 0;
+    //null if the hwc cannot show a cursor layer
+    virtual std::shared_ptr<HwcCursor> create_cursor() = 0;
 
     virtual std::shared_ptr<graphics::GraphicBufferAllocator> the_buffer_allocator() = 0;
 protected:
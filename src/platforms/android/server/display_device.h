@@ -21,11 +21,13 @@
 
 #include "mir/geometry/displacement.h"
 #include "mir/graphics/renderable.h"
+#include "mir/graphics/frame.h"
 #include "mir_toolkit/common.h"
 #include "display_name.h"
 #include <EGL/egl.h>
 #include <list>
 #include <chrono>
+#include <functional>
 
 namespace mir
 {
@@ -71,6 +73,11 @@ public:
 
     virtual bool can_swap_buffers() const = 0;
 
+    //called with the time each committed frame reached the display, where the device can tell.
+    //an empty callback stops the notifications.
+    virtual void subscribe_to_presentation(
+        std::function<void(DisplayName, graphics::Frame::Timestamp)> const& presented) = 0;
+
 protected:
     DisplayDevice() = default;
     DisplayDevice& operator=(DisplayDevice const&) = delete;
@@ -19,21 +19,64 @@
 #include "display_group.h"
 #include "configurable_display_buffer.h"
 #include "display_device_exceptions.h"
+#include "display_device.h"
 #include <boost/throw_exception.hpp>
 #include <stdexcept>
+#include <algorithm>
+#include <time.h>
 
 namespace mg = mir::graphics;
 namespace mga = mir::graphics::android;
 namespace geom = mir::geometry;
 
+namespace
+{
+//long enough for a 24Hz display, but bounded for displays that have stopped delivering vsync
+std::chrono::milliseconds const max_vsync_wait{50};
+//the frame being posted, and the next one, which is paced by vsync
+unsigned int const frames_needing_vsync{2};
+//dozing displays are refreshed without vsync, at a rate that keeps them readable at low power
+std::chrono::milliseconds const doze_frame_interval{100};
+
+bool is_doze_mode(MirPowerMode mode)
+{
+    return (mode == mir_power_mode_standby) || (mode == mir_power_mode_suspend);
+}
+
+//in doze suspend a display keeps what it shows, and is not to be updated
+bool shows_new_frames(MirPowerMode mode)
+{
+    return (mode == mir_power_mode_on) || (mode == mir_power_mode_standby);
+}
+
+//the clock of the vsync timestamps
+std::chrono::nanoseconds monotonic_now()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return std::chrono::seconds{now.tv_sec} + std::chrono::nanoseconds{now.tv_nsec};
+}
+}
+
 mga::DisplayGroup::DisplayGroup(
     std::shared_ptr<mga::DisplayDevice> const& device,
     std::unique_ptr<mga::ConfigurableDisplayBuffer> primary_buffer,
-    ExceptionHandler const& exception_handler) :
+    ExceptionHandler const& exception_handler,
+    VsyncRequest const& request_vsync) :
     device(device),
-    exception_handler(exception_handler)
+    exception_handler(exception_handler),
+    request_vsync(request_vsync)
 {
     dbs.emplace(std::make_pair(mga::DisplayName::primary, std::move(primary_buffer)));
+    single_displays[mga::DisplayName::primary] = std::make_shared<SingleDisplay>(*this, mga::DisplayName::primary);
+}
+
+mga::DisplayGroup::DisplayGroup(
+    std::shared_ptr<mga::DisplayDevice> const& device,
+    std::unique_ptr<mga::ConfigurableDisplayBuffer> primary_buffer,
+    ExceptionHandler const& exception_handler)
+    : DisplayGroup(device, std::move(primary_buffer), exception_handler, [](DisplayName, unsigned int){})
+{
 }
 
 mga::DisplayGroup::DisplayGroup(
@@ -45,16 +88,20 @@ mga::DisplayGroup::DisplayGroup(
 
 void mga::DisplayGroup::for_each_display_buffer(std::function<void(mg::DisplayBuffer&)> const& f)
 {
+    if (cadence.frame_start.count() == 0)
+        cadence.frame_start = monotonic_now();
+
     std::unique_lock<decltype(guard)> lk(guard);
     for(auto const& db : dbs)
-        if (db.second->power_mode() != mir_power_mode_off)
+        if (shows_new_frames(db.second->power_mode()))
             f(*db.second);
 }
 
 void mga::DisplayGroup::add(DisplayName name, std::unique_ptr<ConfigurableDisplayBuffer> buffer)
 {
     std::unique_lock<decltype(guard)> lk(guard);
-    dbs.emplace(std::make_pair(name, std::move(buffer)));
+    dbs[name] = std::move(buffer);
+    single_displays[name] = std::make_shared<SingleDisplay>(*this, name);
 }
 
 void mga::DisplayGroup::remove(DisplayName name)
@@ -66,6 +113,7 @@ void mga::DisplayGroup::remove(DisplayName name)
     auto it = dbs.find(name);
     if (it != dbs.end())
         dbs.erase(it);
+    single_displays.erase(name);
 }
 
 bool mga::DisplayGroup::display_present(DisplayName name) const
@@ -89,9 +137,133 @@ void mga::DisplayGroup::post()
     {
         std::unique_lock<decltype(guard)> lk(guard);
         for(auto const& db : dbs)
+        {
+            auto const mode = db.second->power_mode();
+            if (mode == mir_power_mode_suspend)
+                continue;
+            if (!is_doze_mode(mode))
+                request_vsync(db.first, frames_needing_vsync);
             contents.emplace_back(db.second->contents());
+        }
+    }
+
+    //a display in doze suspend is left out, and the device sets its last list again. that
+    //holds when all of them are, so the hwc never takes a suspended display as disabled.
+    commit(contents);
+    frame_committed(cadence, mga::DisplayName::primary);
+}
+
+/* A display in a sync group of its own commits at most once per vsync. Where the hwc blocks
+ * in set() until the next vsync, that vsync has already come by the next post. A dozing
+ * display has no vsync to wait for. */
+void mga::DisplayGroup::post(DisplayName name)
+{
+    auto const mode = power_mode(name);
+    if (mode == mir_power_mode_suspend)
+        return;
+
+    if (!is_doze_mode(mode))
+    {
+        request_vsync(name, frames_needing_vsync);
+        std::unique_lock<decltype(vsync_mutex)> lk(vsync_mutex);
+        vsync_changed.wait_for(lk, max_vsync_wait,
+            [&] { return vsyncs[name] != vsync_at_last_post[name]; });
+        vsync_at_last_post[name] = vsyncs[name];
+    }
+
+    std::list<DisplayContents> contents;
+    {
+        std::unique_lock<decltype(guard)> lk(guard);
+        auto it = dbs.find(name);
+        if (it == dbs.end())
+            return;
+        contents.emplace_back(it->second->contents());
+    }
+
+    commit(contents);
+}
+
+/* The period is worked out from the msc, so that vsyncs that were not delivered
+ * do not throw it off. */
+void mga::DisplayGroup::on_vsync(DisplayName name, mg::Frame const& frame)
+{
+    {
+        std::lock_guard<decltype(vsync_mutex)> lk(vsync_mutex);
+        vsyncs[name]++;
+
+        auto& history = vsync_history[name];
+        auto const frames = frame.msc - history.last.msc;
+        if ((history.last.msc != 0) && (frames > 0))
+        {
+            auto const period = (frame.ust.nanoseconds - history.last.ust.nanoseconds) / frames;
+            if (history.period.count() == 0)
+                history.period = period;
+            else
+                history.period = (history.period * 7 + period) / 8;
+        }
+        history.last = frame;
+    }
+    vsync_changed.notify_all();
+}
+
+std::chrono::nanoseconds mga::DisplayGroup::next_vsync(DisplayName name, std::chrono::nanoseconds after) const
+{
+    std::lock_guard<decltype(vsync_mutex)> lk(vsync_mutex);
+    auto it = vsync_history.find(name);
+    if ((it == vsync_history.end()) || (it->second.period.count() == 0))
+        return std::chrono::nanoseconds{0};
+
+    auto const& history = it->second;
+    auto const periods = (after - history.last.ust.nanoseconds) / history.period;
+    return history.last.ust.nanoseconds + history.period * (std::max<decltype(periods)>(periods, 0) + 1);
+}
+
+/* The frame just committed is due on the next vsync, so the next frame is due on the one after */
+void mga::DisplayGroup::frame_committed(Cadence& paced, DisplayName name)
+{
+    auto const now = monotonic_now();
+    if (paced.frame_start.count() != 0)
+        paced.frame_durations.frame_took(now - paced.frame_start);
+    paced.frame_start = std::chrono::nanoseconds{0};
+
+    auto const due = next_vsync(name, now);
+    paced.next_deadline = (due.count() != 0) ? next_vsync(name, due) : due;
+}
+
+std::chrono::milliseconds mga::DisplayGroup::sleep_before_next_frame(Cadence const& paced, DisplayName name) const
+{
+    //until the vsync rate and the time frames take are known, the device's estimate is all there is
+    if ((paced.next_deadline.count() == 0) || (paced.frame_durations.expected_frame_duration().count() == 0))
+        return device->recommended_sleep();
+    return paced.frame_durations.sleep_before(paced.next_deadline - monotonic_now());
+}
+
+void mga::DisplayGroup::set_independent_cadence(bool independent)
+{
+    std::unique_lock<decltype(guard)> lk(guard);
+    independent_cadence = independent;
+}
+
+void mga::DisplayGroup::for_each_sync_group(std::function<void(mg::DisplaySyncGroup&)> const& f)
+{
+    std::unique_lock<decltype(guard)> lk(guard);
+    if (!independent_cadence)
+    {
+        lk.unlock();
+        f(*this);
+        return;
     }
 
+    std::vector<std::shared_ptr<SingleDisplay>> groups;
+    for (auto const& single_display : single_displays)
+        groups.push_back(single_display.second);
+    lk.unlock();
+    for (auto const& group : groups)
+        f(*group);
+}
+
+void mga::DisplayGroup::commit(std::list<DisplayContents> const& contents)
+{
     try
     {
         device->commit(contents);
@@ -112,5 +284,60 @@ void mga::DisplayGroup::post()
 
 std::chrono::milliseconds mga::DisplayGroup::recommended_sleep() const
 {
-    return device->recommended_sleep();
+    if (dozing())
+        return doze_frame_interval;
+    return sleep_before_next_frame(cadence, mga::DisplayName::primary);
+}
+
+MirPowerMode mga::DisplayGroup::power_mode(DisplayName name) const
+{
+    std::unique_lock<decltype(guard)> lk(guard);
+    auto it = dbs.find(name);
+    return (it == dbs.end()) ? mir_power_mode_off : it->second->power_mode();
+}
+
+/* The displays of a sync group are paced together, so the group dozes once none of them is on */
+bool mga::DisplayGroup::dozing() const
+{
+    std::unique_lock<decltype(guard)> lk(guard);
+    bool any_dozing{false};
+    for (auto const& db : dbs)
+    {
+        auto const mode = db.second->power_mode();
+        if (mode == mir_power_mode_on)
+            return false;
+        any_dozing |= is_doze_mode(mode);
+    }
+    return any_dozing;
+}
+
+mga::DisplayGroup::SingleDisplay::SingleDisplay(DisplayGroup& group, DisplayName name) :
+    group(group),
+    name(name)
+{
+}
+
+void mga::DisplayGroup::SingleDisplay::for_each_display_buffer(
+    std::function<void(mg::DisplayBuffer&)> const& f)
+{
+    if (cadence.frame_start.count() == 0)
+        cadence.frame_start = monotonic_now();
+
+    std::unique_lock<decltype(group.guard)> lk(group.guard);
+    auto it = group.dbs.find(name);
+    if ((it != group.dbs.end()) && shows_new_frames(it->second->power_mode()))
+        f(*it->second);
+}
+
+void mga::DisplayGroup::SingleDisplay::post()
+{
+    group.post(name);
+    group.frame_committed(cadence, name);
+}
+
+std::chrono::milliseconds mga::DisplayGroup::SingleDisplay::recommended_sleep() const
+{
+    if (is_doze_mode(group.power_mode(name)))
+        return doze_frame_interval;
+    return group.sleep_before_next_frame(cadence, name);
 }
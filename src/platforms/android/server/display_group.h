@@ -21,11 +21,16 @@
 
 #include "mir_toolkit/common.h"
 #include "mir/graphics/display.h"
+#include "mir/graphics/frame.h"
 #include "mir/geometry/displacement.h"
 #include "display_name.h"
+#include "sleep_estimator.h"
 #include <glm/glm.hpp>
+#include <list>
 #include <map>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 namespace mir
 {
@@ -35,11 +40,19 @@ namespace android
 {
 class ConfigurableDisplayBuffer;
 class DisplayDevice;
+struct DisplayContents;
 
 class DisplayGroup : public graphics::DisplaySyncGroup
 {
 public:
     using ExceptionHandler = std::function<void()>;
+    //asks for vsync on a display for at least the next few frames
+    using VsyncRequest = std::function<void(DisplayName, unsigned int frames)>;
+    DisplayGroup(
+        std::shared_ptr<DisplayDevice> const& device,
+        std::unique_ptr<ConfigurableDisplayBuffer> primary_buffer,
+        ExceptionHandler const& handler,
+        VsyncRequest const& request_vsync);
     DisplayGroup(
         std::shared_ptr<DisplayDevice> const& device,
         std::unique_ptr<ConfigurableDisplayBuffer> primary_buffer,
@@ -57,11 +70,65 @@ public:
     void configure(DisplayName name, MirPowerMode, glm::mat2 const&, geometry::Rectangle const&);
     bool display_present(DisplayName name) const;
 
+    //with independent cadence each display is a sync group of its own, committed at its own
+    //vsync rate. Otherwise the displays are the one sync group, committed together.
+    void set_independent_cadence(bool independent);
+    void for_each_sync_group(std::function<void(graphics::DisplaySyncGroup&)> const& f);
+    void on_vsync(DisplayName name, graphics::Frame const& frame);
+
 private:
+    //Each sync group starts composing as late as it can and still have the frame committed by
+    //the vsync after the one its last frame was committed for. The frames of the whole group
+    //are paced by the primary display.
+    struct Cadence
+    {
+        SleepEstimator frame_durations;
+        std::chrono::nanoseconds frame_start{0};
+        std::chrono::nanoseconds next_deadline{0};
+    };
+
+    class SingleDisplay : public graphics::DisplaySyncGroup
+    {
+    public:
+        SingleDisplay(DisplayGroup& group, DisplayName name);
+        void for_each_display_buffer(std::function<void(graphics::DisplayBuffer&)> const& f) override;
+        void post() override;
+        std::chrono::milliseconds recommended_sleep() const override;
+    private:
+        DisplayGroup& group;
+        DisplayName const name;
+        Cadence cadence;
+    };
+
+    void post(DisplayName name);
+    MirPowerMode power_mode(DisplayName name) const;
+    bool dozing() const;
+    void commit(std::list<DisplayContents> const& contents);
+    void frame_committed(Cadence& paced, DisplayName name);
+    std::chrono::milliseconds sleep_before_next_frame(Cadence const& paced, DisplayName name) const;
+    //the first vsync of the display after the given time, or 0 if its vsync rate is not known yet
+    std::chrono::nanoseconds next_vsync(DisplayName name, std::chrono::nanoseconds after) const;
+
     std::mutex mutable guard;
     std::shared_ptr<DisplayDevice> const device;
     std::map<DisplayName, std::unique_ptr<ConfigurableDisplayBuffer>> dbs;
+    //shared, so that a display removed while its sync group is handed out stays alive until it is done with
+    std::map<DisplayName, std::shared_ptr<SingleDisplay>> single_displays;
+    bool independent_cadence{false};
     ExceptionHandler const exception_handler;
+    VsyncRequest const request_vsync;
+    Cadence cadence;
+
+    struct VsyncHistory
+    {
+        graphics::Frame last;
+        std::chrono::nanoseconds period{0};
+    };
+    std::mutex mutable vsync_mutex;
+    std::condition_variable vsync_changed;
+    std::map<DisplayName, unsigned long> vsyncs;
+    std::map<DisplayName, unsigned long> vsync_at_last_post;
+    std::map<DisplayName, VsyncHistory> vsync_history;
 };
 
 }
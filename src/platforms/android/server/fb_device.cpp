@@ -97,6 +97,12 @@ mg::DisplayConfigurationOutput mga::FbControl::active_config_for(DisplayName dis
     };
 }
 
+void mga::FbControl::set_active_mode(DisplayName, size_t mode_index)
+{
+    if (mode_index != 0)
+        BOOST_THROW_EXCEPTION(std::invalid_argument("fb device has only the one display mode"));
+}
+
 mga::ConfigChangeSubscription mga::FbControl::subscribe_to_config_changes(
         std::function<void()> const&,
         std::function<void(DisplayName, mg::Frame::Timestamp)> const&)
@@ -104,6 +110,10 @@ mga::ConfigChangeSubscription mga::FbControl::subscribe_to_config_changes(
     return nullptr;
 }
 
+void mga::FbControl::request_vsync(DisplayName, unsigned int)
+{
+}
+
 mga::FBDevice::FBDevice(std::shared_ptr<framebuffer_device_t> const& fbdev) :
     fb_device(fbdev)
 {
@@ -144,3 +154,9 @@ bool mga::FBDevice::can_swap_buffers() const
 {
     return true;
 }
+
+//the framebuffer device gives no word of when frames are shown
+void mga::FBDevice::subscribe_to_presentation(
+    std::function<void(DisplayName, mg::Frame::Timestamp)> const&)
+{
+}
@@ -37,9 +37,11 @@ public:
     FbControl(std::shared_ptr<framebuffer_device_t> const& fbdev);
     void power_mode(DisplayName, MirPowerMode) override;
     DisplayConfigurationOutput active_config_for(DisplayName) override;
+    void set_active_mode(DisplayName, size_t mode_index) override;
     ConfigChangeSubscription subscribe_to_config_changes(
         std::function<void()> const& hotplug_cb,
         std::function<void(DisplayName,graphics::Frame::Timestamp)> const& vsync_cb) override;
+    void request_vsync(DisplayName, unsigned int frames) override;
 private:
     std::shared_ptr<framebuffer_device_t> const fb_device;
 };
@@ -53,6 +55,8 @@ public:
     void commit(std::list<DisplayContents> const& contents) override;
     std::chrono::milliseconds recommended_sleep() const override;
     bool can_swap_buffers() const override;
+    void subscribe_to_presentation(
+        std::function<void(DisplayName, graphics::Frame::Timestamp)> const& presented) override;
 
 private:
     std::shared_ptr<framebuffer_device_t> const fb_device;
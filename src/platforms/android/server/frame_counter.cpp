@@ -0,0 +1,73 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_counter.h"
+
+namespace mga = mir::graphics::android;
+namespace mg = mir::graphics;
+
+namespace
+{
+template<typename Published>
+void load_frame(Published const& atomic, mg::Frame& frame)
+{
+    frame.msc = atomic.msc.load(std::memory_order_relaxed);
+    frame.ust = mg::Frame::Timestamp{
+        static_cast<clockid_t>(atomic.clock_id.load(std::memory_order_relaxed)),
+        std::chrono::nanoseconds{atomic.ust.load(std::memory_order_relaxed)}};
+}
+
+template<typename Published>
+void store_frame(Published& atomic, mg::Frame const& frame)
+{
+    atomic.msc.store(frame.msc, std::memory_order_relaxed);
+    atomic.clock_id.store(frame.ust.clock_id, std::memory_order_relaxed);
+    atomic.ust.store(frame.ust.nanoseconds.count(), std::memory_order_relaxed);
+}
+}
+
+/* An odd sequence number means a store is under way */
+mga::FrameCounter::Frames mga::FrameCounter::load() const noexcept
+{
+    Frames frames;
+    while (true)
+    {
+        auto const before = sequence.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+
+        load_frame(vsync, frames.vsync);
+        load_frame(presented, frames.presented);
+        frames.period = std::chrono::nanoseconds{period.load(std::memory_order_relaxed)};
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == before)
+            return frames;
+    }
+}
+
+void mga::FrameCounter::store(Frames const& frames) noexcept
+{
+    auto const before = sequence.load(std::memory_order_relaxed);
+    sequence.store(before + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    store_frame(vsync, frames.vsync);
+    store_frame(presented, frames.presented);
+    period.store(frames.period.count(), std::memory_order_relaxed);
+
+    sequence.store(before + 2, std::memory_order_release);
+}
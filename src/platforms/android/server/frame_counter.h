@@ -0,0 +1,67 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_ANDROID_FRAME_COUNTER_H_
+#define MIR_GRAPHICS_ANDROID_FRAME_COUNTER_H_
+
+#include "mir/graphics/frame.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace mir
+{
+namespace graphics
+{
+namespace android
+{
+
+//The frames counted on one display, published with a sequence lock. Readers never block
+//the writer; they read again if it was writing at the time. There must be one writer at a time.
+class FrameCounter
+{
+public:
+    struct Frames
+    {
+        //the last vsync, and the last frame presented
+        Frame vsync;
+        Frame presented;
+        std::chrono::nanoseconds period{0};
+    };
+
+    Frames load() const noexcept;
+    void store(Frames const& frames) noexcept;
+
+private:
+    struct PublishedFrame
+    {
+        std::atomic<int64_t> msc{0};
+        std::atomic<int> clock_id{CLOCK_MONOTONIC};
+        std::atomic<int64_t> ust{0};
+    };
+
+    std::atomic<uint64_t> sequence{0};
+    PublishedFrame vsync;
+    PublishedFrame presented;
+    std::atomic<int64_t> period{0};
+};
+
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_ANDROID_FRAME_COUNTER_H_ */
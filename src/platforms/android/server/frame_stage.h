@@ -0,0 +1,59 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_ANDROID_FRAME_STAGE_H_
+#define MIR_GRAPHICS_ANDROID_FRAME_STAGE_H_
+
+#include <array>
+
+namespace mir
+{
+namespace graphics
+{
+namespace android
+{
+
+//the stages a committed frame goes through on its way to the display
+enum class FrameStage
+{
+    prepare,
+    gl_fallback,
+    set,
+    fence_wait
+};
+
+enum class FrameOutcome
+{
+    on_time,
+    late,
+    skipped
+};
+
+//the outcomes of the last few seconds of frames on a display
+struct FrameHistogram
+{
+    unsigned int on_time{0};
+    unsigned int late{0};
+    unsigned int skipped{0};
+    //late frames by the number of vsyncs they missed, the last counting any later still
+    std::array<unsigned int, 4> vsyncs_missed{{0, 0, 0, 0}};
+};
+
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_ANDROID_FRAME_STAGE_H_ */
@@ -40,6 +40,10 @@ public:
     virtual geometry::Size fb_size() = 0;
     virtual std::shared_ptr<Buffer> buffer_for_render() = 0;
     virtual std::shared_ptr<Buffer> last_rendered_buffer() = 0;
+    //frames since the buffer being rendered was last rendered to, or 0 if its contents are unknown
+    virtual unsigned int buffer_age() = 0;
+    //adds a third buffer while enabled, if there are fewer
+    virtual void set_triple_buffering(bool enabled) = 0;
 
 protected:
     FramebufferBundle() = default;
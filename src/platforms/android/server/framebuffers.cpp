@@ -19,6 +19,11 @@
 
 #include "framebuffers.h"
 #include "graphic_buffer_allocator.h"
+#include "native_buffer.h"
+#include "sync_fence.h"
+#include "mir/graphics/buffer.h"
+#include <algorithm>
+#include <linux/sync.h>
 
 namespace mg = mir::graphics;
 namespace mga=mir::graphics::android;
@@ -29,10 +34,25 @@ mga::Framebuffers::Framebuffers(
     geom::Size size,
     MirPixelFormat format,
     unsigned int num_framebuffers) :
-    size{size}
+    Framebuffers(buffer_allocator, size, format, num_framebuffers, std::make_shared<mga::RealSyncFileOps>())
+{
+}
+
+mga::Framebuffers::Framebuffers(
+    mga::GraphicBufferAllocator& buffer_allocator,
+    geom::Size size,
+    MirPixelFormat format,
+    unsigned int num_framebuffers,
+    std::shared_ptr<SyncFileOps> const& sync_ops) :
+    buffer_allocator(buffer_allocator),
+    sync_ops(sync_ops),
+    size{size},
+    format{format},
+    num_framebuffers{num_framebuffers},
+    num_buffers{num_framebuffers}
 {
     for(auto i = 0u; i < num_framebuffers; i++)
-        queue.push(buffer_allocator.alloc_framebuffer(size, format));
+        queue.push_back(buffer_allocator.alloc_framebuffer(size, format));
 }
 
 geom::Size mga::Framebuffers::fb_size()
@@ -49,13 +69,18 @@ std::shared_ptr<mg::Buffer> mga::Framebuffers::buffer_for_render()
     }
 
     buffer_being_rendered = queue.front();
-    queue.pop();
+    queue.pop_front();
     return std::shared_ptr<mg::Buffer>(buffer_being_rendered.get(),
         [this](mg::Buffer*)
         {
             std::unique_lock<std::mutex> lk(queue_lock);
-            queue.push(buffer_being_rendered);
+            rendered_in_frame[buffer_being_rendered.get()] = ++frames_rendered;
+            queue.push_back(buffer_being_rendered);
             buffer_being_rendered.reset();
+            if (!triple_buffering_hinted && (num_buffers > num_framebuffers) &&
+                (++frames_without_hint >= frames_before_shrinking))
+                num_buffers = num_framebuffers;
+            resize_queue(lk);
             cv.notify_all();
         });
 }
@@ -65,3 +90,55 @@ std::shared_ptr<mg::Buffer> mga::Framebuffers::last_rendered_buffer()
     std::unique_lock<std::mutex> lk(queue_lock);
     return queue.back();
 }
+
+unsigned int mga::Framebuffers::buffer_age()
+{
+    std::unique_lock<std::mutex> lk(queue_lock);
+    if (!buffer_being_rendered)
+        return 0;
+
+    auto it = rendered_in_frame.find(buffer_being_rendered.get());
+    if (it == rendered_in_frame.end())
+        return 0;
+    return frames_rendered - it->second + 1;
+}
+
+void mga::Framebuffers::set_triple_buffering(bool enabled)
+{
+    std::unique_lock<std::mutex> lk(queue_lock);
+    triple_buffering_hinted = enabled;
+    if (!enabled)
+        return;
+
+    frames_without_hint = 0;
+    num_buffers = std::max(num_framebuffers, 3u);
+    resize_queue(lk);
+}
+
+/* The release fence is only polled. It stays with the buffer, which is waited on as usual
+ * if it is rendered to again. */
+bool mga::Framebuffers::released(mg::Buffer& buffer) const
+{
+    auto const fence = mga::to_native_buffer_checked(buffer.native_buffer_handle())->fence();
+    if (fence < 0)
+        return true;
+
+    int timeout = 0;
+    return sync_ops->ioctl(fence, SYNC_IOC_WAIT, &timeout) >= 0;
+}
+
+/* New buffers are rendered first, so the last rendered buffer stays at the back.
+ * Buffers are dropped once they are back in the queue, starting with the oldest. The last two
+ * rendered buffers may still be on screen, and a buffer whose release fence has not signalled
+ * is still read by the hwc, so those are left until a later frame. */
+void mga::Framebuffers::resize_queue(std::unique_lock<std::mutex> const&)
+{
+    auto const buffers = [this] { return queue.size() + (buffer_being_rendered ? 1 : 0); };
+    while (buffers() < num_buffers)
+        queue.push_front(buffer_allocator.alloc_framebuffer(size, format));
+    while ((buffers() > num_buffers) && (queue.size() > 2) && released(*queue.front()))
+    {
+        rendered_in_frame.erase(queue.front().get());
+        queue.pop_front();
+    }
+}
@@ -25,7 +25,9 @@
 #include <hardware/gralloc.h>
 #include <hardware/fb.h>
 #include <condition_variable>
-#include <queue>
+#include <deque>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include <mutex>
 
@@ -36,6 +38,7 @@ namespace graphics
 namespace android
 {
 class GraphicBufferAllocator;
+class SyncFileOps;
 
 class Framebuffers : public FramebufferBundle
 {
@@ -45,18 +48,42 @@ public:
         geometry::Size size,
         MirPixelFormat format,
         unsigned int num_framebuffers);
+    Framebuffers(
+        GraphicBufferAllocator& buffer_allocator,
+        geometry::Size size,
+        MirPixelFormat format,
+        unsigned int num_framebuffers,
+        std::shared_ptr<SyncFileOps> const& sync_ops);
 
     geometry::Size fb_size() override;
     std::shared_ptr<Buffer> buffer_for_render() override;
     std::shared_ptr<Buffer> last_rendered_buffer() override;
+    unsigned int buffer_age() override;
+    void set_triple_buffering(bool enabled) override;
+
+    //the third buffer is only dropped once the hint has been off for this many frames
+    static unsigned int const frames_before_shrinking{60};
 
 private:
+    void resize_queue(std::unique_lock<std::mutex> const&);
+    bool released(Buffer& buffer) const;
+
+    GraphicBufferAllocator& buffer_allocator;
+    std::shared_ptr<SyncFileOps> const sync_ops;
     geometry::Size size;
+    MirPixelFormat const format;
+    unsigned int const num_framebuffers;
+    unsigned int num_buffers;
+    bool triple_buffering_hinted{false};
+    unsigned int frames_without_hint{0};
 
     std::mutex queue_lock;
     std::shared_ptr<Buffer> buffer_being_rendered;
     std::condition_variable cv;
-    std::queue<std::shared_ptr<graphics::Buffer>> queue;
+    //oldest first, the last one is the last rendered
+    std::deque<std::shared_ptr<graphics::Buffer>> queue;
+    unsigned int frames_rendered{0};
+    std::unordered_map<Buffer*, unsigned int> rendered_in_frame;
 };
 
 }
@@ -28,6 +28,11 @@
 #include <stdexcept>
 #include <sstream>
 #include <vector>
+#include <cstring>
+
+#ifndef EGL_BUFFER_AGE_EXT
+#define EGL_BUFFER_AGE_EXT 0x313D
+#endif
 
 namespace mg=mir::graphics;
 namespace mga=mir::graphics::android;
@@ -127,6 +132,31 @@ EGLConfig select_egl_config_with_any_format(
 
     return the_config;
 }
+
+bool has_egl_extension(EGLDisplay egl_display, char const* name)
+{
+    auto const extensions = eglQueryString(egl_display, EGL_EXTENSIONS);
+    if (!extensions)
+        return false;
+
+    auto const length = strlen(name);
+    for (auto ext = strstr(extensions, name); ext; ext = strstr(ext + length, name))
+    {
+        if ((ext == extensions || ext[-1] == ' ') && (ext[length] == ' ' || ext[length] == '\0'))
+            return true;
+    }
+    return false;
+}
+
+typedef EGLBoolean (*SwapBuffersWithDamageProc)(EGLDisplay, EGLSurface, EGLint*, EGLint);
+SwapBuffersWithDamageProc swap_buffers_with_damage_proc(EGLDisplay egl_display)
+{
+    if (has_egl_extension(egl_display, "EGL_KHR_swap_buffers_with_damage"))
+        return reinterpret_cast<SwapBuffersWithDamageProc>(eglGetProcAddress("eglSwapBuffersWithDamageKHR"));
+    if (has_egl_extension(egl_display, "EGL_EXT_swap_buffers_with_damage"))
+        return reinterpret_cast<SwapBuffersWithDamageProc>(eglGetProcAddress("eglSwapBuffersWithDamageEXT"));
+    return nullptr;
+}
 }
 
 void mga::GLContext::make_current(EGLSurface egl_surface) const
@@ -223,7 +253,9 @@ mga::FramebufferGLContext::FramebufferGLContext(
      : GLContext(shared_gl_context),
        fb_bundle(fb_bundle),
        egl_surface{egl_display,
-                   eglCreateWindowSurface(egl_display, egl_config, native_window.get(), NULL)}
+                   eglCreateWindowSurface(egl_display, egl_config, native_window.get(), NULL)},
+       buffer_age_supported{has_egl_extension(egl_display, "EGL_EXT_buffer_age")},
+       swap_with_damage{swap_buffers_with_damage_proc(egl_display)}
 {
 }
 
@@ -233,11 +265,46 @@ void mga::FramebufferGLContext::swap_buffers() const
         BOOST_THROW_EXCEPTION(mg::egl_error("eglSwapBuffers failure"));
 }
 
+void mga::FramebufferGLContext::swap_buffers_with_damage(geometry::Rectangle const& damage) const
+{
+    if (!swap_with_damage)
+    {
+        swap_buffers();
+        return;
+    }
+
+    //egl damage rects have their origin at the bottom left
+    auto const height = fb_bundle->fb_size().height.as_int();
+    EGLint rect[] {
+        damage.top_left.x.as_int(),
+        height - damage.bottom_right().y.as_int(),
+        damage.size.width.as_int(),
+        damage.size.height.as_int()
+    };
+    if (swap_with_damage(egl_display, egl_surface, rect, 1) == EGL_FALSE)
+        BOOST_THROW_EXCEPTION(mg::egl_error("eglSwapBuffersWithDamage failure"));
+}
+
+unsigned int mga::FramebufferGLContext::buffer_age() const
+{
+    EGLint age{0};
+    if (!buffer_age_supported ||
+        eglQuerySurface(egl_display, egl_surface, EGL_BUFFER_AGE_EXT, &age) == EGL_FALSE ||
+        age < 0)
+        return 0;
+    return age;
+}
+
 std::shared_ptr<mg::Buffer> mga::FramebufferGLContext::last_rendered_buffer() const
 {
     return fb_bundle->last_rendered_buffer();
 }
 
+void mga::FramebufferGLContext::set_triple_buffering(bool enabled) const
+{
+    fb_bundle->set_triple_buffering(enabled);
+}
+
 void mga::FramebufferGLContext::make_current() const
 {
     GLContext::make_current(egl_surface);
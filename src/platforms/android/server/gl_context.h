@@ -93,11 +93,18 @@ public:
     void make_current() const override;
     void release_current() const override;
     void swap_buffers() const override;
+    void swap_buffers_with_damage(geometry::Rectangle const& damage) const override;
+    unsigned int buffer_age() const override;
     std::shared_ptr<Buffer> last_rendered_buffer() const override;
+    void set_triple_buffering(bool enabled) const override;
 
 private:
+    typedef EGLBoolean (*SwapBuffersWithDamage)(EGLDisplay, EGLSurface, EGLint*, EGLint);
+
     std::shared_ptr<FramebufferBundle> const fb_bundle;
     EGLSurfaceStore const egl_surface;
+    bool const buffer_age_supported;
+    SwapBuffersWithDamage const swap_with_damage;
 };
 
 }
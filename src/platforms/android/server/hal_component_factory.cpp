@@ -28,6 +28,7 @@
 #include "hwc_configuration.h"
 #include "hwc_layers.h"
 #include "hwc_device.h"
+#include "hwc_cursor.h"
 #include "hwc_fb_device.h"
 #include "graphic_buffer_allocator.h"
 #include "cmdstream_sync_factory.h"
@@ -49,6 +50,9 @@ mga::HalComponentFactory::HalComponentFactory(
       force_backup_display(false),
       num_framebuffers{quirks->num_framebuffers()},
       working_egl_sync(quirks->working_egl_sync()),
+      composition_search_budget(quirks->composition_search_budget()),
+      pipelined_commit(quirks->pipelined_commit()),
+      idle_refresh_time(quirks->idle_refresh_time()),
       hwc_version{mga::HwcVersion::unknown}
 {
     try
@@ -113,20 +117,33 @@ std::unique_ptr<mga::LayerList> mga::HalComponentFactory::create_layer_list()
             return std::unique_ptr<mga::LayerList>(
                 new mga::LayerList(std::make_shared<mga::Hwc10Adapter>(), {}, offset));
         case mga::HwcVersion::hwc11:
-        case mga::HwcVersion::hwc12:
             return std::unique_ptr<mga::LayerList>(
                 new mga::LayerList(std::make_shared<mga::IntegerSourceCrop>(), {}, offset));
+        case mga::HwcVersion::hwc12:
+            return std::unique_ptr<mga::LayerList>(
+                new mga::LayerList(std::make_shared<mga::Hwc12Adapter>(), {}, offset));
         case mga::HwcVersion::hwc13:
         case mga::HwcVersion::hwc14:
-        case mga::HwcVersion::hwc15:
             return std::unique_ptr<mga::LayerList>(
                 new mga::LayerList(std::make_shared<mga::FloatSourceCrop>(), {}, offset));
+        case mga::HwcVersion::hwc15:
+            return std::unique_ptr<mga::LayerList>(
+                new mga::LayerList(std::make_shared<mga::Hwc15Adapter>(), {}, offset));
         case mga::HwcVersion::unknown:
         default:
             BOOST_THROW_EXCEPTION(std::runtime_error("unknown or unsupported hwc version"));
     }
 }
 
+//cursor layers and setCursorPositionAsync() came with HWC 1.4
+std::shared_ptr<mga::HwcCursor> mga::HalComponentFactory::create_cursor()
+{
+    if (force_backup_display || (hwc_version < mga::HwcVersion::hwc14) ||
+        (hwc_version == mga::HwcVersion::unknown))
+        return nullptr;
+    return std::make_shared<mga::HwcCursor>(hwc_wrapper, buffer_allocator);
+}
+
 std::unique_ptr<mga::DisplayDevice> mga::HalComponentFactory::create_display_device()
 {
     if (force_backup_display)
@@ -149,7 +166,7 @@ std::unique_ptr<mga::DisplayDevice> mga::HalComponentFactory::create_display_dev
             case mga::HwcVersion::hwc14:
             case mga::HwcVersion::hwc15:
                return std::unique_ptr<mga::DisplayDevice>(
-                    new mga::HwcDevice(hwc_wrapper));
+                    new mga::HwcDevice(hwc_wrapper, hwc_report, composition_search_budget, pipelined_commit));
 
             case mga::HwcVersion::unknown:
             default:
@@ -167,7 +184,7 @@ std::unique_ptr<mga::HwcConfiguration> mga::HalComponentFactory::create_hwc_conf
     else if (hwc_version < mga::HwcVersion::hwc14)
         return std::unique_ptr<mga::HwcConfiguration>(new mga::HwcBlankingControl(hwc_wrapper));
     else
-        return std::unique_ptr<mga::HwcConfiguration>(new mga::HwcPowerModeControl(hwc_wrapper));
+        return std::unique_ptr<mga::HwcConfiguration>(new mga::HwcPowerModeControl(hwc_wrapper, idle_refresh_time));
 }
 
 std::shared_ptr<mg::GraphicBufferAllocator> mga::HalComponentFactory::the_buffer_allocator()
@@ -22,6 +22,7 @@
 #include "cmdstream_sync_factory.h"
 #include "display_component_factory.h"
 #include "display_resource_factory.h"
+#include <chrono>
 
 namespace mir
 {
@@ -55,6 +56,7 @@ public:
     std::unique_ptr<DisplayDevice> create_display_device() override;
     std::unique_ptr<HwcConfiguration> create_hwc_configuration() override;
     std::unique_ptr<LayerList> create_layer_list() override;
+    std::shared_ptr<HwcCursor> create_cursor() override;
     std::shared_ptr<graphics::GraphicBufferAllocator> the_buffer_allocator() override;
 
 private:
@@ -67,6 +69,9 @@ private:
     bool force_backup_display;
     size_t num_framebuffers;
     bool working_egl_sync;
+    std::chrono::microseconds const composition_search_budget;
+    bool const pipelined_commit;
+    std::chrono::milliseconds const idle_refresh_time;
 
     std::shared_ptr<HwcWrapper> hwc_wrapper;
     std::shared_ptr<framebuffer_device_t> fb_native;
@@ -27,6 +27,8 @@
 #include <stdexcept>
 #include <system_error>
 #include <chrono>
+#include <algorithm>
+#include <vector>
 
 #define MIR_LOG_COMPONENT "android/server"
 #include "mir/log.h"
@@ -89,13 +91,17 @@ double period_to_hz(duration<Rep,Period> period_duration)
         return 0.0;
     return duration<double>{1} / period_duration;
 }
+
+//about half a second at 60Hz, so that vsync is not turned off and on between the frames of an animation
+unsigned int const vsync_idle_frames{30};
 }
 
 mga::HwcBlankingControl::HwcBlankingControl(
     std::shared_ptr<mga::HwcWrapper> const& hwc_device) :
     hwc_device{hwc_device},
     off{false},
-    format(determine_hwc_fb_format())
+    format(determine_hwc_fb_format()),
+    vsync_demand(hwc_device, vsync_idle_frames)
 {
 }
 
@@ -104,7 +110,8 @@ mga::HwcBlankingControl::HwcBlankingControl(
     MirPixelFormat format) :
     hwc_device{hwc_device},
     off{false},
-    format{format}
+    format{format},
+    vsync_demand(hwc_device, vsync_idle_frames)
 {
 }
 
@@ -113,13 +120,13 @@ void mga::HwcBlankingControl::power_mode(DisplayName display_name, MirPowerMode
     if (mode_request == mir_power_mode_on)
     {
         hwc_device->display_on(display_name);
-        hwc_device->vsync_signal_on(display_name);
+        vsync_demand.display_on(display_name);
         off = false;
     }
     //suspend, standby, and off all count as off
     else if (!off)
     {
-        hwc_device->vsync_signal_off(display_name);
+        vsync_demand.display_off(display_name);
         hwc_device->display_off(display_name);
         off = true;
     }
@@ -137,8 +144,8 @@ int dpi_to_mm(uint32_t dpi, int pixel_num)
 
 mg::DisplayConfigurationOutput populate_config(
     mga::DisplayName name,
-    geom::Size pixel_size,
-    double vrefresh_hz,
+    std::vector<mg::DisplayConfigurationMode> const& modes,
+    size_t current_mode_index,
     geom::Size mm_size,
     MirPowerMode external_mode,
     MirPixelFormat display_format,
@@ -146,10 +153,9 @@ mg::DisplayConfigurationOutput populate_config(
 {
     geom::Point const origin{0,0};
     size_t const preferred_format_index{0};
-    size_t const preferred_mode_index{0};
     std::vector<mg::DisplayConfigurationMode> external_modes;
     if (connected)
-        external_modes.emplace_back(mg::DisplayConfigurationMode{pixel_size, vrefresh_hz});
+        external_modes = modes;
 
     auto type = mg::DisplayConfigurationOutputType::lvds;
     auto form_factor = mir_form_factor_phone;
@@ -165,7 +171,7 @@ mg::DisplayConfigurationOutput populate_config(
         type,
         {display_format},
         external_modes,
-        preferred_mode_index,
+        current_mode_index,
         mm_size,
         connected,
         connected,
@@ -184,12 +190,23 @@ mg::DisplayConfigurationOutput populate_config(
     };
 }
 
-mg::DisplayConfigurationOutput display_config_for(
+mg::DisplayConfigurationOutput disconnected_config(mga::DisplayName display_name)
+{
+    return populate_config(display_name, {}, 0, {0,0}, mir_power_mode_off, mir_pixel_format_invalid, false);
+}
+
+struct HwcMode
+{
+    mga::ConfigId config;
+    mg::DisplayConfigurationMode mode;
+    geom::Size mm_size;
+};
+
+//an empty list if the display has gone
+std::vector<HwcMode> modes_for(
     mga::DisplayName display_name,
-    mga::ConfigId id,
-    MirPixelFormat format,
-    std::shared_ptr<mga::HwcWrapper> const& hwc_device
-)
+    std::vector<mga::ConfigId> const& configs,
+    std::shared_ptr<mga::HwcWrapper> const& hwc_device)
 {
     /* note: some drivers (qcom msm8960) choke if this is not the same size array
        as the one surfaceflinger submits */
@@ -203,28 +220,74 @@ mg::DisplayConfigurationOutput display_config_for(
         HWC_DISPLAY_NO_ATTRIBUTE,
     };
 
-    int32_t values[sizeof(attributes) / sizeof (attributes[0])] = {};
+    std::vector<HwcMode> modes;
+    for (auto const& id : configs)
+    {
+        int32_t values[sizeof(attributes) / sizeof (attributes[0])] = {};
 
-    auto rc = hwc_device->display_attributes(display_name, id, attributes, values);
+        auto rc = hwc_device->display_attributes(display_name, id, attributes, values);
 
-    if (rc < 0)
-    {
-        if (display_name == mga::DisplayName::primary)
-            BOOST_THROW_EXCEPTION(std::system_error(rc, std::system_category(), "primary display disconnected"));
-        else
-            return populate_config(display_name, {0,0}, 0.0f, {0,0}, mir_power_mode_off, mir_pixel_format_invalid, false);
+        if (rc < 0)
+        {
+            if (display_name == mga::DisplayName::primary)
+                BOOST_THROW_EXCEPTION(std::system_error(rc, std::system_category(), "primary display disconnected"));
+            else
+                return {};
+        }
+
+        modes.push_back({
+            id,
+            mg::DisplayConfigurationMode{{values[0], values[1]}, period_to_hz(std::chrono::nanoseconds{values[2]})},
+            {dpi_to_mm(values[3], values[0]), dpi_to_mm(values[4], values[1])}});
     }
+    return modes;
+}
+
+mg::DisplayConfigurationOutput display_config_for(
+    mga::DisplayName display_name,
+    std::vector<HwcMode> const& hwc_modes,
+    size_t current_mode_index,
+    MirPixelFormat format)
+{
+    if (hwc_modes.empty())
+        return disconnected_config(display_name);
+
+    std::vector<mg::DisplayConfigurationMode> modes;
+    for (auto const& hwc_mode : hwc_modes)
+        modes.push_back(hwc_mode.mode);
 
     return populate_config(
         display_name,
-        {values[0], values[1]},
-        period_to_hz(std::chrono::nanoseconds{values[2]}),
-        {dpi_to_mm(values[3], values[0]), dpi_to_mm(values[4], values[1])},
+        modes,
+        current_mode_index,
+        hwc_modes[current_mode_index].mm_size,
         mir_power_mode_off,
         format,
         true);
 }
 
+//the lowest refresh rate the display has at the resolution of the given mode
+size_t idle_mode_for(std::vector<HwcMode> const& hwc_modes, size_t mode_index)
+{
+    auto idle_index = mode_index;
+    for (auto i = 0u; i != hwc_modes.size(); i++)
+    {
+        auto const& mode = hwc_modes[i].mode;
+        auto const& idle_mode = hwc_modes[idle_index].mode;
+        if ((mode.size == idle_mode.size) && (mode.vrefresh_hz > 0.0) && (mode.vrefresh_hz < idle_mode.vrefresh_hz))
+            idle_index = i;
+    }
+    return idle_index;
+}
+
+//the index of the mode of the given config, or fallback if none of the modes is of that config
+size_t mode_index_for(std::vector<HwcMode> const& hwc_modes, mga::ConfigId config, size_t fallback)
+{
+    auto const mode = std::find_if(hwc_modes.begin(), hwc_modes.end(),
+        [&config](HwcMode const& hwc_mode) { return hwc_mode.config == config; });
+    return (mode == hwc_modes.end()) ? fallback : std::distance(hwc_modes.begin(), mode);
+}
+
 mga::ConfigChangeSubscription subscribe_to_config_changes(
     std::shared_ptr<mga::HwcWrapper> const& hwc_device,
     void const* subscriber,
@@ -253,23 +316,48 @@ mg::DisplayConfigurationOutput mga::HwcBlankingControl::active_config_for(Displa
         if (display_name == mga::DisplayName::primary)
             BOOST_THROW_EXCEPTION(std::runtime_error("primary display disconnected"));
         else
-            return populate_config(display_name, {0,0}, 0.0f, {0,0}, mir_power_mode_off, mir_pixel_format_invalid, false);
+            return disconnected_config(display_name);
     }
 
-    return display_config_for(display_name, configs.front(), format, hwc_device);
+    /* the first config is the only one used before hwc 1.4 */
+    return display_config_for(display_name, modes_for(display_name, {configs.front()}, hwc_device), 0, format);
+}
+
+void mga::HwcBlankingControl::set_active_mode(DisplayName, size_t mode_index)
+{
+    if (mode_index != 0)
+        BOOST_THROW_EXCEPTION(std::invalid_argument("display mode cannot be changed before hwc 1.4"));
 }
 
 mga::ConfigChangeSubscription mga::HwcBlankingControl::subscribe_to_config_changes(
     std::function<void()> const& hotplug,
     std::function<void(DisplayName, mg::Frame::Timestamp)> const& vsync)
 {
-    return ::subscribe_to_config_changes(hwc_device, this, hotplug, vsync);
+    return ::subscribe_to_config_changes(hwc_device, this, hotplug,
+        [this, vsync](DisplayName name, mg::Frame::Timestamp timestamp)
+        {
+            vsync_demand.vsync(name);
+            vsync(name, timestamp);
+        });
+}
+
+void mga::HwcBlankingControl::request_vsync(DisplayName name, unsigned int frames)
+{
+    vsync_demand.request(name, frames);
 }
 
 mga::HwcPowerModeControl::HwcPowerModeControl(
     std::shared_ptr<mga::HwcWrapper> const& hwc_device) :
+    HwcPowerModeControl(hwc_device, std::chrono::milliseconds{0})
+{
+}
+
+mga::HwcPowerModeControl::HwcPowerModeControl(
+    std::shared_ptr<mga::HwcWrapper> const& hwc_device,
+    std::chrono::milliseconds idle_refresh_time) :
     hwc_device{hwc_device},
-    format(determine_hwc_fb_format())
+    format(determine_hwc_fb_format()),
+    idle_refresh{idle_refresh_time.count() > 0 ? new IdleRefresh(hwc_device, idle_refresh_time) : nullptr}
 {
 }
 
@@ -293,7 +381,33 @@ void mga::HwcPowerModeControl::power_mode(DisplayName display_name, MirPowerMode
         default:
             BOOST_THROW_EXCEPTION(std::logic_error("Invalid power mode"));
     }
+    if (idle_refresh && (mode != PowerMode::normal))
+        idle_refresh->display_off(display_name);
+
+    //nothing is paced by vsync while dozing, and it may not be delivered in doze suspend
+    auto& vsync_off = doze_vsync_off[as_hwc_display(display_name)];
+    if (((mode == PowerMode::doze) || (mode == PowerMode::doze_suspend)) && !vsync_off)
+    {
+        try
+        {
+            hwc_device->vsync_signal_off(display_name);
+            vsync_off = true;
+        }
+        catch (std::exception const& e)
+        {
+            mir::log_warning("could not turn vsync off for doze: %s", e.what());
+        }
+    }
+
     hwc_device->power_mode(display_name, mode);
+
+    if ((mode == PowerMode::normal) && vsync_off)
+    {
+        hwc_device->vsync_signal_on(display_name);
+        vsync_off = false;
+    }
+    if (idle_refresh && (mode == PowerMode::normal))
+        idle_refresh->display_on(display_name);
 }
 
 mg::DisplayConfigurationOutput mga::HwcPowerModeControl::active_config_for(DisplayName display_name)
@@ -304,11 +418,14 @@ mg::DisplayConfigurationOutput mga::HwcPowerModeControl::active_config_for(Displ
         if (display_name == mga::DisplayName::primary)
             BOOST_THROW_EXCEPTION(std::runtime_error("primary display disconnected"));
         else
-            return populate_config(display_name, {0,0}, 0.0f, {0,0}, mir_power_mode_off, mir_pixel_format_invalid, false);
+            return disconnected_config(display_name);
     }
 
-    /* the first config is the active one in hwc 1.1 to hwc 1.3. */
-    ConfigId active_config_id = configs.front();
+    auto const modes = modes_for(display_name, configs, hwc_device);
+    if (modes.empty())
+        return disconnected_config(display_name);
+
+    ConfigId active_config_id = modes.front().config;
     if (hwc_device->has_active_config(display_name))
     {
         active_config_id = hwc_device->active_config_for(display_name);
@@ -316,10 +433,30 @@ mg::DisplayConfigurationOutput mga::HwcPowerModeControl::active_config_for(Displ
     else
     {
         //If no active config, just choose the first from the list
-        hwc_device->set_active_config(display_name, configs.front());
+        hwc_device->set_active_config(display_name, active_config_id);
     }
 
-    return display_config_for(display_name, active_config_id, format, hwc_device);
+    auto mode_index = mode_index_for(modes, active_config_id, 0);
+    if (idle_refresh)
+    {
+        auto const posted_config = idle_refresh->track(
+            display_name, modes[mode_index].config, modes[idle_mode_for(modes, mode_index)].config);
+        mode_index = mode_index_for(modes, posted_config, mode_index);
+    }
+
+    return display_config_for(display_name, modes, mode_index, format);
+}
+
+void mga::HwcPowerModeControl::set_active_mode(DisplayName display_name, size_t mode_index)
+{
+    auto const modes = modes_for(display_name, hwc_device->display_configs(display_name), hwc_device);
+    if (mode_index >= modes.size())
+        BOOST_THROW_EXCEPTION(std::invalid_argument("no such display mode"));
+
+    if (idle_refresh)
+        idle_refresh->change(display_name, modes[mode_index].config, modes[idle_mode_for(modes, mode_index)].config);
+    else
+        hwc_device->set_active_config(display_name, modes[mode_index].config);
 }
 
 mga::ConfigChangeSubscription mga::HwcPowerModeControl::subscribe_to_config_changes(
@@ -328,3 +465,10 @@ mga::ConfigChangeSubscription mga::HwcPowerModeControl::subscribe_to_config_chan
 {
     return ::subscribe_to_config_changes(hwc_device, this, hotplug, vsync);
 }
+
+//vsync is not turned on or off with the power mode here, but a frame is on its way
+void mga::HwcPowerModeControl::request_vsync(DisplayName name, unsigned int)
+{
+    if (idle_refresh)
+        idle_refresh->frame_posted(name);
+}
@@ -23,8 +23,12 @@
 #include "mir/graphics/frame.h"
 #include "mir/geometry/size.h"
 #include "display_name.h"
+#include "vsync_demand.h"
+#include "idle_refresh.h"
 #include <memory>
 #include <functional>
+#include <chrono>
+#include <array>
 
 namespace mir
 {
@@ -41,9 +45,13 @@ public:
     virtual ~HwcConfiguration() = default;
     virtual void power_mode(DisplayName, MirPowerMode) = 0;
     virtual DisplayConfigurationOutput active_config_for(DisplayName) = 0;
+    //mode_index is into the modes that active_config_for() gives
+    virtual void set_active_mode(DisplayName, size_t mode_index) = 0;
     virtual ConfigChangeSubscription subscribe_to_config_changes(
         std::function<void()> const& hotplug_cb,
         std::function<void(DisplayName,graphics::Frame::Timestamp)> const& vsync_cb) = 0;
+    //vsync is wanted on the display for at least the next few frames
+    virtual void request_vsync(DisplayName, unsigned int frames) = 0;
 
 protected:
     HwcConfiguration() = default;
@@ -59,14 +67,17 @@ public:
     HwcBlankingControl(std::shared_ptr<HwcWrapper> const&, MirPixelFormat format);
     void power_mode(DisplayName, MirPowerMode) override;
     DisplayConfigurationOutput active_config_for(DisplayName) override;
+    void set_active_mode(DisplayName, size_t mode_index) override;
     ConfigChangeSubscription subscribe_to_config_changes(
         std::function<void()> const& hotplug_cb,
         std::function<void(DisplayName,graphics::Frame::Timestamp)> const& vsync_cb) override;
+    void request_vsync(DisplayName, unsigned int frames) override;
 
 private:
     std::shared_ptr<HwcWrapper> const hwc_device;
     bool off;
     MirPixelFormat format;
+    VsyncDemand vsync_demand;
 };
 
 class HwcWrapper;
@@ -74,15 +85,22 @@ class HwcPowerModeControl : public HwcConfiguration
 {
 public:
     HwcPowerModeControl(std::shared_ptr<HwcWrapper> const&);
+    //with a non-zero idle_refresh_time, displays drop to their lowest refresh rate when idle for that long
+    HwcPowerModeControl(std::shared_ptr<HwcWrapper> const&, std::chrono::milliseconds idle_refresh_time);
     void power_mode(DisplayName, MirPowerMode) override;
     DisplayConfigurationOutput active_config_for(DisplayName) override;
+    void set_active_mode(DisplayName, size_t mode_index) override;
     ConfigChangeSubscription subscribe_to_config_changes(
         std::function<void()> const& hotplug_cb,
         std::function<void(DisplayName,graphics::Frame::Timestamp)> const& vsync_cb) override;
+    void request_vsync(DisplayName, unsigned int frames) override;
 
 private:
     std::shared_ptr<HwcWrapper> const hwc_device;
     MirPixelFormat format;
+    std::unique_ptr<IdleRefresh> const idle_refresh;
+    //displays whose vsync was turned off for doze, to be turned on again with the display
+    std::array<bool, HWC_NUM_DISPLAY_TYPES> doze_vsync_off{};
 };
 
 }
@@ -0,0 +1,192 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hwc_cursor.h"
+#include "hwc_wrapper.h"
+#include "hwc_layers.h"
+#include "mir/graphics/buffer.h"
+#include "mir/graphics/cursor_image.h"
+#include "mir/graphics/graphic_buffer_allocator.h"
+#include "mir/renderer/sw/pixel_source.h"
+
+#include <hardware/gralloc.h>
+#include <boost/throw_exception.hpp>
+#include <stdexcept>
+
+namespace mg = mir::graphics;
+namespace mga = mir::graphics::android;
+namespace mrs = mir::renderer::software;
+namespace geom = mir::geometry;
+
+namespace
+{
+class CursorRenderable : public mg::Renderable
+{
+public:
+    CursorRenderable(
+        std::shared_ptr<int> const& image_id,
+        std::shared_ptr<mg::Buffer> const& buffer,
+        geom::Rectangle const& position) :
+        image_id{image_id},
+        cursor_buffer{buffer},
+        position{position}
+    {
+    }
+
+    ID id() const override
+    {
+        return image_id.get();
+    }
+
+    std::shared_ptr<mg::Buffer> buffer() const override
+    {
+        return cursor_buffer;
+    }
+
+    geom::Rectangle screen_position() const override
+    {
+        return position;
+    }
+
+    float alpha() const override
+    {
+        return 1.0f;
+    }
+
+    glm::mat4 transformation() const override
+    {
+        return glm::mat4(1);
+    }
+
+    bool shaped() const override
+    {
+        return true;
+    }
+
+    unsigned int swap_interval() const override
+    {
+        return 1;
+    }
+
+private:
+    std::shared_ptr<int> const image_id;
+    std::shared_ptr<mg::Buffer> const cursor_buffer;
+    geom::Rectangle const position;
+};
+
+uint32_t const cursor_usage =
+    GRALLOC_USAGE_SW_WRITE_OFTEN | GRALLOC_USAGE_HW_TEXTURE |
+    GRALLOC_USAGE_HW_COMPOSER | GRALLOC_USAGE_CURSOR;
+}
+
+mga::HwcCursor::HwcCursor(
+    std::shared_ptr<HwcWrapper> const& hwc_wrapper,
+    std::shared_ptr<mg::GraphicBufferAllocator> const& buffer_allocator) :
+    hwc_wrapper(hwc_wrapper),
+    buffer_allocator(buffer_allocator)
+{
+}
+
+void mga::HwcCursor::show()
+{
+    std::lock_guard<decltype(guard)> lk(guard);
+    visible = (buffer != nullptr);
+    move_layers();
+}
+
+void mga::HwcCursor::show(CursorImage const& cursor_image)
+{
+    auto const size = cursor_image.size();
+    std::lock_guard<decltype(guard)> lk(guard);
+    //an image the hwc has not been given yet can be overwritten
+    auto target = (buffer && (buffer != onscreen_buffer)) ? buffer : spare_buffer;
+    if (!target || (target->size() != size))
+        target = buffer_allocator->alloc_buffer(size, HAL_PIXEL_FORMAT_BGRA_8888, cursor_usage);
+
+    auto const pixel_source = dynamic_cast<mrs::PixelSource*>(target->native_buffer_base());
+    if (!pixel_source)
+        BOOST_THROW_EXCEPTION(std::logic_error("could not write to the cursor buffer"));
+    pixel_source->write(
+        static_cast<unsigned char const*>(cursor_image.as_argb_8888()),
+        size.width.as_int() * size.height.as_int() * 4);
+
+    if (target != buffer)
+    {
+        spare_buffer = buffer;
+        buffer = target;
+    }
+    image_id = std::make_shared<int>();
+    hotspot = cursor_image.hotspot();
+    visible = true;
+    move_layers();
+}
+
+void mga::HwcCursor::hide()
+{
+    std::lock_guard<decltype(guard)> lk(guard);
+    visible = false;
+    move_layers();
+}
+
+void mga::HwcCursor::move_to(geom::Point new_position)
+{
+    std::lock_guard<decltype(guard)> lk(guard);
+    position = new_position;
+    move_layers();
+}
+
+/* Moves the cursor layers to the cursor, or off the displays it is not shown on.
+ * Where the hwc cannot move a layer, it moves with the next composition. */
+void mga::HwcCursor::move_layers()
+{
+    for (auto& named_view : views)
+    {
+        auto& view = named_view.second;
+        bool const shown = visible && view.area.contains(position);
+        if (!view.has_layer || !view.async_moves || (!shown && !view.layer_shown))
+            continue;
+
+        view.layer_shown = shown;
+        if (!hwc_wrapper->set_cursor_position(named_view.first, layer_position(view)))
+            view.async_moves = false;
+    }
+}
+
+//where the cursor layer is on the unrotated display, or just off its bottom right corner when hidden
+geom::Point mga::HwcCursor::layer_position(View const& view) const
+{
+    if (!view.layer_shown)
+    {
+        auto const display = mga::transformed({{0, 0}, view.area.size}, view.transformation, view.area.size);
+        return display.bottom_right();
+    }
+
+    geom::Rectangle const cursor{position - hotspot - (view.area.top_left - geom::Point{}), buffer->size()};
+    return mga::transformed(cursor, view.transformation, view.area.size).top_left;
+}
+
+std::shared_ptr<mg::Renderable> mga::HwcCursor::renderable_for(
+    DisplayName name, geom::Rectangle const& view_area, glm::mat2 const& transformation)
+{
+    std::lock_guard<decltype(guard)> lk(guard);
+    bool const shown = visible && view_area.contains(position);
+    views[name] = View{view_area, transformation, shown, shown, mga::is_hwc_transform(transformation)};
+    if (!shown)
+        return nullptr;
+
+    onscreen_buffer = buffer;
+    return std::make_shared<CursorRenderable>(image_id, buffer, geom::Rectangle{position - hotspot, buffer->size()});
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_ANDROID_HWC_CURSOR_H_
+#define MIR_GRAPHICS_ANDROID_HWC_CURSOR_H_
+
+#include "mir/graphics/cursor.h"
+#include "mir/graphics/renderable.h"
+#include "mir/geometry/rectangle.h"
+#include "mir/geometry/displacement.h"
+#include "display_name.h"
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <map>
+
+namespace mir
+{
+namespace graphics
+{
+class Buffer;
+class GraphicBufferAllocator;
+
+namespace android
+{
+class HwcWrapper;
+
+//The cursor goes in a cursor layer on each display it is on. The hwc moves the layer without a
+//composition (HWC 1.4 and later), and hides it by moving it off the display. A new image, or a
+//move the hwc refuses, shows on the next composition.
+class HwcCursor : public graphics::Cursor
+{
+public:
+    HwcCursor(
+        std::shared_ptr<HwcWrapper> const& hwc_wrapper,
+        std::shared_ptr<GraphicBufferAllocator> const& buffer_allocator);
+
+    void show() override;
+    void show(CursorImage const& cursor_image) override;
+    void hide() override;
+    void move_to(geometry::Point position) override;
+
+    //the cursor for the display showing view_area, or null if it is hidden or not on that display
+    std::shared_ptr<Renderable> renderable_for(
+        DisplayName, geometry::Rectangle const& view_area, glm::mat2 const& transformation);
+
+private:
+    struct View
+    {
+        geometry::Rectangle area;
+        glm::mat2 transformation;
+        //the display's list has a cursor layer, which is on the display unless it was moved off
+        bool has_layer;
+        bool layer_shown;
+        //false once the hwc refuses a move, until the next composition
+        bool async_moves;
+    };
+    void move_layers();
+    geometry::Point layer_position(View const& view) const;
+
+    std::shared_ptr<HwcWrapper> const hwc_wrapper;
+    std::shared_ptr<GraphicBufferAllocator> const buffer_allocator;
+
+    std::mutex mutable guard;
+    //a new image goes in the buffer that was not last given to the hwc, which may be scanning it out
+    std::shared_ptr<Buffer> buffer;
+    std::shared_ptr<Buffer> spare_buffer;
+    std::shared_ptr<Buffer> onscreen_buffer;
+    //the buffers are reused for images of the same size, so the cursor gets a new id with each
+    //image. Otherwise the copies composited with gl would be taken as up to date.
+    std::shared_ptr<int> image_id;
+    geometry::Displacement hotspot;
+    geometry::Point position;
+    bool visible{false};
+    std::map<DisplayName, View> views;
+};
+
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_ANDROID_HWC_CURSOR_H_ */
@@ -21,14 +21,17 @@
 #include "hwc_device.h"
 #include "hwc_layerlist.h"
 #include "hwc_wrapper.h"
+#include "hwc_report.h"
 #include "framebuffer_bundle.h"
 #include "buffer.h"
 #include "hwc_fallback_gl_renderer.h"
 #include "mir/raii.h"
-#include <limits>
 #include <algorithm>
+#include <cstring>
+#include <numeric>
 #include <chrono>
 #include <thread>
+#include <time.h>
 
 namespace mg = mir::graphics;
 namespace mga=mir::graphics::android;
@@ -36,13 +39,61 @@ namespace geom = mir::geometry;
 
 namespace
 {
-bool plane_alpha_is_translucent(mg::Renderable const& renderable)
+//the clock of the hwc's vsync timestamps and of sync fence signal times
+std::chrono::nanoseconds monotonic_now()
 {
-    float static const tolerance
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return std::chrono::seconds{now.tv_sec} + std::chrono::nanoseconds{now.tv_nsec};
+}
+
+long area(hwc_layer_1_t const& layer)
+{
+    auto const& frame = layer.displayFrame;
+    return static_cast<long>(frame.right - frame.left) * (frame.bottom - frame.top);
+}
+
+//the pixels that have to be composited with gl
+long gl_fill(hwc_display_contents_1_t const& list, size_t renderable_layers)
+{
+    long fill = 0;
+    for (auto i = 0u; i < renderable_layers; i++)
+    {
+        if (list.hwLayers[i].compositionType == HWC_FRAMEBUFFER)
+            fill += area(list.hwLayers[i]);
+    }
+    return fill;
+}
+
+//plans of which layers to force to gl: none, the bottom ones, or all but the largest ones
+std::vector<std::vector<bool>> candidate_plans(hwc_display_contents_1_t const& list, size_t renderable_layers)
+{
+    std::vector<std::vector<bool>> plans{std::vector<bool>(renderable_layers, false)};
+    auto const add = [&](std::vector<bool> const& plan)
     {
-        1.0f/(2.0 * static_cast<float>(std::numeric_limits<decltype(hwc_layer_1_t::planeAlpha)>::max()))
+        if (std::find(plans.begin(), plans.end(), plan) == plans.end())
+            plans.push_back(plan);
     };
-    return (renderable.alpha() < 1.0f - tolerance);
+
+    for (auto forced = 1u; forced < renderable_layers; forced++)
+    {
+        std::vector<bool> plan(renderable_layers, false);
+        std::fill_n(plan.begin(), forced, true);
+        add(plan);
+    }
+
+    std::vector<size_t> largest_first(renderable_layers);
+    std::iota(largest_first.begin(), largest_first.end(), 0);
+    std::stable_sort(largest_first.begin(), largest_first.end(),
+        [&](size_t a, size_t b) { return area(list.hwLayers[a]) > area(list.hwLayers[b]); });
+    for (auto kept = 1u; kept < renderable_layers; kept++)
+    {
+        std::vector<bool> plan(renderable_layers, true);
+        for (auto i = 0u; i < kept; i++)
+            plan[largest_first[i]] = false;
+        add(plan);
+    }
+    return plans;
 }
 }
 
@@ -53,46 +104,108 @@ bool mga::HwcDevice::compatible_renderlist(RenderableList const& list)
 
     for (auto const& renderable : list)
     {
-        // TODO: enable planeAlpha for (hwc version >= 1.2), 90 deg rotation
+        // NOTE: display rotation is handled by the layer list, but transformed
+        //       renderables are still left to the GL compositor.
+        // NOTE: translucent renderables are accepted, the layer list will force
+        //       them to GL if the hwc version does not support planeAlpha.
         static glm::mat4 const identity(1, 0, 0, 0,  //
                                         0, 1, 0, 0,  //
                                         0, 0, 1, 0,  //
                                         0, 0, 0, 1);
-        if (plane_alpha_is_translucent(*renderable) ||
-            renderable->transformation() != identity)
-        {
+        if (renderable->transformation() != identity)
             return false;
-        }
     }
     return true;
 }
 
-mga::HwcDevice::HwcDevice(std::shared_ptr<HwcWrapper> const& hwc_wrapper) :
-    hwc_wrapper(hwc_wrapper)
+mga::HwcDevice::HwcDevice(
+    std::shared_ptr<HwcWrapper> const& hwc_wrapper,
+    std::shared_ptr<HwcReport> const& report) :
+    HwcDevice(hwc_wrapper, report, std::chrono::microseconds{0})
 {
 }
 
+mga::HwcDevice::HwcDevice(
+    std::shared_ptr<HwcWrapper> const& hwc_wrapper,
+    std::shared_ptr<HwcReport> const& report,
+    std::chrono::microseconds composition_search_budget) :
+    HwcDevice(hwc_wrapper, report, composition_search_budget, false)
+{
+}
+
+mga::HwcDevice::HwcDevice(
+    std::shared_ptr<HwcWrapper> const& hwc_wrapper,
+    std::shared_ptr<HwcReport> const& report,
+    std::chrono::microseconds composition_search_budget,
+    bool pipelined_commit) :
+    hwc_wrapper(hwc_wrapper),
+    report(report),
+    composition_search_budget(composition_search_budget),
+    sync_ops(std::make_shared<RealSyncFileOps>()),
+    jank_detector(report),
+    retire_fences(sync_ops)
+{
+    prepared_lists.fill(nullptr);
+    hwc_wrapper->subscribe_to_events(this,
+        [this](DisplayName name, mg::Frame::Timestamp timestamp)
+        {
+            jank_detector.vsync(name, timestamp.nanoseconds);
+        },
+        [](DisplayName, bool) {},
+        [] {});
+    retire_fences.set_callback(
+        [this](DisplayName name, uint64_t frame, mg::Frame::Timestamp timestamp)
+        {
+            on_presented(name, frame, timestamp);
+        });
+    if (pipelined_commit)
+        commit_thread = std::thread{[this] { run_commit_thread(); }};
+}
+
+mga::HwcDevice::~HwcDevice()
+{
+    hwc_wrapper->unsubscribe_from_events(this);
+    retire_fences.set_callback({});
+    if (commit_thread.joinable())
+    {
+        {
+            std::lock_guard<decltype(pending_mutex)> lk(pending_mutex);
+            stopping = true;
+        }
+        pending_changed.notify_all();
+        commit_thread.join();
+    }
+}
+
 bool mga::HwcDevice::buffer_is_onscreen(mg::Buffer const& buffer) const
 {
     /* check the handles, as the buffer ptrs might change between sets */
     auto const handle = buffer.native_buffer_handle().get();
-    auto it = std::find_if(
-        onscreen_overlay_buffers.begin(), onscreen_overlay_buffers.end(),
-        [&handle](std::shared_ptr<mg::Buffer> const& b)
+    return std::any_of(onscreen_overlay_buffers.begin(), onscreen_overlay_buffers.end(),
+        [&handle](std::pair<DisplayName const, std::vector<std::shared_ptr<mg::Buffer>>> const& onscreen)
         {
-            return (handle == b->native_buffer_handle().get());
+            return std::any_of(onscreen.second.begin(), onscreen.second.end(),
+                [&handle](std::shared_ptr<mg::Buffer> const& b)
+                {
+                    return (handle == b->native_buffer_handle().get());
+                });
         });
-    return it != onscreen_overlay_buffers.end();
 }
 
 void mga::HwcDevice::commit(std::list<DisplayContents> const& contents)
 {
+    JankDetector::CommitTimes times;
+    times.start = monotonic_now();
+    std::lock_guard<decltype(commit_mutex)> lk(commit_mutex);
+    if (auto const error = wait_for_pending_set())
+        std::rethrow_exception(error);
+
 #ifdef ANDROID_CAF
     std::array<hwc_display_contents_1*, HWC_NUM_DISPLAY_TYPES> lists{{ nullptr, nullptr, nullptr, nullptr }};
 #else
     std::array<hwc_display_contents_1*, HWC_NUM_DISPLAY_TYPES> lists{{ nullptr, nullptr, nullptr }};
 #endif
-    std::vector<std::shared_ptr<mg::Buffer>> next_onscreen_overlay_buffers;
+    std::map<DisplayName, std::vector<std::shared_ptr<mg::Buffer>>> next_onscreen_overlay_buffers;
 
     for (auto& content : contents)
     {
@@ -103,29 +216,111 @@ void mga::HwcDevice::commit(std::list<DisplayContents> const& contents)
 
         content.list.setup_fb(content.context.last_rendered_buffer());
     }
+    auto const set_again = set_again_unless_committed(lists);
+    if (contents.empty() && set_again.empty())
+        return;
+
+    //if the same lists hold the same buffers in the same places, the hwc would make the same decisions.
+    //displays in sync groups of their own are committed on their own, so only the lists being
+    //committed are compared.
+    bool same_lists = true;
+    for (auto i = 0u; i < lists.size(); i++)
+        same_lists &= !lists[i] || (lists[i] == prepared_lists[i]);
+    bool const reuse_composition = same_lists &&
+        std::all_of(contents.begin(), contents.end(),
+            [](DisplayContents const& content) { return content.list.composition_reusable(); });
+
+    if (reuse_composition)
+    {
+        for (auto& content : contents)
+            content.list.reuse_composition();
+        report->report_prepare_skipped();
+
+        //nothing new to post if the gl-composited layers are still in the last fb target
+        bool const idle = std::all_of(contents.begin(), contents.end(),
+            [](DisplayContents const& content)
+            {
+                return !content.list.needs_swapbuffers() ||
+                    (!content.list.rejected_renderables().empty() &&
+                     content.list.fb_target_matches(*content.context.last_rendered_buffer()));
+            });
+        if (idle)
+        {
+            report->report_frame_elided();
+            return;
+        }
+    }
+    else
+    {
+        auto const primary = std::find_if(contents.begin(), contents.end(),
+            [](DisplayContents const& content) { return content.name == mga::DisplayName::primary; });
+        bool const search = (composition_search_budget.count() > 0) && (primary != contents.end()) &&
+            (primary->list.renderable_layers() > 1);
 
-    hwc_wrapper->prepare(lists);
+        //a plan only holds for the frame it was searched for, the other lists are prepared unforced
+        for (auto& content : contents)
+        {
+            if (!search || (content.name != mga::DisplayName::primary))
+                content.list.force_gl_render(std::vector<bool>(content.list.renderable_layers(), false));
+        }
+
+        if (search)
+            search_composition(primary->list, lists);
+        else
+            hwc_wrapper->prepare(lists);
+
+        for (auto& content : contents)
+            content.list.prepare_occurred();
+        for (auto i = 0u; i < lists.size(); i++)
+        {
+            if (lists[i])
+                prepared_lists[i] = lists[i];
+        }
+    }
+
+    times.prepared = monotonic_now();
+
+    for (auto& content : contents)
+        content.context.set_triple_buffering(content.list.triple_buffer_hinted());
 
     bool purely_overlays = true;
+    std::vector<FbTargetRender> fb_target_renders;
+    std::vector<DisplayContents const*> swapped;
 
     for (auto& content : contents)
     {
         if (content.list.needs_swapbuffers())
         {
             auto rejected_renderables = content.list.rejected_renderables();
-            if (!rejected_renderables.empty())
+            auto const fb_target = content.context.last_rendered_buffer();
+            //if only the overlays changed, the last fb target (already set up) can be shown again.
+            //it has no acquire fence, as its rendering completed before it was last posted.
+            if (rejected_renderables.empty() || !content.list.fb_target_matches(*fb_target))
             {
-                auto current_context = mir::raii::paired_calls(
-                    [&]{ content.context.make_current(); },
-                    [&]{ content.context.release_current(); });
-                content.compositor.render(std::move(rejected_renderables), content.list_offset, content.context);
+                if (!rejected_renderables.empty())
+                    fb_target_renders.push_back({&content, std::move(rejected_renderables)});
+                swapped.push_back(&content);
             }
+            purely_overlays = false;
+        }
+    }
+
+    render_fb_targets(fb_target_renders);
+    times.rendered = monotonic_now();
+
+    for (auto& content : contents)
+    {
+        if (std::find(swapped.begin(), swapped.end(), &content) != swapped.end())
+        {
+            if (std::any_of(fb_target_renders.begin(), fb_target_renders.end(),
+                    [&](FbTargetRender const& render) { return render.content == &content; }))
+                content.list.fb_target_rendered(*content.context.last_rendered_buffer());
             content.list.setup_fb(content.context.last_rendered_buffer());
             content.list.swap_occurred();
-            purely_overlays = false;
         }
-    
+
         //setup overlays
+        auto& next_onscreen = next_onscreen_overlay_buffers[content.name];
         for (auto& layer : content.list)
         {
             auto buffer = layer.layer.buffer();
@@ -133,25 +328,40 @@ void mga::HwcDevice::commit(std::list<DisplayContents> const& contents)
             {
                 if (!buffer_is_onscreen(*buffer))
                     layer.layer.set_acquirefence();
-                next_onscreen_overlay_buffers.push_back(buffer);
+                next_onscreen.push_back(buffer);
             }
         }
     }
 
-    hwc_wrapper->set(lists);
-    onscreen_overlay_buffers = std::move(next_onscreen_overlay_buffers);
-
-    for (auto& content : contents)
+    if (commit_thread.joinable())
     {
-        for (auto& it : content.list)
-            it.layer.release_buffer();
+        for (auto& next_onscreen : next_onscreen_overlay_buffers)
+            onscreen_overlay_buffers[next_onscreen.first] = std::move(next_onscreen.second);
+        hand_over(contents, lists, set_again, times);
+    }
+    else
+    {
+        set_lists(lists, set_again);
+        times.set = monotonic_now();
+        for (auto& next_onscreen : next_onscreen_overlay_buffers)
+            onscreen_overlay_buffers[next_onscreen.first] = std::move(next_onscreen.second);
 
-        mir::Fd retire_fd(content.list.retirement_fence());
+        for (auto& content : contents)
+        {
+            last_sets[as_hwc_display(content.name)] = content.list.snapshot();
+            content.list.set_occurred();
+            for (auto& it : content.list)
+                it.layer.release_buffer();
+
+            auto const frame = jank_detector.committed(content.name, times);
+            retire_fences.watch(content.name, frame, mir::Fd(content.list.retirement_fence()));
+        }
     }
 
     /*
-     * Test results (how long can we sleep for without missing a frame?):
-     *   arale:   10ms  (TODO: Find out why arale is so slow)
+     * Until the display group knows the vsync rate and how long its frames take, it sleeps
+     * as long as these devices could without missing a frame:
+     *   arale:   10ms
      *   mako:    15ms
      *   krillin: 11ms  (to be fair, the display is 67Hz)
      */
@@ -159,17 +369,283 @@ void mga::HwcDevice::commit(std::list<DisplayContents> const& contents)
     recommend_sleep = purely_overlays ? 10ms : 0ms;
 }
 
+/* Each display has its own gl context, so their fb targets can be rendered at the same time.
+ * The first is rendered here and any others on their own render threads. */
+void mga::HwcDevice::render_fb_targets(std::vector<FbTargetRender>& renders)
+{
+    auto const render = [](FbTargetRender& fb_target_render)
+    {
+        auto const& content = *fb_target_render.content;
+        auto current_context = mir::raii::paired_calls(
+            [&]{ content.context.make_current(); },
+            [&]{ content.context.release_current(); });
+        content.compositor.render(
+            std::move(fb_target_render.renderables), content.list_offset,
+            content.list.overlays_without_clear_hint(), content.context);
+    };
+
+    if (renders.empty())
+        return;
+
+    std::vector<RenderThread*> running;
+    for (auto it = std::next(renders.begin()); it != renders.end(); it++)
+    {
+        auto& thread = render_threads[it->content->name];
+        if (!thread)
+            thread.reset(new RenderThread);
+        auto& fb_target_render = *it;
+        thread->run([&] { render(fb_target_render); });
+        running.push_back(thread.get());
+    }
+
+    //the other threads use renders, so they are waited for even if this render fails
+    std::exception_ptr error;
+    try
+    {
+        render(renders.front());
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    for (auto thread : running)
+    {
+        try
+        {
+            thread->wait();
+        }
+        catch (...)
+        {
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/* Passes the prepared lists to the commit thread. The layer lists carry on with copies, which
+ * stand in for the prepared lists when checking whether the next frame can reuse the composition. */
+void mga::HwcDevice::hand_over(
+    std::list<DisplayContents> const& contents,
+    std::array<hwc_display_contents_1*, HWC_NUM_DISPLAY_TYPES> const& lists,
+    std::vector<size_t> const& set_again,
+    JankDetector::CommitTimes const& times)
+{
+    std::unique_ptr<PendingSet> pending{new PendingSet{lists, {}, {}, times, set_again}};
+    for (auto& content : contents)
+    {
+        auto const prepared_list = content.list.native_list();
+        pending->snapshots.push_back(content.list.hand_over());
+        pending->displays.push_back(content.name);
+        for (auto i = 0u; i < lists.size(); i++)
+        {
+            if (lists[i] != prepared_list)
+                continue;
+            pending->lists[i] = pending->snapshots.back()->native_list();
+            if (prepared_lists[i] == prepared_list)
+                prepared_lists[i] = content.list.native_list();
+        }
+    }
+
+    {
+        std::lock_guard<decltype(pending_mutex)> lk(pending_mutex);
+        pending_set = std::move(pending);
+    }
+    pending_changed.notify_all();
+}
+
+std::exception_ptr mga::HwcDevice::wait_for_pending_set()
+{
+    std::unique_lock<decltype(pending_mutex)> lk(pending_mutex);
+    pending_changed.wait(lk, [this] { return !pending_set; });
+    auto const error = set_error;
+    set_error = nullptr;
+    return error;
+}
+
+void mga::HwcDevice::run_commit_thread()
+{
+    std::unique_lock<decltype(pending_mutex)> lk(pending_mutex);
+    while (true)
+    {
+        pending_changed.wait(lk, [this] { return stopping || pending_set; });
+        if (!pending_set)
+            return;
+
+        //commit() does not touch the pending set until it is done with
+        lk.unlock();
+        std::exception_ptr error;
+        try
+        {
+            set_lists(pending_set->lists, pending_set->set_again);
+            pending_set->times.set = monotonic_now();
+            for (auto i = 0u; i < pending_set->snapshots.size(); i++)
+            {
+                auto& snapshot = pending_set->snapshots[i];
+                auto const name = pending_set->displays[i];
+                snapshot->set_occurred();
+                auto const frame = jank_detector.committed(name, pending_set->times);
+                retire_fences.watch(name, frame, mir::Fd(snapshot->retirement_fence()));
+                last_sets[as_hwc_display(name)] = std::move(snapshot);
+            }
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        lk.lock();
+
+        set_error = error;
+        pending_set.reset();
+        pending_changed.notify_all();
+    }
+}
+
+std::vector<size_t> mga::HwcDevice::set_again_unless_committed(
+    std::array<hwc_display_contents_1*, HWC_NUM_DISPLAY_TYPES>& lists)
+{
+    std::vector<size_t> set_again;
+    for (auto i = 0u; i < lists.size(); i++)
+    {
+        if (!lists[i] && last_sets[i])
+        {
+            lists[i] = last_sets[i]->list_to_set_again();
+            set_again.push_back(i);
+        }
+    }
+    return set_again;
+}
+
+void mga::HwcDevice::set_lists(
+    std::array<hwc_display_contents_1*, HWC_NUM_DISPLAY_TYPES> const& lists, std::vector<size_t> const& set_again)
+{
+    try
+    {
+        hwc_wrapper->set(lists);
+    }
+    catch (...)
+    {
+        //a display set again may have gone. It is set again once it has been committed itself.
+        for (auto i : set_again)
+            last_sets[i].reset();
+        throw;
+    }
+
+    //the frames of a display are counted from its own commits
+    for (auto i : set_again)
+    {
+        last_sets[i]->set_occurred();
+        mir::Fd const retirement_fence{last_sets[i]->retirement_fence()};
+    }
+}
+
+/* Tries out plans for the primary display until the time budget runs out, and keeps the one that
+ * leaves the fewest pixels to gl. The plan is remembered, so the same layers are only searched once.
+ * The layers are remembered by everything the hwc plans them with: the buffer (which stands for its
+ * format and size too), where it goes, how it is cropped, transformed and blended, and whether it
+ * was set up to be skipped. */
+void mga::HwcDevice::search_composition(
+    LayerList& list, std::array<hwc_display_contents_1*, HWC_NUM_DISPLAY_TYPES> const& lists)
+{
+    size_t const max_cached_plans{32};
+    auto const& native_list = *list.native_list();
+    auto const renderable_layers = list.renderable_layers();
+
+    std::vector<int64_t> layout;
+    auto layer = list.begin();
+    for (auto i = 0u; i < renderable_layers; i++, layer++)
+    {
+        auto const& native_layer = native_list.hwLayers[i];
+        auto const& frame = native_layer.displayFrame;
+        int32_t crop[4];
+        static_assert(sizeof(crop) == sizeof(native_layer.sourceCropf), "crop is four 32 bit values");
+        memcpy(crop, &native_layer.sourceCropf, sizeof(crop));
+        layout.insert(layout.end(), {
+            reinterpret_cast<intptr_t>(native_layer.handle),
+            layer->layer.unforced_flags(),
+            native_layer.transform,
+            native_layer.blending,
+            native_layer.planeAlpha,
+            frame.left, frame.top, frame.right, frame.bottom,
+            crop[0], crop[1], crop[2], crop[3]});
+    }
+
+    auto const cached = composition_plans.find(layout);
+    if (cached != composition_plans.end())
+    {
+        list.force_gl_render(cached->second);
+        hwc_wrapper->prepare(lists);
+        return;
+    }
+
+    auto const deadline = std::chrono::steady_clock::now() + composition_search_budget;
+    std::vector<bool> best_plan;
+    long best_fill = 0;
+    bool best_plan_prepared = false;
+    for (auto const& plan : candidate_plans(native_list, renderable_layers))
+    {
+        if (!best_plan.empty() && (std::chrono::steady_clock::now() >= deadline))
+            break;
+
+        list.force_gl_render(plan);
+        hwc_wrapper->prepare(lists);
+        auto const fill = gl_fill(native_list, renderable_layers);
+        best_plan_prepared = best_plan.empty() || (fill < best_fill);
+        if (best_plan_prepared)
+        {
+            best_plan = plan;
+            best_fill = fill;
+        }
+    }
+
+    //the hwc expects set() to get the list it last prepared
+    if (!best_plan_prepared)
+    {
+        list.force_gl_render(best_plan);
+        hwc_wrapper->prepare(lists);
+    }
+
+    if (composition_plans.size() >= max_cached_plans)
+        composition_plans.clear();
+    composition_plans[layout] = best_plan;
+}
+
 std::chrono::milliseconds mga::HwcDevice::recommended_sleep() const
 {
-    return recommend_sleep;
+    return recommend_sleep.load();
 }
 
 void mga::HwcDevice::content_cleared()
 {
+    std::lock_guard<decltype(commit_mutex)> lk(commit_mutex);
+    //the display is going off, so a failed set() does not matter any more
+    wait_for_pending_set();
     onscreen_overlay_buffers.clear();
+    prepared_lists.fill(nullptr);
+    for (auto& last_set : last_sets)
+        last_set.reset();
 }
 
 bool mga::HwcDevice::can_swap_buffers() const
 {
     return true;
 }
+
+void mga::HwcDevice::subscribe_to_presentation(
+    std::function<void(DisplayName, mg::Frame::Timestamp)> const& presented)
+{
+    std::lock_guard<decltype(presented_mutex)> lk(presented_mutex);
+    presented_callback = presented;
+}
+
+void mga::HwcDevice::on_presented(DisplayName name, uint64_t frame, mg::Frame::Timestamp timestamp)
+{
+    jank_detector.presented(name, frame, timestamp.nanoseconds);
+
+    std::lock_guard<decltype(presented_mutex)> lk(presented_mutex);
+    if (presented_callback)
+        presented_callback(name, timestamp);
+}
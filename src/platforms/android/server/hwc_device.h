@@ -23,8 +23,20 @@
 #include "sync_fence.h"
 #include "display_device.h"
 #include "hwc_layerlist.h"
+#include "render_thread.h"
+#include "retire_fence_watcher.h"
+#include "jank_detector.h"
 #include <memory>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <chrono>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
 
 namespace mir
 {
@@ -37,25 +49,93 @@ namespace android
 class SyncFileOps;
 class HwcWrapper;
 class HwcConfiguration;
+class HwcReport;
 
 class HwcDevice : public DisplayDevice
 {
 public:
-    HwcDevice(std::shared_ptr<HwcWrapper> const& hwc_wrapper);
+    HwcDevice(std::shared_ptr<HwcWrapper> const& hwc_wrapper, std::shared_ptr<HwcReport> const& report);
+    //with a non-zero budget, different splits between overlays and gl are tried for new layouts
+    HwcDevice(
+        std::shared_ptr<HwcWrapper> const& hwc_wrapper,
+        std::shared_ptr<HwcReport> const& report,
+        std::chrono::microseconds composition_search_budget);
+    //with pipelined_commit, set() runs on a commit thread while the next frame is composited.
+    //commit() waits for the last set() to finish before preparing, so one frame is in flight at most.
+    HwcDevice(
+        std::shared_ptr<HwcWrapper> const& hwc_wrapper,
+        std::shared_ptr<HwcReport> const& report,
+        std::chrono::microseconds composition_search_budget,
+        bool pipelined_commit);
+    ~HwcDevice();
 
     bool compatible_renderlist(RenderableList const& renderlist) override;
     void commit(std::list<DisplayContents> const& contents) override;
     void content_cleared() override;
     std::chrono::milliseconds recommended_sleep() const override;
     bool can_swap_buffers() const override;
+    void subscribe_to_presentation(
+        std::function<void(DisplayName, graphics::Frame::Timestamp)> const& presented) override;
 
 private:
+    struct PendingSet
+    {
+        std::array<hwc_display_contents_1*, HWC_NUM_DISPLAY_TYPES> lists;
+        std::vector<std::unique_ptr<LayerListSnapshot>> snapshots;
+        std::vector<DisplayName> displays;
+        JankDetector::CommitTimes times;
+        //the displays set again with their last lists
+        std::vector<size_t> set_again;
+    };
+    void hand_over(std::list<DisplayContents> const& contents,
+                   std::array<hwc_display_contents_1*, HWC_NUM_DISPLAY_TYPES> const& lists,
+                   std::vector<size_t> const& set_again,
+                   JankDetector::CommitTimes const& times);
+    void on_presented(DisplayName name, uint64_t frame, graphics::Frame::Timestamp timestamp);
+    //returns the error from the last set(), if it failed
+    std::exception_ptr wait_for_pending_set();
+    void run_commit_thread();
+    //the hwc takes a display missing from set() as disabled, so the displays not being committed
+    //get their last lists again. Returns the displays that do.
+    std::vector<size_t> set_again_unless_committed(std::array<hwc_display_contents_1*, HWC_NUM_DISPLAY_TYPES>& lists);
+    void set_lists(
+        std::array<hwc_display_contents_1*, HWC_NUM_DISPLAY_TYPES> const& lists, std::vector<size_t> const& set_again);
+
+    struct FbTargetRender
+    {
+        DisplayContents const* content;
+        RenderableList renderables;
+    };
+    void render_fb_targets(std::vector<FbTargetRender>& renders);
+
     bool buffer_is_onscreen(Buffer const&) const;
-    std::vector<std::shared_ptr<Buffer>> onscreen_overlay_buffers;
+    void search_composition(
+        LayerList& list, std::array<hwc_display_contents_1*, HWC_NUM_DISPLAY_TYPES> const& lists);
+    //displays with their own sync groups commit from different threads
+    std::mutex commit_mutex;
+    std::map<DisplayName, std::vector<std::shared_ptr<Buffer>>> onscreen_overlay_buffers;
+    std::array<hwc_display_contents_1*, HWC_NUM_DISPLAY_TYPES> prepared_lists;
+    //the lists last set on each display, set again while other displays are committed on their own
+    std::array<std::unique_ptr<LayerListSnapshot>, HWC_NUM_DISPLAY_TYPES> last_sets;
 
     std::shared_ptr<HwcWrapper> const hwc_wrapper;
+    std::shared_ptr<HwcReport> const report;
+    std::chrono::microseconds const composition_search_budget;
+    std::map<std::vector<int64_t>, std::vector<bool>> composition_plans;
     std::shared_ptr<SyncFileOps> const sync_ops;
-    std::chrono::milliseconds recommend_sleep{0};
+    JankDetector jank_detector;
+    std::mutex presented_mutex;
+    std::function<void(DisplayName, graphics::Frame::Timestamp)> presented_callback;
+    RetireFenceWatcher retire_fences;
+    std::atomic<std::chrono::milliseconds> recommend_sleep{std::chrono::milliseconds{0}};
+    std::map<DisplayName, std::unique_ptr<RenderThread>> render_threads;
+
+    std::mutex pending_mutex;
+    std::condition_variable pending_changed;
+    std::unique_ptr<PendingSet> pending_set;
+    std::exception_ptr set_error;
+    bool stopping{false};
+    std::thread commit_thread;
 };
 
 }
@@ -23,6 +23,7 @@
 #include "hwc_fallback_gl_renderer.h"
 #include "swapping_gl_context.h"
 #include "buffer.h"
+#include "mir/graphics/buffer.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_PRECISION_MEDIUMP_FLOAT
@@ -31,6 +32,7 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <GLES2/gl2.h>
+#include <algorithm>
 
 namespace mg = mir::graphics;
 namespace mgl = mir::gl;
@@ -55,30 +57,100 @@ std::string const fragment_shader
 {
     "precision mediump float;\n"
     "uniform sampler2D tex;\n"
+    "uniform float alpha;\n"
     "varying vec2 v_texcoord;\n"
     "void main() {\n"
-    "   gl_FragColor = texture2D(tex, v_texcoord);\n"
+    "   gl_FragColor = alpha * texture2D(tex, v_texcoord);\n"
     "}\n"
 };
 
-void set_display_transform(GLint uniform_loc, geom::Rectangle const& rect)
+glm::mat4 display_transform_for(glm::mat2 const& transformation, geom::Size const& size)
 {
-    glm::mat4 disp_transform(1.0);
+    glm::mat4 disp_transform(transformation);
 
     disp_transform = glm::translate(disp_transform, glm::vec3{-1.0, 1.0, 0.0});
     disp_transform = glm::scale(
                         disp_transform,
-                        glm::vec3{2.0/rect.size.width.as_int(),
-                                  -2.0/rect.size.height.as_int(),
+                        glm::vec3{2.0/size.width.as_int(),
+                                  -2.0/size.height.as_int(),
                                   1.0});
-    glUniformMatrix4fv(uniform_loc, 1, GL_FALSE, glm::value_ptr(disp_transform));
+    return disp_transform;
+}
+
+//framebuffers older than this are redrawn in full
+size_t const max_damage_history{4};
+
+bool is_empty(geom::Rectangle const& rect)
+{
+    return (rect.size.width.as_int() <= 0) || (rect.size.height.as_int() <= 0);
+}
+
+geom::Rectangle bounding(geom::Rectangle const& a, geom::Rectangle const& b)
+{
+    if (is_empty(a))
+        return b;
+    if (is_empty(b))
+        return a;
+
+    auto const left = std::min(a.top_left.x.as_int(), b.top_left.x.as_int());
+    auto const top = std::min(a.top_left.y.as_int(), b.top_left.y.as_int());
+    auto const right = std::max(a.bottom_right().x.as_int(), b.bottom_right().x.as_int());
+    auto const bottom = std::max(a.bottom_right().y.as_int(), b.bottom_right().y.as_int());
+    return {{left, top}, {right - left, bottom - top}};
+}
+
+geom::Rectangle intersection(geom::Rectangle const& a, geom::Rectangle const& b)
+{
+    auto const left = std::max(a.top_left.x.as_int(), b.top_left.x.as_int());
+    auto const top = std::max(a.top_left.y.as_int(), b.top_left.y.as_int());
+    auto const right = std::min(a.bottom_right().x.as_int(), b.bottom_right().x.as_int());
+    auto const bottom = std::min(a.bottom_right().y.as_int(), b.bottom_right().y.as_int());
+    if ((right <= left) || (bottom <= top))
+        return {};
+    return {{left, top}, {right - left, bottom - top}};
+}
+
+//the parts of the region outside of hole
+std::vector<geom::Rectangle> subtract(std::vector<geom::Rectangle> const& region, geom::Rectangle const& hole)
+{
+    std::vector<geom::Rectangle> remaining;
+    for (auto const& rect : region)
+    {
+        auto const overlap = intersection(rect, hole);
+        if (is_empty(overlap))
+        {
+            remaining.push_back(rect);
+            continue;
+        }
+
+        auto const left = rect.top_left.x.as_int();
+        auto const top = rect.top_left.y.as_int();
+        auto const right = rect.bottom_right().x.as_int();
+        auto const bottom = rect.bottom_right().y.as_int();
+        auto const overlap_top = overlap.top_left.y.as_int();
+        auto const overlap_bottom = overlap.bottom_right().y.as_int();
+        geom::Rectangle const pieces[] {
+            {{left, top}, {right - left, overlap_top - top}},
+            {{left, overlap_bottom}, {right - left, bottom - overlap_bottom}},
+            {{left, overlap_top}, {overlap.top_left.x.as_int() - left, overlap_bottom - overlap_top}},
+            {{overlap.bottom_right().x.as_int(), overlap_top},
+             {right - overlap.bottom_right().x.as_int(), overlap_bottom - overlap_top}}
+        };
+        for (auto const& piece : pieces)
+        {
+            if (!is_empty(piece))
+                remaining.push_back(piece);
+        }
+    }
+    return remaining;
 }
 }
 
 mga::HWCFallbackGLRenderer::HWCFallbackGLRenderer(
     gl::ProgramFactory const& factory,
     renderer::gl::Context const& context,
-    geom::Rectangle const& screen_pos)
+    geom::Rectangle const& screen_pos) :
+    fb_size(screen_pos.size)
 {
     context.make_current();
     program = factory.create_gl_program(vertex_shader, fragment_shader);
@@ -86,8 +158,9 @@ mga::HWCFallbackGLRenderer::HWCFallbackGLRenderer(
 
     glUseProgram(*program);
 
-    auto display_transform_uniform = glGetUniformLocation(*program, "display_transform");
-    set_display_transform(display_transform_uniform, screen_pos); 
+    display_transform_uniform = glGetUniformLocation(*program, "display_transform");
+    display_transform = display_transform_for(glm::mat2(1.0), screen_pos.size);
+    glUniformMatrix4fv(display_transform_uniform, 1, GL_FALSE, glm::value_ptr(display_transform));
 
     position_attr = glGetAttribLocation(*program, "position");
     texcoord_attr = glGetAttribLocation(*program, "texcoord");
@@ -95,36 +168,241 @@ mga::HWCFallbackGLRenderer::HWCFallbackGLRenderer(
     auto tex_loc = glGetUniformLocation(*program, "tex");
     glUniform1i(tex_loc, 0);
 
+    alpha_uniform = glGetUniformLocation(*program, "alpha");
+    glUniform1f(alpha_uniform, 1.0f);
+
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     glUseProgram(0);
     context.release_current();
 }
 
-void mga::HWCFallbackGLRenderer::render(
-    RenderableList const& renderlist, geom::Displacement offset, SwappingGLContext const& context) const
+void mga::HWCFallbackGLRenderer::set_transformation(
+    glm::mat2 const& transformation, geom::Size const& view_size)
+{
+    display_transform = display_transform_for(transformation, view_size);
+    display_transform_changed = true;
+    rotated = (transformation != glm::mat2(1.0));
+    invalidate_damage();
+}
+
+void mga::HWCFallbackGLRenderer::invalidate_damage()
+{
+    damage_history.clear();
+    last_drawn.clear();
+    last_overlaid.clear();
+}
+
+/* The framebuffer being drawn still holds the frame from buffer_age frames ago,
+ * so only the area that changed since then needs to be redrawn. The framebuffer is
+ * neither cleared nor drawn under the overlays, so an area that stops being overlaid
+ * is damaged too. */
+geom::Rectangle mga::HWCFallbackGLRenderer::damage_for(
+    RenderableList const& renderlist, geom::Displacement offset,
+    std::vector<geom::Rectangle> const& overlaid, unsigned int buffer_age) const
+{
+    geom::Rectangle const screen{{0,0}, fb_size};
+
+    std::vector<DrawnRenderable> drawn;
+    for (auto const& renderable : renderlist)
+    {
+        auto position = renderable->screen_position();
+        position.top_left = position.top_left - offset;
+        drawn.push_back({renderable->id(), renderable->buffer()->id(),
+                         position, renderable->alpha(), renderable->shaped()});
+    }
+
+    geom::Rectangle frame_damage;
+    if (damage_history.empty())
+    {
+        frame_damage = screen;
+    }
+    else
+    {
+        for (auto i = 0u; i < std::max(drawn.size(), last_drawn.size()); i++)
+        {
+            if (i >= drawn.size())
+                frame_damage = bounding(frame_damage, last_drawn[i].position);
+            else if (i >= last_drawn.size())
+                frame_damage = bounding(frame_damage, drawn[i].position);
+            else if ((drawn[i].id != last_drawn[i].id) ||
+                     (drawn[i].buffer_id != last_drawn[i].buffer_id) ||
+                     (drawn[i].position != last_drawn[i].position) ||
+                     (drawn[i].alpha != last_drawn[i].alpha) ||
+                     (drawn[i].shaped != last_drawn[i].shaped))
+                frame_damage = bounding(frame_damage,
+                    bounding(drawn[i].position, last_drawn[i].position));
+        }
+
+        for (auto const& rect : last_overlaid)
+        {
+            if (std::find(overlaid.begin(), overlaid.end(), rect) == overlaid.end())
+                frame_damage = bounding(frame_damage, rect);
+        }
+    }
+
+    last_drawn = std::move(drawn);
+    last_overlaid = overlaid;
+    damage_history.push_front(intersection(frame_damage, screen));
+    if (damage_history.size() > max_damage_history)
+        damage_history.pop_back();
+
+    if (rotated || (buffer_age == 0) || (buffer_age > damage_history.size()))
+        return screen;
+
+    geom::Rectangle damage;
+    for (auto i = 0u; i < buffer_age; i++)
+        damage = bounding(damage, damage_history[i]);
+    return damage;
+}
+
+/* The framebuffer only needs clearing where nothing opaque is drawn over it. The hwc asks for it
+ * to be cleared under the overlays it blends the framebuffer over (HWC_HINT_CLEAR_FB), so those
+ * are not in overlaid. The damage holds the areas overlaid in earlier frames, which were left
+ * uncleared then. Returns the bounds of what is left to clear within the damage. */
+geom::Rectangle mga::HWCFallbackGLRenderer::clear_area_for(
+    RenderableList const& renderlist, geom::Displacement offset,
+    std::vector<geom::Rectangle> const& overlaid, geom::Rectangle const& damage) const
+{
+    std::vector<geom::Rectangle> uncovered{damage};
+    for (auto const& rect : overlaid)
+        uncovered = subtract(uncovered, rect);
+
+    //renderables are placed in the view, which only lines up with the framebuffer when not rotated
+    if (!rotated)
+    {
+        for (auto const& renderable : renderlist)
+        {
+            if (renderable->shaped() || (renderable->alpha() < 1.0f))
+                continue;
+            auto position = renderable->screen_position();
+            position.top_left = position.top_left - offset;
+            uncovered = subtract(uncovered, position);
+        }
+    }
+
+    geom::Rectangle area;
+    for (auto const& rect : uncovered)
+        area = bounding(area, rect);
+    return area;
+}
+
+//gl has its origin at the bottom left
+void mga::HWCFallbackGLRenderer::scissor(geom::Rectangle const& area) const
+{
+    glScissor(
+        area.top_left.x.as_int(),
+        fb_size.height.as_int() - area.bottom_right().y.as_int(),
+        area.size.width.as_int(),
+        area.size.height.as_int());
+}
+
+void mga::HWCFallbackGLRenderer::use_program() const
 {
     glUseProgram(*program);
 
+    if (display_transform_changed)
+    {
+        glUniformMatrix4fv(display_transform_uniform, 1, GL_FALSE, glm::value_ptr(display_transform));
+        display_transform_changed = false;
+    }
+}
+
+void mga::HWCFallbackGLRenderer::render(
+    RenderableList const& renderlist,
+    geom::Displacement offset,
+    std::vector<geom::Rectangle> const& overlaid,
+    SwappingGLContext const& context) const
+{
+    use_program();
+
+    geom::Rectangle const screen{{0,0}, fb_size};
+    auto const damage = damage_for(renderlist, offset, overlaid, context.buffer_age());
+    bool const partial_redraw = (damage != screen);
+    if (partial_redraw)
+    {
+        glEnable(GL_SCISSOR_TEST);
+        scissor(damage);
+    }
+
     /* NOTE: some HWC implementations rely on the framebuffer target layer
      * being cleared to transparent black. eg, in mixed-mode composition,
      * krillin actually arranges the fb_target in the topmost level of its
      * display controller and relies on blending to make the overlays appear
-     * /under/ the gl layer. (lp: #1378326)
+     * /under/ the gl layer. (lp: #1378326). Such HWCs raise HWC_HINT_CLEAR_FB
+     * on the overlays, which keeps them out of overlaid.
      */
-    glClearColor(0.0, 0.0, 0.0, 0.0);
-    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-    glClear(GL_COLOR_BUFFER_BIT);
+    auto const clear_area = clear_area_for(renderlist, offset, overlaid, damage);
+    if (!is_empty(clear_area))
+    {
+        bool const partial_clear = (clear_area != damage);
+        if (partial_clear)
+        {
+            glEnable(GL_SCISSOR_TEST);
+            scissor(clear_area);
+        }
+
+        glClearColor(0.0, 0.0, 0.0, 0.0);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        if (partial_clear && partial_redraw)
+            scissor(damage);
+        else if (partial_clear)
+            glDisable(GL_SCISSOR_TEST);
+    }
+
+    draw(renderlist, offset, damage);
+
+    if (partial_redraw)
+    {
+        glDisable(GL_SCISSOR_TEST);
+        context.swap_buffers_with_damage(damage);
+    }
+    else
+    {
+        context.swap_buffers();
+    }
+    texture_cache->drop_unused();
+    glUseProgram(0);
+}
+
+void mga::HWCFallbackGLRenderer::draw_over(RenderableList const& renderlist, geom::Displacement offset) const
+{
+    use_program();
+    draw(renderlist, offset, {{0,0}, fb_size});
+    glUseProgram(0);
+}
+
+//renderables outside of the damage are not drawn
+void mga::HWCFallbackGLRenderer::draw(
+    RenderableList const& renderlist, geom::Displacement offset, geom::Rectangle const& damage) const
+{
+    bool const partial_redraw = (damage != geom::Rectangle{{0,0}, fb_size});
     glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
     glEnableVertexAttribArray(position_attr);
     glEnableVertexAttribArray(texcoord_attr);
 
     for(auto const& renderable : renderlist)
     {
-        if (renderable->shaped())  // TODO: support alpha() in future
+        if (partial_redraw)
+        {
+            auto position = renderable->screen_position();
+            position.top_left = position.top_left - offset;
+            if (is_empty(intersection(position, damage)))
+            {
+                //keep the texture cached for when the renderable is damaged
+                texture_cache->load(*renderable);
+                continue;
+            }
+        }
+
+        auto const alpha = renderable->alpha();
+        if (renderable->shaped() || alpha < 1.0f)
             glEnable(GL_BLEND);
         else
             glDisable(GL_BLEND);
+        glUniform1f(alpha_uniform, alpha);
 
         auto const primitive = mgl::tessellate_renderable_into_rectangle(*renderable, offset);
         glVertexAttribPointer(position_attr, 3, GL_FLOAT, GL_FALSE, sizeof(mgl::Vertex),
@@ -139,7 +417,4 @@ void mga::HWCFallbackGLRenderer::render(
 
     glDisableVertexAttribArray(texcoord_attr);
     glDisableVertexAttribArray(position_attr);
-    context.swap_buffers();
-    texture_cache->drop_unused();
-    glUseProgram(0);
 }
@@ -23,8 +23,11 @@
 #include "mir/gl/program.h"
 #include "mir/gl/texture_cache.h"
 #include "mir/graphics/renderable.h"
+#include "mir/graphics/buffer_id.h"
 #include "mir/renderer/gl/context.h"
 #include <memory>
+#include <deque>
+#include <vector>
 
 namespace mir
 {
@@ -39,7 +42,12 @@ class RenderableListCompositor
 {
 public:
     virtual ~RenderableListCompositor() = default;
-    virtual void render(RenderableList const&, geometry::Displacement list_offset, SwappingGLContext const&) const = 0;
+    //the framebuffer is not cleared in the overlaid areas, which the hwc covers with opaque overlays
+    virtual void render(
+        RenderableList const&,
+        geometry::Displacement list_offset,
+        std::vector<geometry::Rectangle> const& overlaid,
+        SwappingGLContext const&) const = 0;
 protected:
     RenderableListCompositor() = default;
 private:
@@ -55,13 +63,53 @@ public:
         renderer::gl::Context const& gl_context,
         geometry::Rectangle const& screen_position);
 
-    void render(RenderableList const&, geometry::Displacement, SwappingGLContext const&) const;
+    void render(
+        RenderableList const&,
+        geometry::Displacement,
+        std::vector<geometry::Rectangle> const& overlaid,
+        SwappingGLContext const&) const;
+    //draws the renderables over what is in the framebuffer, without clearing or swapping it
+    void draw_over(RenderableList const&, geometry::Displacement) const;
+    //rotates the output into the framebuffer. Takes effect on the next render().
+    void set_transformation(glm::mat2 const& transformation, geometry::Size const& view_size);
+    //the framebuffer was drawn outside of render(), so the next render() redraws all of it
+    void invalidate_damage();
 private:
+    struct DrawnRenderable
+    {
+        Renderable::ID id;
+        BufferID buffer_id;
+        geometry::Rectangle position;
+        float alpha;
+        bool shaped;
+    };
+    geometry::Rectangle damage_for(
+        RenderableList const&, geometry::Displacement,
+        std::vector<geometry::Rectangle> const& overlaid, unsigned int buffer_age) const;
+    geometry::Rectangle clear_area_for(
+        RenderableList const&, geometry::Displacement,
+        std::vector<geometry::Rectangle> const& overlaid, geometry::Rectangle const& damage) const;
+    void scissor(geometry::Rectangle const& area) const;
+    void use_program() const;
+    void draw(RenderableList const&, geometry::Displacement, geometry::Rectangle const& damage) const;
+
+    geometry::Size const fb_size;
     std::unique_ptr<gl::Program> program;
     std::unique_ptr<gl::TextureCache> texture_cache;
 
+    GLint display_transform_uniform;
+    glm::mat4 display_transform;
+    bool mutable display_transform_changed{false};
+
     GLint position_attr;
     GLint texcoord_attr;
+    GLint alpha_uniform;
+
+    bool rotated{false};
+    std::vector<DrawnRenderable> mutable last_drawn;
+    std::vector<geometry::Rectangle> mutable last_overlaid;
+    //the damage of each of the last frames, most recent first
+    std::deque<geometry::Rectangle> mutable damage_history;
 };
 
 }
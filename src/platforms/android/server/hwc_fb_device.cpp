@@ -77,6 +77,7 @@ void mga::HwcFbDevice::commit(std::list<DisplayContents> const& contents)
         //set() may affect EGL state by calling eglSwapBuffers.
         //HWC 1.0 is the only version of HWC that can do this.
         hwc_wrapper->set({{display_list, nullptr, nullptr}});
+        layer_list.set_occurred();
     }
     else
     {
@@ -123,3 +124,9 @@ bool mga::HwcFbDevice::can_swap_buffers() const
 {
     return false;
 }
+
+//hwc 1.0 has no retire fences
+void mga::HwcFbDevice::subscribe_to_presentation(
+    std::function<void(DisplayName, mg::Frame::Timestamp)> const&)
+{
+}
@@ -46,6 +46,8 @@ public:
     void commit(std::list<DisplayContents> const& contents) override;
     std::chrono::milliseconds recommended_sleep() const override;
     bool can_swap_buffers() const override;
+    void subscribe_to_presentation(
+        std::function<void(DisplayName, graphics::Frame::Timestamp)> const& presented) override;
 
 private:
     void content_cleared() override;
@@ -23,6 +23,10 @@
 #include "hwc_layerlist.h"
 
 #include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+#include <limits>
 
 namespace mg=mir::graphics;
 namespace mga=mir::graphics::android;
@@ -49,6 +53,84 @@ std::shared_ptr<hwc_display_contents_1_t> generate_hwc_list(size_t needed_size)
 
     return new_hwc_representation;
 }
+
+//points the regions of the layer at copies in storage
+void copy_regions(hwc_layer_1_t& hwc_layer, std::list<std::vector<hwc_rect_t>>& storage)
+{
+    auto const& visible = hwc_layer.visibleRegionScreen;
+    storage.emplace_back(visible.rects, visible.rects + visible.numRects);
+    hwc_layer.visibleRegionScreen.rects = storage.back().data();
+    auto const& damage = hwc_layer.surfaceDamage;
+    if (damage.numRects)
+    {
+        storage.emplace_back(damage.rects, damage.rects + damage.numRects);
+        hwc_layer.surfaceDamage.rects = storage.back().data();
+    }
+}
+
+bool is_opaque(mg::Renderable const& renderable)
+{
+    static glm::mat4 const identity(1);
+    return !renderable.shaped() && (renderable.alpha() >= 1.0f) && (renderable.transformation() == identity);
+}
+
+//the parts of rect that are not covered by hole
+std::vector<geom::Rectangle> subtract(geom::Rectangle const& rect, geom::Rectangle const& hole)
+{
+    int const left = rect.top_left.x.as_int();
+    int const top = rect.top_left.y.as_int();
+    int const right = rect.bottom_right().x.as_int();
+    int const bottom = rect.bottom_right().y.as_int();
+    int const hole_left = std::max(left, hole.top_left.x.as_int());
+    int const hole_top = std::max(top, hole.top_left.y.as_int());
+    int const hole_right = std::min(right, hole.bottom_right().x.as_int());
+    int const hole_bottom = std::min(bottom, hole.bottom_right().y.as_int());
+    if ((hole_left >= hole_right) || (hole_top >= hole_bottom))
+        return {rect};
+
+    std::vector<geom::Rectangle> pieces;
+    if (top < hole_top)
+        pieces.push_back({{left, top}, {right - left, hole_top - top}});
+    if (hole_bottom < bottom)
+        pieces.push_back({{left, hole_bottom}, {right - left, bottom - hole_bottom}});
+    if (left < hole_left)
+        pieces.push_back({{left, hole_top}, {hole_left - left, hole_bottom - hole_top}});
+    if (hole_right < right)
+        pieces.push_back({{hole_right, hole_top}, {right - hole_right, hole_bottom - hole_top}});
+    return pieces;
+}
+
+//the parts of the renderable that are not hidden by the opaque renderables above it
+std::vector<geom::Rectangle> visible_region(
+    mg::RenderableList::const_iterator renderable, mg::RenderableList::const_iterator end)
+{
+    std::vector<geom::Rectangle> region{(*renderable)->screen_position()};
+    for (auto above = std::next(renderable); (above != end) && !region.empty(); above++)
+    {
+        if (!is_opaque(**above))
+            continue;
+
+        std::vector<geom::Rectangle> uncovered;
+        for (auto const& rect : region)
+        {
+            auto const pieces = subtract(rect, (*above)->screen_position());
+            uncovered.insert(uncovered.end(), pieces.begin(), pieces.end());
+        }
+        region = std::move(uncovered);
+    }
+    return region;
+}
+}
+
+mg::RenderableList mga::visible_renderables(mg::RenderableList const& renderlist)
+{
+    mg::RenderableList visible;
+    for (auto it = renderlist.begin(); it != renderlist.end(); it++)
+    {
+        if (!visible_region(it, renderlist.end()).empty())
+            visible.push_back(*it);
+    }
+    return visible;
 }
 
 mga::HwcLayerEntry::HwcLayerEntry(HWCLayer && layer, bool needs_commit) :
@@ -84,30 +166,104 @@ void mga::LayerList::update_list_mode(mg::RenderableList const& renderlist)
         mode = Mode::no_extra_layers;
 }
 
+void mga::LayerList::set_transformation(glm::mat2 const& new_transformation, geom::Size const& new_view_size)
+{
+    transformation = new_transformation;
+    hwc_transform = mga::as_hwc_transform(new_transformation);
+    view_size = new_view_size;
+    fb_target_valid = false;
+}
+
+//maps a rectangle in the (rotated) view area onto the unrotated framebuffer
+geom::Rectangle mga::LayerList::transformed(geom::Rectangle const& position) const
+{
+    if (hwc_transform == 0)
+        return position;
+    return mga::transformed(position, transformation, view_size);
+}
+
+void mga::LayerList::set_cursor(std::shared_ptr<mg::Renderable> const& new_cursor)
+{
+    cursor = new_cursor;
+}
+
+bool mga::LayerList::cursor_rejected() const
+{
+    return cursor_to_gl;
+}
+
+//the cursor layer is above the renderables and the skip layer, and below the fb target
+size_t mga::LayerList::cursor_index() const
+{
+    bool const has_skip = (mode == Mode::skip_only) || (mode == Mode::skip_and_target);
+    return renderable_list.size() + (has_skip ? 1 : 0);
+}
+
 void mga::LayerList::update_list(RenderableList const& renderlist, geometry::Displacement offset)
 {
     renderable_list = renderlist;
+    listed_cursor = cursor;
+    //an empty list means the framebuffer is drawn by the display compositor instead
+    if (renderlist.empty() || (offset != list_offset))
+        fb_target_valid = false;
+    list_offset = offset;
     update_list_mode(renderlist);
     size_t additional_layers = additional_layers_for(mode);
-    size_t needed_size = renderlist.size() + additional_layers;
+    size_t needed_size = renderlist.size() + additional_layers + (listed_cursor ? 1 : 0);
 
     if ((!hwc_representation) || hwc_representation->numHwLayers != needed_size)
     {
         hwc_representation = generate_hwc_list(needed_size);
     }
 
+    squashed_layers = squashable_layers(renderlist);
+    auto const type_of = [&](size_t index)
+    {
+        return (index < squashed_layers) ? mga::LayerType::squashed : mga::LayerType::gl_rendered;
+    };
+
+    //layers are cut down to the part that is on the display, once the display size is known
+    bool const clipped = (view_size != geom::Size{});
+    auto const display_area = transformed({{0, 0}, view_size});
+    auto const clip_area = [&](geom::Rectangle const& position)
+    {
+        return clipped ? display_area : position;
+    };
+
+    //parts of a layer under opaque layers above it are left out of its visible region
+    auto const screen_region = [&](RenderableList::const_iterator renderable)
+    {
+        std::vector<geom::Rectangle> region;
+        for (auto rect : visible_region(renderable, renderlist.end()))
+        {
+            rect.top_left = rect.top_left - offset;
+            auto const on_screen = clipped ? transformed(rect).intersection_with(display_area) : transformed(rect);
+            if (!clipped || ((on_screen.size.width.as_int() > 0) && (on_screen.size.height.as_int() > 0)))
+                region.push_back(on_screen);
+        }
+        return region;
+    };
+
+    bool geometry_changed = false;
     if (layers.size() == needed_size)
     {
         auto it = layers.begin();
-        for(auto renderable : renderlist)
+        auto i = 0u;
+        for (auto renderable = renderlist.begin(); renderable != renderlist.end(); renderable++)
         {
-            auto position = renderable->screen_position();
+            auto position = (*renderable)->screen_position();
             position.top_left = position.top_left - offset;
+            auto const screen_position = transformed(position);
             it->needs_commit = it->layer.setup_layer(
-                mga::LayerType::gl_rendered,
-                position,
-                renderable->shaped(), // TODO: support alpha() in future too
-                renderable->buffer());
+                type_of(i++),
+                screen_position,
+                clip_area(screen_position),
+                (*renderable)->shaped(),
+                (*renderable)->alpha(),
+                hwc_transform,
+                (*renderable)->buffer());
+            it->needs_commit |= it->layer.set_visible_region(screen_region(renderable));
+            geometry_changed |= it->layer.geometry_changed();
             it++;
         }
     }
@@ -115,17 +271,22 @@ void mga::LayerList::update_list(RenderableList const& renderlist, geometry::Dis
     {
         std::list<HwcLayerEntry> new_layers;
         auto i = 0u;
-        for(auto const& renderable : renderlist)
+        for (auto renderable = renderlist.begin(); renderable != renderlist.end(); renderable++)
         {
-            auto position = renderable->screen_position();
+            auto position = (*renderable)->screen_position();
             position.top_left = position.top_left - offset;
-            new_layers.emplace_back(
-                mga::HWCLayer(
-                    layer_adapter, hwc_representation, i++,
-                    mga::LayerType::gl_rendered,
-                    position,
-                    renderable->shaped(), // TODO: support alpha() in future
-                    renderable->buffer()), true);
+            auto const screen_position = transformed(position);
+            new_layers.emplace_back(mga::HWCLayer(layer_adapter, hwc_representation, i), true);
+            new_layers.back().layer.setup_layer(
+                type_of(i),
+                screen_position,
+                clip_area(screen_position),
+                (*renderable)->shaped(),
+                (*renderable)->alpha(),
+                hwc_transform,
+                (*renderable)->buffer());
+            new_layers.back().layer.set_visible_region(screen_region(renderable));
+            i++;
         }
 
         for(; i < needed_size; i++)
@@ -133,7 +294,28 @@ void mga::LayerList::update_list(RenderableList const& renderlist, geometry::Dis
             new_layers.emplace_back(mga::HWCLayer(layer_adapter, hwc_representation, i), false);
         }
         layers = std::move(new_layers);
+        geometry_changed = true;
+    }
+
+    if (listed_cursor)
+    {
+        auto position = listed_cursor->screen_position();
+        position.top_left = position.top_left - offset;
+        auto const screen_position = transformed(position);
+        auto& entry = *std::next(layers.begin(), cursor_index());
+        //not clipped, as the hwc moves the cursor layer by its unclipped position
+        entry.needs_commit = entry.layer.setup_layer(
+            mga::LayerType::cursor,
+            screen_position,
+            listed_cursor->shaped(),
+            listed_cursor->alpha(),
+            hwc_transform,
+            listed_cursor->buffer());
+        geometry_changed |= entry.layer.geometry_changed();
     }
+
+    if (geometry_changed)
+        replan_composition();
 }
 
 std::list<mga::HwcLayerEntry>::iterator mga::LayerList::begin()
@@ -157,6 +339,94 @@ mga::NativeFence mga::LayerList::retirement_fence()
     return hwc_representation->retireFenceFd;
 }
 
+/* The hwc gets the very list it prepared, as some implementations hold on to what they saw in
+ * prepare(). The regions it points at are copied, as the layers reuse their storage. */
+std::unique_ptr<mga::LayerListSnapshot> mga::LayerList::hand_over()
+{
+    std::unique_ptr<LayerListSnapshot> snapshot{new LayerListSnapshot};
+    auto const num_layers = hwc_representation->numHwLayers;
+    auto next_list = generate_hwc_list(num_layers);
+    memcpy(next_list.get(), hwc_representation.get(),
+           sizeof(hwc_display_contents_1_t) + sizeof(hwc_layer_1_t) * num_layers);
+    next_list->retireFenceFd = -1;
+    next_list->flags = 0;
+
+    auto i = 0u;
+    for (auto& entry : layers)
+    {
+        copy_regions(hwc_representation->hwLayers[i], snapshot->regions);
+        snapshot->buffers.push_back(entry.layer.buffer());
+        entry.layer.rebind(next_list, i++);
+    }
+
+    snapshot->list = std::move(hwc_representation);
+    hwc_representation = std::move(next_list);
+    renderable_list.clear();
+    return snapshot;
+}
+
+std::unique_ptr<mga::LayerListSnapshot> mga::LayerList::snapshot()
+{
+    std::unique_ptr<LayerListSnapshot> snapshot{new LayerListSnapshot};
+    auto const num_layers = hwc_representation->numHwLayers;
+    snapshot->list = generate_hwc_list(num_layers);
+    memcpy(snapshot->list.get(), hwc_representation.get(),
+           sizeof(hwc_display_contents_1_t) + sizeof(hwc_layer_1_t) * num_layers);
+
+    //the fences of the set belong to the layer list
+    auto i = 0u;
+    for (auto& entry : layers)
+    {
+        auto& hwc_layer = snapshot->list->hwLayers[i++];
+        copy_regions(hwc_layer, snapshot->regions);
+        bool const shown = hwc_layer.compositionType != HWC_FRAMEBUFFER;
+        snapshot->buffers.push_back(shown ? entry.layer.buffer() : nullptr);
+    }
+    snapshot->list_to_set_again();
+    return snapshot;
+}
+
+hwc_display_contents_1_t* mga::LayerListSnapshot::native_list()
+{
+    return list.get();
+}
+
+void mga::LayerListSnapshot::set_occurred()
+{
+    for (auto i = 0u; i < buffers.size(); i++)
+    {
+        auto& hwc_layer = list->hwLayers[i];
+        if ((hwc_layer.compositionType != HWC_FRAMEBUFFER) && buffers[i])
+        {
+            auto native_buffer = mga::to_native_buffer_checked(buffers[i]->native_buffer_handle());
+            native_buffer->update_usage(hwc_layer.releaseFenceFd, mga::BufferAccess::read);
+            hwc_layer.releaseFenceFd = -1;
+            hwc_layer.acquireFenceFd = -1;
+        }
+        else
+        {
+            buffers[i].reset();
+        }
+    }
+}
+
+mga::NativeFence mga::LayerListSnapshot::retirement_fence()
+{
+    return list->retireFenceFd;
+}
+
+hwc_display_contents_1_t* mga::LayerListSnapshot::list_to_set_again()
+{
+    list->retireFenceFd = -1;
+    list->flags = 0;
+    for (auto i = 0u; i < list->numHwLayers; i++)
+    {
+        list->hwLayers[i].acquireFenceFd = -1;
+        list->hwLayers[i].releaseFenceFd = -1;
+    }
+    return list.get();
+}
+
 mga::LayerList::LayerList(
     std::shared_ptr<LayerAdapter> const& layer_adapter,
     RenderableList const& renderlist,
@@ -184,6 +454,12 @@ mg::RenderableList mga::LayerList::rejected_renderables()
             rejected_renderables.push_back(renderable);
         it++;
     }
+
+    //without a skip layer, a cursor the hwc leaves to gl is rendered with the other renderables.
+    //over a skip layer, the fb target holds a finished frame, and the cursor is drawn into it before the swap.
+    if (listed_cursor && (cursor_index() == renderable_list.size()) &&
+        std::next(layers.begin(), cursor_index())->layer.needs_gl_render())
+        rejected_renderables.push_back(listed_cursor);
     return rejected_renderables;
 }
 
@@ -193,19 +469,211 @@ void mga::LayerList::setup_fb(std::shared_ptr<mg::Buffer> const& fb)
     auto it = layers.begin();
     std::advance(it, renderable_list.size());
 
+    bool geometry_changed = false;
     if (mode == Mode::skip_only)
     {
-        it->layer.setup_layer(mga::LayerType::skip, disp_frame, false, fb);
+        it->layer.setup_layer(mga::LayerType::skip, disp_frame, false, 1.0f, 0, fb);
+        geometry_changed = it->layer.geometry_changed();
     }
     else if (mode == Mode::target_only)
     {
-        it->layer.setup_layer(mga::LayerType::framebuffer_target, disp_frame, false, fb);
+        auto& target = layers.back().layer;
+        target.setup_layer(mga::LayerType::framebuffer_target, disp_frame, false, 1.0f, 0, fb);
+        geometry_changed = target.geometry_changed();
     }
     else if (mode == Mode::skip_and_target)
     {
-        it++->layer.setup_layer(mga::LayerType::skip, disp_frame, false, fb);
-        it->layer.setup_layer(mga::LayerType::framebuffer_target, disp_frame, false, fb);
+        it->layer.setup_layer(mga::LayerType::skip, disp_frame, false, 1.0f, 0, fb);
+        geometry_changed = it->layer.geometry_changed();
+        auto& target = layers.back().layer;
+        target.setup_layer(mga::LayerType::framebuffer_target, disp_frame, false, 1.0f, 0, fb);
+        geometry_changed |= target.geometry_changed();
+    }
+
+    if (geometry_changed)
+        replan_composition();
+}
+
+void mga::LayerList::set_occurred()
+{
+    hwc_representation->flags = 0;
+}
+
+void mga::LayerList::prepare_occurred()
+{
+    prepared_layers.clear();
+    overlays_exhausted = false;
+    for (auto i = 0u; i < hwc_representation->numHwLayers; i++)
+    {
+        auto const& layer = hwc_representation->hwLayers[i];
+        prepared_layers.push_back({layer.handle, layer.compositionType, layer.hints, layer.planeAlpha});
+        if ((i < renderable_list.size()) &&
+            (layer.compositionType == HWC_FRAMEBUFFER) && !(layer.flags & HWC_SKIP_LAYER))
+            overlays_exhausted = true;
+    }
+    cursor_to_gl = listed_cursor &&
+        (hwc_representation->hwLayers[cursor_index()].compositionType == HWC_FRAMEBUFFER);
+}
+
+size_t mga::LayerList::renderable_layers() const
+{
+    return renderable_list.size();
+}
+
+std::vector<geom::Rectangle> mga::LayerList::overlays_without_clear_hint() const
+{
+    auto const opaque_plane = std::numeric_limits<decltype(hwc_layer_1_t::planeAlpha)>::max();
+    std::vector<geom::Rectangle> overlays;
+    for (auto i = 0u; i < renderable_list.size(); i++)
+    {
+        auto const& layer = hwc_representation->hwLayers[i];
+        if ((layer.compositionType != HWC_OVERLAY) || (layer.hints & HWC_HINT_CLEAR_FB) ||
+            (layer.blending != HWC_BLENDING_NONE) || (layer.planeAlpha != opaque_plane))
+            continue;
+
+        auto const& frame = layer.displayFrame;
+        overlays.push_back({{frame.left, frame.top}, {frame.right - frame.left, frame.bottom - frame.top}});
+    }
+    return overlays;
+}
+
+bool mga::LayerList::triple_buffer_hinted() const
+{
+    for (auto i = 0u; i < hwc_representation->numHwLayers; i++)
+    {
+        if (hwc_representation->hwLayers[i].hints & HWC_HINT_TRIPLE_BUFFER)
+            return true;
+    }
+    return false;
+}
+
+void mga::LayerList::force_gl_render(std::vector<bool> const& forced)
+{
+    bool flags_changed = false;
+    auto it = layers.begin();
+    for (auto i = 0u; (i < forced.size()) && (i < renderable_list.size()); i++, it++)
+    {
+        auto const flags = hwc_representation->hwLayers[i].flags;
+        it->layer.force_gl_render(forced[i]);
+        flags_changed |= (flags != hwc_representation->hwLayers[i].flags);
+    }
+
+    if (flags_changed || (hwc_representation->flags & HWC_GEOMETRY_CHANGED))
+        replan_composition();
+}
+
+/* A list flagged HWC_GEOMETRY_CHANGED has all of its layers composed anew by prepare(),
+ * which starts from every layer being left to gl. */
+void mga::LayerList::replan_composition()
+{
+    hwc_representation->flags |= HWC_GEOMETRY_CHANGED;
+    for (auto i = 0u; i < hwc_representation->numHwLayers; i++)
+    {
+        auto& layer = hwc_representation->hwLayers[i];
+        if (layer.compositionType != HWC_FRAMEBUFFER_TARGET)
+            layer.compositionType = HWC_FRAMEBUFFER;
+    }
+}
+
+/* the longest run of layers at the bottom of the list that have not changed for a few updates.
+ * Only the bottom run is squashed, so the fb target keeps its place under the overlays. */
+size_t mga::LayerList::squashable_layers(RenderableList const& renderlist)
+{
+    unsigned int const static_updates_before_squash{3};
+
+    auto contents = composited(renderlist);
+    std::vector<unsigned int> updates(contents.size(), 0);
+    for (auto i = 0u; i < contents.size(); i++)
+    {
+        if ((i < last_contents.size()) && unchanged(contents[i], last_contents[i]))
+            updates[i] = unchanged_updates[i] + 1;
+    }
+    last_contents = std::move(contents);
+    unchanged_updates = std::move(updates);
+
+    //keep squashing while some layers are squashed, even if the hwc could now overlay the rest
+    if (!overlays_exhausted && (squashed_layers == 0))
+        return 0;
+
+    size_t squashable = 0;
+    while ((squashable < unchanged_updates.size()) &&
+           (unchanged_updates[squashable] >= static_updates_before_squash))
+        squashable++;
+    return squashable;
+}
+
+bool mga::LayerList::composition_reusable() const
+{
+    if ((hwc_representation->flags & HWC_GEOMETRY_CHANGED) ||
+        (prepared_layers.size() != hwc_representation->numHwLayers))
+        return false;
+
+    //the hwc does not look at the contents of the fb target or of skipped layers.
+    //a layer that fades keeps its buffer, but the hwc has to set it again.
+    for (auto i = 0u; i < prepared_layers.size(); i++)
+    {
+        auto const& layer = hwc_representation->hwLayers[i];
+        if ((prepared_layers[i].composition_type != HWC_FRAMEBUFFER_TARGET) &&
+            !(layer.flags & HWC_SKIP_LAYER) &&
+            ((prepared_layers[i].handle != layer.handle) ||
+             (prepared_layers[i].plane_alpha != layer.planeAlpha)))
+            return false;
+    }
+    return true;
+}
+
+void mga::LayerList::reuse_composition()
+{
+    for (auto i = 0u; i < prepared_layers.size(); i++)
+    {
+        hwc_representation->hwLayers[i].compositionType = prepared_layers[i].composition_type;
+        hwc_representation->hwLayers[i].hints = prepared_layers[i].hints;
+    }
+}
+
+std::vector<mga::LayerList::CompositedRenderable> mga::LayerList::composited(
+    mg::RenderableList const& renderables) const
+{
+    std::vector<CompositedRenderable> contents;
+    for (auto const& renderable : renderables)
+    {
+        contents.push_back({
+            renderable->id(), renderable->buffer()->id(), renderable->screen_position(), renderable->alpha()});
+    }
+    return contents;
+}
+
+void mga::LayerList::fb_target_rendered(mg::Buffer const& fb_target)
+{
+    fb_target_contents = composited(rejected_renderables());
+    fb_target_id = fb_target.id();
+    fb_target_uncleared = overlays_without_clear_hint();
+    fb_target_valid = true;
+}
+
+bool mga::LayerList::fb_target_matches(mg::Buffer const& fb_target)
+{
+    if (!fb_target_valid || (fb_target.id() != fb_target_id))
+        return false;
+
+    //the parts that were left uncleared must still be under overlays that do not need clearing
+    auto const uncleared = overlays_without_clear_hint();
+    for (auto const& rect : fb_target_uncleared)
+    {
+        if (std::none_of(uncleared.begin(), uncleared.end(),
+                [&](geom::Rectangle const& r) { return r.intersection_with(rect) == rect; }))
+            return false;
     }
+
+    auto const contents = composited(rejected_renderables());
+    return std::equal(contents.begin(), contents.end(), fb_target_contents.begin(), fb_target_contents.end(),
+        &LayerList::unchanged);
+}
+
+bool mga::LayerList::unchanged(CompositedRenderable const& a, CompositedRenderable const& b)
+{
+    return (a.id == b.id) && (a.buffer_id == b.buffer_id) &&
+           (a.position == b.position) && (a.alpha == b.alpha);
 }
 
 void mga::LayerList::swap_occurred()
@@ -23,6 +23,7 @@
 #include "mir/geometry/rectangle.h"
 #include "mir/geometry/displacement.h"
 #include "hwc_layers.h"
+#include "mir/graphics/buffer_id.h"
 #include <hardware/hwcomposer.h>
 #include <memory>
 #include <vector>
@@ -47,6 +48,29 @@ struct HwcLayerEntry
     bool needs_commit;
 };
 
+//drops the renderables that are completely hidden behind opaque renderables above them
+RenderableList visible_renderables(RenderableList const& renderlist);
+
+//A prepared list that has been handed over to be set. It owns everything the hwc reads from
+//it and the buffers it shows, so the layer list can be set up again in the meantime.
+class LayerListSnapshot
+{
+public:
+    hwc_display_contents_1_t* native_list();
+    //the hwc has set the list; the buffers it showed get their release fences, and are kept
+    //while the list can be set again
+    void set_occurred();
+    NativeFence retirement_fence();
+    //the list as it was last set, without the fences of that set
+    hwc_display_contents_1_t* list_to_set_again();
+
+private:
+    friend class LayerList;
+    std::shared_ptr<hwc_display_contents_1_t> list;
+    std::list<std::vector<hwc_rect_t>> regions;
+    std::vector<std::shared_ptr<Buffer>> buffers;
+};
+
 class LayerList
 {
 public:
@@ -55,6 +79,12 @@ public:
         RenderableList const& renderlist,
         geometry::Displacement list_offset);
     void update_list(RenderableList const& renderlist, geometry::Displacement list_offset);
+    //display rotation, applied to the renderables on the next update_list()
+    void set_transformation(glm::mat2 const& transformation, geometry::Size const& view_size);
+    //the cursor gets a cursor layer above the others on the next update_list(). null hides it.
+    void set_cursor(std::shared_ptr<Renderable> const& cursor);
+    //true if the hwc left the cursor layer to gl in the last prepare()
+    bool cursor_rejected() const;
 
     std::list<HwcLayerEntry>::iterator begin();
     std::list<HwcLayerEntry>::iterator end();
@@ -63,20 +93,84 @@ public:
     void setup_fb(std::shared_ptr<Buffer> const& fb_target);
     bool needs_swapbuffers();
     void swap_occurred();
+    //the hwc has consumed the list; geometry is unchanged until the next update
+    void set_occurred();
+    //the rejected renderables were composited into fb_target with gl
+    void fb_target_rendered(Buffer const& fb_target);
+    //true if fb_target already holds the current rejected renderables
+    bool fb_target_matches(Buffer const& fb_target);
+    //the hwc has assigned composition types to the list.
+    //if it could not overlay all the layers, the static layers at the bottom are squashed into the
+    //fb target on later updates, so they are composited once and leave the overlays to the others.
+    void prepare_occurred();
+    //true if the hwc would assign the same composition types as in the last prepare()
+    bool composition_reusable() const;
+    void reuse_composition();
+    //the layers showing renderables, ahead of the fb target and skip layers
+    size_t renderable_layers() const;
+    //resets the composition for another prepare(), keeping the given renderable layers out of the overlays
+    void force_gl_render(std::vector<bool> const& forced);
+    //the parts of the fb target under opaque overlays that the hwc did not ask to have cleared
+    std::vector<geometry::Rectangle> overlays_without_clear_hint() const;
+    //true if the hwc asked for a third framebuffer after the last prepare()
+    bool triple_buffer_hinted() const;
 
     hwc_display_contents_1_t* native_list();
     NativeFence retirement_fence();
+    //hands the prepared list over to be set, in place of set_occurred() and retirement_fence().
+    //the layer list carries on with a copy of it.
+    std::unique_ptr<LayerListSnapshot> hand_over();
+    //a copy of the list the hwc has just set, to set again while the layer list is set up anew
+    std::unique_ptr<LayerListSnapshot> snapshot();
 private:
     LayerList& operator=(LayerList const&) = delete;
     LayerList(LayerList const&) = delete;
 
     RenderableList renderable_list;
+    std::shared_ptr<Renderable> cursor;
+    std::shared_ptr<Renderable> listed_cursor;
+    bool cursor_to_gl{false};
+
+    struct CompositedRenderable
+    {
+        Renderable::ID id;
+        BufferID buffer_id;
+        geometry::Rectangle position;
+        float alpha;
+    };
+    std::vector<CompositedRenderable> composited(RenderableList const& renderables) const;
+    static bool unchanged(CompositedRenderable const& a, CompositedRenderable const& b);
+    size_t squashable_layers(RenderableList const& renderlist);
+
+    struct PreparedLayer
+    {
+        buffer_handle_t handle;
+        int32_t composition_type;
+        uint32_t hints;
+        uint8_t plane_alpha;
+    };
+    std::vector<PreparedLayer> prepared_layers;
 
     void update_list_mode(RenderableList const& renderlist);
+    void replan_composition();
+    size_t cursor_index() const;
+    geometry::Rectangle transformed(geometry::Rectangle const& position) const;
 
     std::shared_ptr<LayerAdapter> const layer_adapter;
     std::list<HwcLayerEntry> layers;
     std::shared_ptr<hwc_display_contents_1_t> hwc_representation;
+    glm::mat2 transformation{1};
+    uint32_t hwc_transform{0};
+    geometry::Size view_size;
+    geometry::Displacement list_offset;
+    std::vector<CompositedRenderable> fb_target_contents;
+    BufferID fb_target_id;
+    std::vector<geometry::Rectangle> fb_target_uncleared;
+    bool fb_target_valid{false};
+    std::vector<CompositedRenderable> last_contents;
+    std::vector<unsigned int> unchanged_updates;
+    size_t squashed_layers{0};
+    bool overlays_exhausted{false};
     enum Mode
     {
         no_extra_layers,
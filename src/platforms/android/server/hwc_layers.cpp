@@ -23,6 +23,8 @@
 #include "hwc_layerlist.h"
 
 #include <limits>
+#include <algorithm>
+#include <cmath>
 #include <boost/throw_exception.hpp>
 #include <stdexcept>
 #include <cstring>
@@ -36,52 +38,217 @@ namespace
 decltype(hwc_layer_1_t::planeAlpha) static const plane_alpha_max{
     std::numeric_limits<decltype(hwc_layer_1_t::planeAlpha)>::max()
 };
-}
 
-void mga::FloatSourceCrop::fill_source_crop(
-    hwc_layer_1_t& hwc_layer, geometry::Rectangle const& crop_rect) const
+bool plane_alpha_is_translucent(float alpha)
 {
-    hwc_layer.sourceCropf = 
+    float static const tolerance
     {
-        static_cast<float>(crop_rect.top_left.x.as_int()),
-        static_cast<float>(crop_rect.top_left.y.as_int()),
-        static_cast<float>(crop_rect.size.width.as_int()),
-        static_cast<float>(crop_rect.size.height.as_int())
+        1.0f/(2.0 * static_cast<float>(plane_alpha_max))
     };
+    return (alpha < 1.0f - tolerance);
 }
 
-bool mga::FloatSourceCrop::needs_fb_target() const
+decltype(hwc_layer_1_t::planeAlpha) plane_alpha_for(float alpha)
+{
+    auto const clamped = std::min(std::max(alpha, 0.0f), 1.0f);
+    return static_cast<decltype(hwc_layer_1_t::planeAlpha)>(std::lround(clamped * plane_alpha_max));
+}
+
+/* Display transformations rotate counter-clockwise in GL coordinates (y up).
+ * The hwc flags are applied in buffer coordinates (y down), flips before
+ * the clockwise 90 degree rotation. */
+glm::mat2 hwc_transform_matrix(uint32_t hwc_transform)
+{
+    glm::mat2 static const flip_h(-1, 0, 0, 1);
+    glm::mat2 static const flip_v(1, 0, 0, -1);
+    glm::mat2 static const rot_90(0, 1, -1, 0);
+    glm::mat2 static const flip_y(1, 0, 0, -1);
+
+    glm::mat2 m(1);
+    if (hwc_transform & HWC_TRANSFORM_FLIP_H)
+        m = flip_h * m;
+    if (hwc_transform & HWC_TRANSFORM_FLIP_V)
+        m = flip_v * m;
+    if (hwc_transform & HWC_TRANSFORM_ROT_90)
+        m = rot_90 * m;
+    return flip_y * m * flip_y;
+}
+
+bool matches(glm::mat2 const& a, glm::mat2 const& b)
 {
+    float const tolerance{0.001f};
+    for (auto col = 0; col < 2; col++)
+        for (auto row = 0; row < 2; row++)
+            if (std::abs(a[col][row] - b[col][row]) > tolerance)
+                return false;
     return true;
 }
 
-void mga::IntegerSourceCrop::fill_source_crop(
-    hwc_layer_1_t& hwc_layer, geometry::Rectangle const& crop_rect) const
+//the fields that the hwc uses to plan the composition
+bool geometry_differs(hwc_layer_1_t const& a, hwc_layer_1_t const& b)
+{
+    return (a.flags != b.flags) ||
+           (a.blending != b.blending) ||
+           (a.transform != b.transform) ||
+           memcmp(&a.displayFrame, &b.displayFrame, sizeof(a.displayFrame)) ||
+           memcmp(&a.sourceCropf, &b.sourceCropf, sizeof(a.sourceCropf));
+}
+
+bool same_region(std::vector<hwc_rect_t> const& a, std::vector<hwc_rect_t> const& b)
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+        [](hwc_rect_t const& r1, hwc_rect_t const& r2) { return !memcmp(&r1, &r2, sizeof(r1)); });
+}
+
+hwc_rect_t as_integer_crop(hwc_frect_t const& crop)
+{
+    return {
+        static_cast<int>(std::lround(crop.left)),
+        static_cast<int>(std::lround(crop.top)),
+        static_cast<int>(std::lround(crop.right)),
+        static_cast<int>(std::lround(crop.bottom))
+    };
+}
+
+/* The part of the buffer that shows in frame, if all of it would show in position.
+ * The hwc flips the buffer and then rotates it clockwise, so the cut edges are mapped back in that order. */
+hwc_frect_t source_crop(
+    geom::Rectangle const& position, geom::Rectangle const& frame, geom::Size const& buffer_size, uint32_t transform)
 {
-    hwc_layer.sourceCropi = 
+    float const buffer_width = buffer_size.width.as_int();
+    float const buffer_height = buffer_size.height.as_int();
+    float const width = position.size.width.as_int();
+    float const height = position.size.height.as_int();
+    if ((width <= 0.0f) || (height <= 0.0f))
+        return {0.0f, 0.0f, buffer_width, buffer_height};
+
+    float left = (frame.top_left.x.as_int() - position.top_left.x.as_int()) / width;
+    float top = (frame.top_left.y.as_int() - position.top_left.y.as_int()) / height;
+    float right = (position.bottom_right().x.as_int() - frame.bottom_right().x.as_int()) / width;
+    float bottom = (position.bottom_right().y.as_int() - frame.bottom_right().y.as_int()) / height;
+
+    if (transform & HWC_TRANSFORM_ROT_90)
     {
-        crop_rect.top_left.x.as_int(),
-        crop_rect.top_left.y.as_int(),
-        crop_rect.size.width.as_int(),
-        crop_rect.size.height.as_int()
+        auto const screen_left = left;
+        left = top;
+        top = right;
+        right = bottom;
+        bottom = screen_left;
+    }
+    if (transform & HWC_TRANSFORM_FLIP_H)
+        std::swap(left, right);
+    if (transform & HWC_TRANSFORM_FLIP_V)
+        std::swap(top, bottom);
+
+    return {
+        left * buffer_width,
+        top * buffer_height,
+        buffer_width - right * buffer_width,
+        buffer_height - bottom * buffer_height
     };
 }
 
+uint32_t const hwc_transforms[] {
+    0,
+    HWC_TRANSFORM_FLIP_H,
+    HWC_TRANSFORM_FLIP_V,
+    HWC_TRANSFORM_ROT_90,
+    HWC_TRANSFORM_ROT_180,
+    HWC_TRANSFORM_ROT_270,
+    HWC_TRANSFORM_ROT_90 | HWC_TRANSFORM_FLIP_H,
+    HWC_TRANSFORM_ROT_90 | HWC_TRANSFORM_FLIP_V
+};
+}
+
+bool mga::is_hwc_transform(glm::mat2 const& transformation)
+{
+    return std::any_of(std::begin(hwc_transforms), std::end(hwc_transforms),
+        [&](uint32_t t) { return matches(hwc_transform_matrix(t), transformation); });
+}
+
+uint32_t mga::as_hwc_transform(glm::mat2 const& transformation)
+{
+    auto it = std::find_if(std::begin(hwc_transforms), std::end(hwc_transforms),
+        [&](uint32_t t) { return matches(hwc_transform_matrix(t), transformation); });
+    if (it == std::end(hwc_transforms))
+        BOOST_THROW_EXCEPTION(std::logic_error("transformation cannot be represented by the hwc"));
+    return *it;
+}
+
+/* The transformation rotates in GL coordinates, so y is flipped around it. */
+geom::Rectangle mga::transformed(
+    geom::Rectangle const& position, glm::mat2 const& transformation, geom::Size const& view_size)
+{
+    glm::mat2 static const flip_y(1, 0, 0, -1);
+    auto const screen_transformation = flip_y * transformation * flip_y;
+    glm::vec2 const view_center(view_size.width.as_int() / 2.0f, view_size.height.as_int() / 2.0f);
+    glm::vec2 const fb_center = glm::abs(screen_transformation * view_center);
+
+    glm::vec2 const top_left(position.top_left.x.as_int(), position.top_left.y.as_int());
+    glm::vec2 const bottom_right(position.bottom_right().x.as_int(), position.bottom_right().y.as_int());
+    auto const a = screen_transformation * (top_left - view_center) + fb_center;
+    auto const b = screen_transformation * (bottom_right - view_center) + fb_center;
+
+    int const left = std::lround(std::min(a.x, b.x));
+    int const top = std::lround(std::min(a.y, b.y));
+    int const right = std::lround(std::max(a.x, b.x));
+    int const bottom = std::lround(std::max(a.y, b.y));
+    return {{left, top}, {right - left, bottom - top}};
+}
+
+void mga::FloatSourceCrop::fill_source_crop(hwc_layer_1_t& hwc_layer, hwc_frect_t const& crop) const
+{
+    hwc_layer.sourceCropf = crop;
+}
+
+bool mga::FloatSourceCrop::needs_fb_target() const
+{
+    return true;
+}
+
+bool mga::FloatSourceCrop::supports_plane_alpha() const
+{
+    return true;
+}
+
+bool mga::FloatSourceCrop::supports_surface_damage() const
+{
+    return false;
+}
+
+bool mga::Hwc15Adapter::supports_surface_damage() const
+{
+    return true;
+}
+
+void mga::IntegerSourceCrop::fill_source_crop(hwc_layer_1_t& hwc_layer, hwc_frect_t const& crop) const
+{
+    hwc_layer.sourceCropi = as_integer_crop(crop);
+}
+
 bool mga::IntegerSourceCrop::needs_fb_target() const
 {
     return true;
 }
 
-void mga::Hwc10Adapter::fill_source_crop(
-    hwc_layer_1_t& hwc_layer, geometry::Rectangle const& crop_rect) const
+bool mga::IntegerSourceCrop::supports_plane_alpha() const
 {
-    hwc_layer.sourceCropi = 
-    {
-        crop_rect.top_left.x.as_int(),
-        crop_rect.top_left.y.as_int(),
-        crop_rect.size.width.as_int(),
-        crop_rect.size.height.as_int()
-    };
+    return false;
+}
+
+bool mga::IntegerSourceCrop::supports_surface_damage() const
+{
+    return false;
+}
+
+bool mga::Hwc12Adapter::supports_plane_alpha() const
+{
+    return true;
+}
+
+void mga::Hwc10Adapter::fill_source_crop(hwc_layer_1_t& hwc_layer, hwc_frect_t const& crop) const
+{
+    hwc_layer.sourceCropi = as_integer_crop(crop);
 }
 
 bool mga::Hwc10Adapter::needs_fb_target() const
@@ -89,13 +256,29 @@ bool mga::Hwc10Adapter::needs_fb_target() const
     return false;
 }
 
+bool mga::Hwc10Adapter::supports_plane_alpha() const
+{
+    return false;
+}
+
+bool mga::Hwc10Adapter::supports_surface_damage() const
+{
+    return false;
+}
+
 mga::HWCLayer& mga::HWCLayer::operator=(HWCLayer && other)
 {
     layer_adapter = std::move(other.layer_adapter);
     hwc_layer = other.hwc_layer;
     hwc_list = std::move(other.hwc_list);
-    visible_rect = std::move(other.visible_rect);
+    visible_rects = std::move(other.visible_rects);
+    previous_visible_rects = std::move(other.previous_visible_rects);
+    damage_rect = std::move(other.damage_rect);
     associated_buffer = std::move(other.associated_buffer);
+    changed_geometry = other.changed_geometry;
+    gl_forced = other.gl_forced;
+    setup_flags = other.setup_flags;
+    point_regions_at_storage();
     return *this;
 }
 
@@ -103,9 +286,23 @@ mga::HWCLayer::HWCLayer(HWCLayer && other)
     : layer_adapter{std::move(other.layer_adapter)},
       hwc_layer(std::move(other.hwc_layer)),
       hwc_list(std::move(other.hwc_list)),
-      visible_rect(std::move(other.visible_rect)),
-      associated_buffer(other.associated_buffer)
+      visible_rects(std::move(other.visible_rects)),
+      previous_visible_rects(std::move(other.previous_visible_rects)),
+      damage_rect(std::move(other.damage_rect)),
+      associated_buffer(other.associated_buffer),
+      changed_geometry(other.changed_geometry),
+      gl_forced(other.gl_forced),
+      setup_flags(other.setup_flags)
+{
+    point_regions_at_storage();
+}
+
+//the regions in the hwc_layer_1_t refer to rects owned by this object
+void mga::HWCLayer::point_regions_at_storage()
 {
+    hwc_layer->visibleRegionScreen = {visible_rects.size(), visible_rects.data()};
+    if (hwc_layer->surfaceDamage.numRects)
+        hwc_layer->surfaceDamage.rects = &damage_rect;
 }
 
 mga::HWCLayer::HWCLayer(
@@ -117,7 +314,7 @@ mga::HWCLayer::HWCLayer(
     hwc_list(list)
 {
     memset(hwc_layer, 0, sizeof(hwc_layer_1_t));
-    memset(&visible_rect, 0, sizeof(hwc_rect_t));
+    memset(&damage_rect, 0, sizeof(hwc_rect_t));
 
     hwc_layer->hints = 0;
     hwc_layer->transform = 0;
@@ -126,8 +323,8 @@ mga::HWCLayer::HWCLayer(
     hwc_layer->blending = HWC_BLENDING_NONE;
     hwc_layer->planeAlpha = plane_alpha_max;
 
-    hwc_layer->visibleRegionScreen.numRects=1;
-    hwc_layer->visibleRegionScreen.rects= &visible_rect;
+    visible_rects.assign(1, hwc_rect_t{0, 0, 0, 0});
+    point_regions_at_storage();
 }
 
 mga::HWCLayer::HWCLayer(
@@ -137,10 +334,12 @@ mga::HWCLayer::HWCLayer(
     LayerType type,
     geometry::Rectangle const& position,
     bool alpha_enabled,
+    float plane_alpha,
+    uint32_t transform,
     std::shared_ptr<Buffer> const& buffer) :
     HWCLayer(layer_adapter, list, layer_index)
 {
-    setup_layer(type, position, alpha_enabled, buffer);
+    setup_layer(type, position, alpha_enabled, plane_alpha, transform, buffer);
 }
 
 bool mga::HWCLayer::needs_gl_render() const
@@ -150,7 +349,41 @@ bool mga::HWCLayer::needs_gl_render() const
 
 bool mga::HWCLayer::is_overlay() const
 {
-    return (hwc_layer->compositionType == HWC_OVERLAY);
+    return (hwc_layer->compositionType == HWC_OVERLAY) ||
+           (hwc_layer->compositionType == HWC_CURSOR_OVERLAY);
+}
+
+void mga::HWCLayer::force_gl_render(bool force)
+{
+    gl_forced = force;
+    if (hwc_layer->compositionType == HWC_FRAMEBUFFER_TARGET)
+        return;
+    hwc_layer->flags = force ? (setup_flags | HWC_SKIP_LAYER) : setup_flags;
+}
+
+uint32_t mga::HWCLayer::unforced_flags() const
+{
+    return setup_flags;
+}
+
+bool mga::HWCLayer::set_visible_region(std::vector<geometry::Rectangle> const& region)
+{
+    visible_rects.clear();
+    for (auto const& rect : region)
+    {
+        visible_rects.push_back({
+            rect.top_left.x.as_int(),
+            rect.top_left.y.as_int(),
+            rect.bottom_right().x.as_int(),
+            rect.bottom_right().y.as_int()});
+    }
+    point_regions_at_storage();
+    return !same_region(visible_rects, previous_visible_rects);
+}
+
+bool mga::HWCLayer::geometry_changed() const
+{
+    return changed_geometry || !same_region(visible_rects, previous_visible_rects);
 }
 
 void mga::HWCLayer::release_buffer()
@@ -165,6 +398,16 @@ void mga::HWCLayer::release_buffer()
     associated_buffer.reset();
 }
 
+void mga::HWCLayer::rebind(std::shared_ptr<hwc_display_contents_1_t> const& list, size_t layer_index)
+{
+    hwc_list = list;
+    hwc_layer = &list->hwLayers[layer_index];
+    hwc_layer->acquireFenceFd = -1;
+    hwc_layer->releaseFenceFd = -1;
+    associated_buffer.reset();
+    point_regions_at_storage();
+}
+
 std::shared_ptr<mg::Buffer> mga::HWCLayer::buffer()
 {
     return associated_buffer;
@@ -174,11 +417,27 @@ bool mga::HWCLayer::setup_layer(
     LayerType type,
     geometry::Rectangle const& position,
     bool alpha_enabled,
+    float plane_alpha,
+    uint32_t transform,
+    std::shared_ptr<Buffer> const& buffer)
+{
+    return setup_layer(type, position, position, alpha_enabled, plane_alpha, transform, buffer);
+}
+
+bool mga::HWCLayer::setup_layer(
+    LayerType type,
+    geometry::Rectangle const& position,
+    geometry::Rectangle const& clip_area,
+    bool alpha_enabled,
+    float plane_alpha,
+    uint32_t transform,
     std::shared_ptr<Buffer> const& buffer)
 {
     if (type != mga::LayerType::skip)
         associated_buffer = buffer;
     bool needs_commit = needs_gl_render();
+    hwc_layer_1_t const previous_layer = *hwc_layer;
+    bool const translucent = plane_alpha_is_translucent(plane_alpha);
 
     hwc_layer->flags = 0;
     switch(type)
@@ -190,44 +449,97 @@ bool mga::HWCLayer::setup_layer(
 
         case mga::LayerType::gl_rendered:
             hwc_layer->compositionType = HWC_FRAMEBUFFER;
+            //before HWC 1.2, the hwc cannot fade a layer, so it must be drawn with GL
+            if (translucent && !layer_adapter->supports_plane_alpha())
+                hwc_layer->flags = HWC_SKIP_LAYER;
+        break;
+
+        case mga::LayerType::squashed:
+            hwc_layer->compositionType = HWC_FRAMEBUFFER;
+            hwc_layer->flags = HWC_SKIP_LAYER;
         break;
 
         case mga::LayerType::framebuffer_target:
             hwc_layer->compositionType = HWC_FRAMEBUFFER_TARGET;
         break;
 
+        case mga::LayerType::cursor:
+            hwc_layer->compositionType = HWC_FRAMEBUFFER;
+            hwc_layer->flags = HWC_IS_CURSOR_LAYER;
+        break;
+
         case mga::LayerType::overlay: //driver is the only one who can set to overlay
         default:
             BOOST_THROW_EXCEPTION(std::logic_error("invalid layer type"));
     }
 
-    if (alpha_enabled)
+    setup_flags = hwc_layer->flags;
+    if (gl_forced && (hwc_layer->compositionType == HWC_FRAMEBUFFER))
+        hwc_layer->flags |= HWC_SKIP_LAYER;
+
+    if (alpha_enabled || translucent)
         hwc_layer->blending = HWC_BLENDING_PREMULT;
     else
         hwc_layer->blending = HWC_BLENDING_NONE;
 
-    hwc_layer->planeAlpha = plane_alpha_max;
+    if (layer_adapter->supports_plane_alpha())
+        hwc_layer->planeAlpha = plane_alpha_for(plane_alpha);
+    else
+        hwc_layer->planeAlpha = plane_alpha_max;
+
+    hwc_layer->transform = transform;
+
+    //a layer entirely outside the clip area is left whole, it is up to the hwc what to do with it
+    auto frame = position.intersection_with(clip_area);
+    if ((frame.size.width.as_int() <= 0) || (frame.size.height.as_int() <= 0))
+        frame = position;
 
     /* note, if the sourceCrop and DisplayFrame sizes differ, the output will be linearly scaled */
     hwc_layer->displayFrame = 
     {
-        position.top_left.x.as_int(),
-        position.top_left.y.as_int(),
-        position.bottom_right().x.as_int(),
-        position.bottom_right().y.as_int()
+        frame.top_left.x.as_int(),
+        frame.top_left.y.as_int(),
+        frame.bottom_right().x.as_int(),
+        frame.bottom_right().y.as_int()
     };
 
-    geom::Rectangle crop_rect{{0,0}, buffer->size()};
-    layer_adapter->fill_source_crop(*hwc_layer, crop_rect);
+    layer_adapter->fill_source_crop(*hwc_layer, source_crop(position, frame, buffer->size(), transform));
 
-    hwc_layer->surfaceDamage = { 0, nullptr };
+    previous_visible_rects = std::move(visible_rects);
+    visible_rects.assign(1, hwc_layer->displayFrame);
+    point_regions_at_storage();
 
-    visible_rect = hwc_layer->displayFrame;
+    changed_geometry = geometry_differs(previous_layer, *hwc_layer);
+    needs_commit |= geometry_changed();
+    needs_commit |= (previous_layer.planeAlpha != hwc_layer->planeAlpha);
+
+    //the hwc only replans a list flagged HWC_GEOMETRY_CHANGED, so until then the layer keeps
+    //the composition type it was last prepared with. The list resets it when it flags a change.
+    if (!changed_geometry && (hwc_layer->compositionType == HWC_FRAMEBUFFER) &&
+        (previous_layer.compositionType != HWC_FRAMEBUFFER_TARGET))
+        hwc_layer->compositionType = previous_layer.compositionType;
 
     auto native_buffer = mga::to_native_buffer_checked(buffer->native_buffer_handle());
-    needs_commit |= (hwc_layer->handle != native_buffer->handle());
+    bool const buffer_changed = (hwc_layer->handle != native_buffer->handle());
+    needs_commit |= buffer_changed;
     hwc_layer->handle = native_buffer->handle();
 
+    //HWC 1.5 can skip refreshing a layer whose contents are the same as in the last frame.
+    //A single empty rect means no damage; no rects means the whole layer is damaged.
+    //Renderables do not say which part of their buffer the client redrew, so the damage is
+    //all or nothing: a layer is undamaged only while its buffer and geometry stay the same.
+    //The cursor image is rewritten in the same buffer, so the cursor layer is always damaged.
+    if (layer_adapter->supports_surface_damage() && !buffer_changed && !changed_geometry &&
+        (type != mga::LayerType::cursor))
+    {
+        damage_rect = {0, 0, 0, 0};
+        hwc_layer->surfaceDamage = { 1, &damage_rect };
+    }
+    else
+    {
+        hwc_layer->surfaceDamage = { 0, nullptr };
+    }
+
     return needs_commit;
 }
 
@@ -23,6 +23,7 @@
 #include "fence.h"
 #include "mir/geometry/rectangle.h"
 #include <hardware/hwcomposer.h>
+#include <glm/glm.hpp>
 #include <memory>
 #include <vector>
 #include <initializer_list>
@@ -43,14 +44,26 @@ enum LayerType
     gl_rendered,
     overlay,
     framebuffer_target,
-    skip
+    skip,
+    squashed, //a static layer the hwc must leave in the framebuffer, with the other static layers
+    cursor //a layer the hwc can move with setCursorPositionAsync() (HWC 1.4 and later)
 };
 
+//The hwc can only scan out right-angle rotations and flips of a buffer.
+bool is_hwc_transform(glm::mat2 const& display_transformation);
+//converts a display transformation to the hwc_layer_1_t::transform flags
+uint32_t as_hwc_transform(glm::mat2 const& display_transformation);
+//maps a rectangle in a view of view_size, shown with display_transformation, onto the unrotated framebuffer
+geometry::Rectangle transformed(
+    geometry::Rectangle const& position, glm::mat2 const& display_transformation, geometry::Size const& view_size);
+
 class LayerAdapter
 {
 public:
-    virtual void fill_source_crop(hwc_layer_1_t&, geometry::Rectangle const& crop_size) const = 0;
+    virtual void fill_source_crop(hwc_layer_1_t&, hwc_frect_t const& crop) const = 0;
     virtual bool needs_fb_target() const = 0;
+    virtual bool supports_plane_alpha() const = 0;
+    virtual bool supports_surface_damage() const = 0;
     virtual ~LayerAdapter() = default;
     LayerAdapter() = default;
     LayerAdapter(LayerAdapter const&) = delete; 
@@ -60,22 +73,40 @@ public:
 //HWC 1.0 has int sourceCrop and no fbtarget
 class Hwc10Adapter : public LayerAdapter
 {
-    void fill_source_crop(hwc_layer_1_t&, geometry::Rectangle const& crop_size) const override;
+    void fill_source_crop(hwc_layer_1_t&, hwc_frect_t const& crop) const override;
     bool needs_fb_target() const override;
+    bool supports_plane_alpha() const override;
+    bool supports_surface_damage() const override;
 };
 
-//HWC 1.1 to 1.2 have int sourceCrop and fbtarget
+//HWC 1.1 has int sourceCrop and fbtarget
 class IntegerSourceCrop : public LayerAdapter
 {
-    void fill_source_crop(hwc_layer_1_t&, geometry::Rectangle const& crop_size) const override;
+    void fill_source_crop(hwc_layer_1_t&, hwc_frect_t const& crop) const override;
     bool needs_fb_target() const override;
+    bool supports_plane_alpha() const override;
+    bool supports_surface_damage() const override;
+};
+
+//HWC 1.2 has int sourceCrop, fbtarget and planeAlpha
+class Hwc12Adapter : public IntegerSourceCrop
+{
+    bool supports_plane_alpha() const override;
 };
 
-//HWC 1.3 and later have float sourceCrop and fbtarget
+//HWC 1.3 and 1.4 have float sourceCrop, fbtarget and planeAlpha
 class FloatSourceCrop : public LayerAdapter
 {
-    void fill_source_crop(hwc_layer_1_t&, geometry::Rectangle const& crop_size) const override;
+    void fill_source_crop(hwc_layer_1_t&, hwc_frect_t const& crop) const override;
     bool needs_fb_target() const override;
+    bool supports_plane_alpha() const override;
+    bool supports_surface_damage() const override;
+};
+
+//HWC 1.5 adds surfaceDamage, which is sent as all or nothing for each layer
+class Hwc15Adapter : public FloatSourceCrop
+{
+    bool supports_surface_damage() const override;
 };
 
 class HWCLayer
@@ -93,6 +124,8 @@ public:
         LayerType,
         geometry::Rectangle const& screen_position,
         bool alpha_enabled,
+        float plane_alpha,
+        uint32_t transform,
         std::shared_ptr<Buffer> const& buffer);
 
     HWCLayer& operator=(HWCLayer && layer);
@@ -105,20 +138,51 @@ public:
         LayerType type,
         geometry::Rectangle const& position,
         bool alpha_enabled,
+        float plane_alpha,
+        uint32_t transform,
         std::shared_ptr<Buffer> const& buffer);
+    //as above, but only the part of the layer within clip_area is shown, with the source crop cut to match
+    bool setup_layer(
+        LayerType type,
+        geometry::Rectangle const& position,
+        geometry::Rectangle const& clip_area,
+        bool alpha_enabled,
+        float plane_alpha,
+        uint32_t transform,
+        std::shared_ptr<Buffer> const& buffer);
+
+    //keeps the hwc from overlaying a layer that could be shown as an overlay
+    void force_gl_render(bool force);
+    //the flags the layer was set up with, before it was forced to gl
+    uint32_t unforced_flags() const;
 
     bool is_overlay() const;
     bool needs_gl_render() const;
+    //shows only the given part of the layer (in screen coordinates) instead of all of it.
+    //returns true if the visible region changed since the last frame.
+    bool set_visible_region(std::vector<geometry::Rectangle> const& region);
+    //true if the last setup_layer() moved, resized, or changed how the layer is blended
+    bool geometry_changed() const;
     void set_acquirefence();
     void release_buffer();
+    //moves the layer to a copy of its list. The old list keeps the fences and whatever
+    //consumes it takes over the buffer.
+    void rebind(std::shared_ptr<hwc_display_contents_1_t> const& list, size_t layer_index);
     std::shared_ptr<Buffer> buffer();
 
 private:
+    void point_regions_at_storage();
+
     std::shared_ptr<LayerAdapter> layer_adapter;
     hwc_layer_1_t* hwc_layer;
     std::shared_ptr<hwc_display_contents_1_t> hwc_list;
-    hwc_rect_t visible_rect;
+    std::vector<hwc_rect_t> visible_rects;
+    std::vector<hwc_rect_t> previous_visible_rects;
+    hwc_rect_t damage_rect;
     std::shared_ptr<Buffer> associated_buffer;
+    bool changed_geometry{true};
+    bool gl_forced{false};
+    uint32_t setup_flags{0};
 };
 }
 }
@@ -52,8 +52,8 @@ private:
     std::ios_base::fmtflags const old_flags;
 };
 
-struct DisplayName{ unsigned int const name; };
-std::ostream& operator<<(std::ostream& str, DisplayName d)
+struct HwcDisplay{ unsigned int const name; };
+std::ostream& operator<<(std::ostream& str, HwcDisplay d)
 {
     if (d.name == HWC_DISPLAY_PRIMARY) str <<  "primary ";
     if (d.name == HWC_DISPLAY_EXTERNAL) str << "external";
@@ -118,6 +118,8 @@ std::ostream& operator<<(std::ostream& str, HwcType type)
                 return str << std::string{"GL_RENDER"};
         case HWC_FRAMEBUFFER_TARGET:
             return str << std::string{"FB_TARGET"};
+        case HWC_CURSOR_OVERLAY:
+            return str << std::string{"CURSOR"};
         default:
             return str << std::string{"UNKNOWN"};
     }
@@ -180,6 +182,31 @@ std::ostream& operator<<(std::ostream& str, mga::HwcVersion version)
     return str;
 }
 
+std::ostream& operator<<(std::ostream& str, mga::FrameOutcome outcome)
+{
+    switch (outcome)
+    {
+        case mga::FrameOutcome::on_time: str << "on time"; break;
+        case mga::FrameOutcome::late: str << "late"; break;
+        case mga::FrameOutcome::skipped: str << "skipped"; break;
+        default: break;
+    }
+    return str;
+}
+
+std::ostream& operator<<(std::ostream& str, mga::FrameStage stage)
+{
+    switch (stage)
+    {
+        case mga::FrameStage::prepare: str << "prepare"; break;
+        case mga::FrameStage::gl_fallback: str << "gl fallback"; break;
+        case mga::FrameStage::set: str << "set"; break;
+        case mga::FrameStage::fence_wait: str << "fence wait"; break;
+        default: break;
+    }
+    return str;
+}
+
 std::ostream& operator<<(std::ostream& str, mga::PowerMode power_mode)
 {
     switch (power_mode)
@@ -207,7 +234,7 @@ void mga::HwcFormattedLogger::report_list_submitted_to_prepare(
         {
             std::cout << LayerNumber{j}
                       << separator
-                      << DisplayName{i}
+                      << HwcDisplay{i}
                       << separator
                       << HwcType{displays[i]->hwLayers[j].compositionType, displays[i]->hwLayers[j].flags}
                       << separator
@@ -240,7 +267,7 @@ void mga::HwcFormattedLogger::report_prepare_done(
         for(auto j = 0u; j < displays[i]->numHwLayers; j++)
             std::cout << LayerNumber{j}
                       << separator
-                      << DisplayName{i}
+                      << HwcDisplay{i}
                       << separator
                       << HwcType{displays[i]->hwLayers[j].compositionType, displays[i]->hwLayers[j].flags}
                       << separator
@@ -260,7 +287,7 @@ void mga::HwcFormattedLogger::report_set_list(
         for(auto j = 0u; j < displays[i]->numHwLayers; j++)
             std::cout << LayerNumber{j}
                       << separator
-                      << DisplayName{i}
+                      << HwcDisplay{i}
                       << separator
                       << HwcType{displays[i]->hwLayers[j].compositionType, displays[i]->hwLayers[j].flags}
                       << separator
@@ -282,13 +309,23 @@ void mga::HwcFormattedLogger::report_set_done(
         for(auto j = 0u; j < displays[i]->numHwLayers; j++)
             std::cout << LayerNumber{j}
                       << separator
-                      << DisplayName{i}
+                      << HwcDisplay{i}
                       << separator
                       << displays[i]->hwLayers[j].releaseFenceFd
                       << std::endl;
     }
 }
 
+void mga::HwcFormattedLogger::report_prepare_skipped() const
+{
+    std::cout << "HWC: prepare() skipped, list unchanged" << std::endl;
+}
+
+void mga::HwcFormattedLogger::report_frame_elided() const
+{
+    std::cout << "HWC: frame elided, nothing changed" << std::endl;
+}
+
 void mga::HwcFormattedLogger::report_overlay_optimization(OverlayOptimization overlay_optimization) const
 {
     std::cout << "HWC overlay optimizations are " << overlay_optimization << std::endl;
@@ -329,6 +366,29 @@ void mga::HwcFormattedLogger::report_power_mode(PowerMode mode) const
     std::cout << "HWC: power mode: " << mode << std::endl;
 }
 
+void mga::HwcFormattedLogger::report_missed_deadline(
+    DisplayName name, FrameOutcome outcome, FrameStage cause, std::chrono::nanoseconds lateness) const
+{
+    std::cout << "HWC: " << HwcDisplay{static_cast<unsigned int>(as_hwc_display(name))}
+              << " frame " << outcome << " by "
+              << std::chrono::duration_cast<std::chrono::microseconds>(lateness).count()
+              << "us, held up by " << cause << std::endl;
+}
+
+void mga::HwcFormattedLogger::report_frame_histogram(DisplayName name, FrameHistogram const& histogram) const
+{
+    std::cout << "HWC: " << HwcDisplay{static_cast<unsigned int>(as_hwc_display(name))}
+              << " frames on time: " << histogram.on_time
+              << ", late: " << histogram.late << " (";
+    auto const buckets = histogram.vsyncs_missed.size();
+    for (auto i = 0u; i < buckets; i++)
+    {
+        std::cout << (i ? ", " : "") << "by " << (i + 1) << ((i + 1 == buckets) ? "+" : "")
+                  << ": " << histogram.vsyncs_missed[i];
+    }
+    std::cout << "), skipped: " << histogram.skipped << std::endl;
+}
+
 void mga::NullHwcReport::report_list_submitted_to_prepare(
     std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const&) const {}
 void mga::NullHwcReport::report_prepare_done(
@@ -337,6 +397,8 @@ void mga::NullHwcReport::report_set_list(
     std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const&) const {}
 void mga::NullHwcReport::report_set_done(
     std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const&) const {}
+void mga::NullHwcReport::report_prepare_skipped() const {}
+void mga::NullHwcReport::report_frame_elided() const {}
 void mga::NullHwcReport::report_overlay_optimization(OverlayOptimization) const {}
 void mga::NullHwcReport::report_display_on() const {}
 void mga::NullHwcReport::report_display_off() const {}
@@ -345,3 +407,6 @@ void mga::NullHwcReport::report_vsync_off() const {}
 void mga::NullHwcReport::report_hwc_version(mga::HwcVersion) const {}
 void mga::NullHwcReport::report_legacy_fb_module() const {}
 void mga::NullHwcReport::report_power_mode(PowerMode) const {}
+void mga::NullHwcReport::report_missed_deadline(
+    DisplayName, FrameOutcome, FrameStage, std::chrono::nanoseconds) const {}
+void mga::NullHwcReport::report_frame_histogram(DisplayName, FrameHistogram const&) const {}
@@ -39,6 +39,8 @@ public:
         std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& displays) const override;
     void report_set_done(
         std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& displays) const override;
+    void report_prepare_skipped() const override;
+    void report_frame_elided() const override;
     void report_overlay_optimization(OverlayOptimization optimization_option) const override;
     void report_display_on() const override;
     void report_display_off() const override;
@@ -47,6 +49,9 @@ public:
     void report_hwc_version(HwcVersion) const override;
     void report_legacy_fb_module() const override;
     void report_power_mode(PowerMode mode) const override;
+    void report_missed_deadline(
+        DisplayName, FrameOutcome, FrameStage cause, std::chrono::nanoseconds lateness) const override;
+    void report_frame_histogram(DisplayName, FrameHistogram const&) const override;
 };
 
 class NullHwcReport : public HwcReport
@@ -61,6 +66,8 @@ public:
         std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const&) const override;
     void report_set_done(
         std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const&) const override;
+    void report_prepare_skipped() const override;
+    void report_frame_elided() const override;
     void report_overlay_optimization(OverlayOptimization) const override;
     void report_display_on() const override;
     void report_display_off() const override;
@@ -69,6 +76,9 @@ public:
     void report_hwc_version(HwcVersion) const override;
     void report_legacy_fb_module() const override;
     void report_power_mode(PowerMode mode) const override;
+    void report_missed_deadline(
+        DisplayName, FrameOutcome, FrameStage cause, std::chrono::nanoseconds lateness) const override;
+    void report_frame_histogram(DisplayName, FrameHistogram const&) const override;
 };
 }
 }
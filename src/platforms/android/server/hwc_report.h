@@ -22,7 +22,10 @@
 #include "overlay_optimization.h"
 #include "display_resource_factory.h"
 #include "power_mode.h"
+#include "display_name.h"
+#include "frame_stage.h"
 #include <hardware/hwcomposer.h>
+#include <chrono>
 
 namespace mir
 {
@@ -43,6 +46,8 @@ public:
         std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& displays) const = 0;
     virtual void report_set_done(
         std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& displays) const = 0;
+    virtual void report_prepare_skipped() const = 0;
+    virtual void report_frame_elided() const = 0;
     virtual void report_overlay_optimization(OverlayOptimization optimization_option) const = 0;
     virtual void report_display_on() const = 0;
     virtual void report_display_off() const = 0;
@@ -51,6 +56,11 @@ public:
     virtual void report_hwc_version(HwcVersion) const = 0;
     virtual void report_legacy_fb_module() const = 0;
     virtual void report_power_mode(PowerMode mode) const = 0;
+    //a frame did not make the vsync it was committed for, held up by the given stage
+    virtual void report_missed_deadline(
+        DisplayName, FrameOutcome, FrameStage cause, std::chrono::nanoseconds lateness) const = 0;
+    //every few seconds of frames, how they fared
+    virtual void report_frame_histogram(DisplayName, FrameHistogram const&) const = 0;
 
     void set_version(HwcVersion version) { hwc_version = version; }
 
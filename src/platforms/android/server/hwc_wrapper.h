@@ -21,6 +21,7 @@
 
 #include "mir/graphics/frame.h"
 #include "mir/int_wrapper.h"
+#include "mir/geometry/point.h"
 #include "display_name.h"
 #include "power_mode.h"
 #include <array>
@@ -48,7 +49,8 @@ public:
     virtual void prepare(std::array<hwc_display_contents_1*, HWC_NUM_DISPLAY_TYPES> const&) const = 0;
     virtual void set(std::array<hwc_display_contents_1*, HWC_NUM_DISPLAY_TYPES> const&) const = 0;
     //receive vsync, invalidate, and hotplug events from the driver.
-    //As with the HWC api, these events MUST NOT call-back to the other functions in HwcWrapper. 
+    //As with the HWC api, these events MUST NOT call-back to the other functions in HwcWrapper,
+    //other than to subscribe or unsubscribe.
     virtual void subscribe_to_events(
         void const* subscriber,
         std::function<void(DisplayName, graphics::Frame::Timestamp)> const& vsync_callback,
@@ -66,6 +68,9 @@ public:
     virtual bool has_active_config(DisplayName) const = 0;
     virtual ConfigId active_config_for(DisplayName name) const = 0;
     virtual void set_active_config(DisplayName name, ConfigId id) const = 0;
+    //moves the cursor layer of the display without a prepare() and set() (HWC 1.4 and later).
+    //returns false if the hwc cannot move it, eg, because it is not on a cursor overlay.
+    virtual bool set_cursor_position(DisplayName, geometry::Point position) const = 0;
 
 protected:
     HwcWrapper() = default;
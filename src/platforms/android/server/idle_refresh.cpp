@@ -0,0 +1,164 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "idle_refresh.h"
+
+#include <algorithm>
+
+#define MIR_LOG_COMPONENT "android/server"
+#include "mir/log.h"
+
+namespace mga = mir::graphics::android;
+
+mga::IdleRefresh::IdleRefresh(std::shared_ptr<HwcWrapper> const& hwc_wrapper, std::chrono::milliseconds idle_time) :
+    hwc_wrapper(hwc_wrapper),
+    idle_time(idle_time),
+    thread{[this] { run(); }}
+{
+}
+
+mga::IdleRefresh::~IdleRefresh()
+{
+    {
+        std::lock_guard<decltype(mutex)> lk(mutex);
+        stopping = true;
+    }
+    posted.notify_all();
+    thread.join();
+}
+
+mga::ConfigId mga::IdleRefresh::track(DisplayName name, ConfigId config, ConfigId idle_config)
+{
+    {
+        std::lock_guard<decltype(mutex)> lk(mutex);
+        auto& state = states[name];
+        if (state.idle && (config == state.idle_config))
+            return state.config;
+
+        state.config = config;
+        state.idle_config = idle_config;
+        state.idle = false;
+        state.last_post = std::chrono::steady_clock::now();
+    }
+    posted.notify_all();
+    return config;
+}
+
+void mga::IdleRefresh::change(DisplayName name, ConfigId config, ConfigId idle_config)
+{
+    {
+        std::lock_guard<decltype(mutex)> lk(mutex);
+        hwc_wrapper->set_active_config(name, config);
+
+        auto& state = states[name];
+        state.config = config;
+        state.idle_config = idle_config;
+        state.idle = false;
+        state.last_post = std::chrono::steady_clock::now();
+    }
+    posted.notify_all();
+}
+
+void mga::IdleRefresh::frame_posted(DisplayName name)
+{
+    {
+        std::lock_guard<decltype(mutex)> lk(mutex);
+        auto state = states.find(name);
+        if (state == states.end())
+            return;
+
+        state->second.last_post = std::chrono::steady_clock::now();
+        if (!state->second.idle)
+            return;
+        restore(name, state->second);
+    }
+    posted.notify_all();
+}
+
+void mga::IdleRefresh::display_on(DisplayName name)
+{
+    {
+        std::lock_guard<decltype(mutex)> lk(mutex);
+        auto& state = states[name];
+        state.powered = true;
+        state.last_post = std::chrono::steady_clock::now();
+    }
+    posted.notify_all();
+}
+
+void mga::IdleRefresh::display_off(DisplayName name)
+{
+    std::lock_guard<decltype(mutex)> lk(mutex);
+    auto& state = states[name];
+    if (state.idle)
+        restore(name, state);
+    state.powered = false;
+}
+
+//if the driver refuses, the display stays at the idle rate, which frames can still be posted at
+void mga::IdleRefresh::restore(DisplayName name, State& state)
+{
+    state.idle = false;
+    try
+    {
+        hwc_wrapper->set_active_config(name, state.config);
+    }
+    catch (std::exception const& e)
+    {
+        mir::log_warning("could not restore the display refresh rate: %s", e.what());
+    }
+}
+
+void mga::IdleRefresh::run()
+{
+    std::unique_lock<decltype(mutex)> lk(mutex);
+    while (!stopping)
+    {
+        auto const now = std::chrono::steady_clock::now();
+        auto next_check = std::chrono::steady_clock::time_point::max();
+        for (auto& state : states)
+        {
+            auto& display = state.second;
+            if (!display.powered || display.idle || (display.config == display.idle_config))
+                continue;
+
+            auto const idle_at = display.last_post + idle_time;
+            if (idle_at > now)
+            {
+                next_check = std::min(next_check, idle_at);
+                continue;
+            }
+
+            display.idle = true;
+            try
+            {
+                hwc_wrapper->set_active_config(state.first, display.idle_config);
+            }
+            catch (std::exception const& e)
+            {
+                display.idle = false;
+                display.idle_config = display.config;
+                mir::log_warning("could not lower the idle display refresh rate: %s", e.what());
+            }
+        }
+
+        if (next_check == std::chrono::steady_clock::time_point::max())
+            posted.wait(lk);
+        else
+            posted.wait_until(lk, next_check);
+    }
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MIR_GRAPHICS_ANDROID_IDLE_REFRESH_H_
+#define MIR_GRAPHICS_ANDROID_IDLE_REFRESH_H_
+
+#include "display_name.h"
+#include "hwc_wrapper.h"
+
+#include <memory>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace mir
+{
+namespace graphics
+{
+namespace android
+{
+
+//Drops a display to a lower refresh rate once no frames have been posted to it for a while,
+//and brings the rate frames are posted at back with the next frame.
+class IdleRefresh
+{
+public:
+    IdleRefresh(std::shared_ptr<HwcWrapper> const& hwc_wrapper, std::chrono::milliseconds idle_time);
+    ~IdleRefresh();
+
+    //frames are posted at config, and the display idles at idle_config. While the display idles,
+    //the hwc reports idle_config as active; the config frames are posted at is returned instead.
+    ConfigId track(DisplayName name, ConfigId config, ConfigId idle_config);
+    //sets the hwc config frames are posted at from now on
+    void change(DisplayName name, ConfigId config, ConfigId idle_config);
+    void frame_posted(DisplayName name);
+    //the rate frames are posted at is restored while the display is still on to take it
+    void display_on(DisplayName name);
+    void display_off(DisplayName name);
+
+private:
+    IdleRefresh(IdleRefresh const&) = delete;
+    IdleRefresh& operator=(IdleRefresh const&) = delete;
+    struct State
+    {
+        ConfigId config{0};
+        ConfigId idle_config{0};
+        bool powered{true};
+        bool idle{false};
+        std::chrono::steady_clock::time_point last_post;
+    };
+    void restore(DisplayName name, State& state);
+    void run();
+
+    std::shared_ptr<HwcWrapper> const hwc_wrapper;
+    std::chrono::milliseconds const idle_time;
+
+    std::mutex mutex;
+    std::condition_variable posted;
+    std::map<DisplayName, State> states;
+    bool stopping{false};
+    std::thread thread;
+};
+
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_ANDROID_IDLE_REFRESH_H_ */
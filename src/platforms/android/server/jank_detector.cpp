@@ -0,0 +1,182 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "jank_detector.h"
+#include "hwc_report.h"
+
+#include <algorithm>
+
+namespace mga = mir::graphics::android;
+
+namespace
+{
+//about five seconds at 60Hz
+size_t const outcome_window{300};
+//frames whose retire fences are not watched are never presented
+size_t const max_unpresented_frames{8};
+
+//the first stage to finish after the deadline held the frame up. If they all finished
+//in time, the hwc or gpu was still working on the frame when the deadline came.
+mga::FrameStage cause_of_miss(mga::JankDetector::CommitTimes const& times, std::chrono::nanoseconds deadline)
+{
+    if (times.prepared > deadline)
+        return mga::FrameStage::prepare;
+    if (times.rendered > deadline)
+        return mga::FrameStage::gl_fallback;
+    if (times.set > deadline)
+        return mga::FrameStage::set;
+    return mga::FrameStage::fence_wait;
+}
+}
+
+mga::JankDetector::JankDetector(std::shared_ptr<HwcReport> const& report) :
+    hwc_report(report)
+{
+}
+
+void mga::JankDetector::vsync(DisplayName name, std::chrono::nanoseconds time)
+{
+    Reports reports;
+    {
+        std::lock_guard<decltype(mutex)> lk(mutex);
+        auto& display = displays[name];
+
+        if (display.last_vsync.count() != 0)
+        {
+            display.vsync_period.vsyncs_in(time - display.last_vsync);
+            display.period = display.vsync_period.period();
+        }
+        display.last_vsync = time;
+
+        if (display.awaiting_confirmation && (time - display.presented.present >= display.period / 2))
+        {
+            display.awaiting_confirmation = false;
+            finish(name, display, display.presented, false, reports);
+        }
+    }
+    report(reports);
+}
+
+/* A frame is committed for the first vsync after its commit started */
+uint64_t mga::JankDetector::committed(DisplayName name, CommitTimes const& times)
+{
+    std::lock_guard<decltype(mutex)> lk(mutex);
+    auto& display = displays[name];
+    auto const number = ++display.frames_committed;
+    if (display.period.count() == 0)
+        return number;
+
+    auto const periods = (times.start - display.last_vsync) / display.period;
+    auto const deadline = display.last_vsync + display.period * (std::max<decltype(periods)>(periods, 0) + 1);
+    display.committed.push_back({number, times, deadline, std::chrono::nanoseconds{0}});
+    if (display.committed.size() > max_unpresented_frames)
+        display.committed.pop_front();
+    return number;
+}
+
+/* Retire fences signal in the order the frames were committed, so the frames before this one
+ * were never seen to be presented. If the next frame is presented on the same vsync as the
+ * last, the hwc replaced the last one before showing it. */
+void mga::JankDetector::presented(DisplayName name, uint64_t frame_number, std::chrono::nanoseconds time)
+{
+    Reports reports;
+    {
+        std::lock_guard<decltype(mutex)> lk(mutex);
+        auto& display = displays[name];
+        while (!display.committed.empty() && (display.committed.front().number < frame_number))
+            display.committed.pop_front();
+        if (display.committed.empty() || (display.committed.front().number != frame_number))
+            return;
+
+        auto frame = display.committed.front();
+        display.committed.pop_front();
+        frame.present = time;
+
+        if (display.awaiting_confirmation)
+        {
+            bool const replaced = (time - display.presented.present < display.period / 2);
+            finish(name, display, display.presented, replaced, reports);
+        }
+        display.presented = frame;
+        display.awaiting_confirmation = true;
+    }
+    report(reports);
+}
+
+mga::FrameHistogram mga::JankDetector::histogram(DisplayName name) const
+{
+    std::lock_guard<decltype(mutex)> lk(mutex);
+    auto it = displays.find(name);
+    if (it == displays.end())
+        return {};
+    return it->second.histogram;
+}
+
+void mga::JankDetector::finish(
+    DisplayName name, DisplayTiming& display, Frame const& frame, bool replaced, Reports& reports)
+{
+    auto const lateness = frame.present - frame.deadline;
+    Outcome outcome{FrameOutcome::skipped, 0};
+    if (!replaced)
+    {
+        auto const vsyncs_late = (lateness + display.period / 2) / display.period;
+        outcome.vsyncs_missed = std::max<decltype(vsyncs_late)>(vsyncs_late, 0);
+        outcome.outcome = (outcome.vsyncs_missed == 0) ? FrameOutcome::on_time : FrameOutcome::late;
+    }
+
+    auto const count = [&display](Outcome const& o, int change)
+    {
+        auto& histogram = display.histogram;
+        switch (o.outcome)
+        {
+        case FrameOutcome::on_time:
+            histogram.on_time += change;
+            break;
+        case FrameOutcome::late:
+            histogram.late += change;
+            histogram.vsyncs_missed[std::min<size_t>(o.vsyncs_missed, histogram.vsyncs_missed.size()) - 1] += change;
+            break;
+        case FrameOutcome::skipped:
+            histogram.skipped += change;
+            break;
+        }
+    };
+
+    display.outcomes.push_back(outcome);
+    count(outcome, 1);
+    if (display.outcomes.size() > outcome_window)
+    {
+        count(display.outcomes.front(), -1);
+        display.outcomes.pop_front();
+    }
+
+    if (outcome.outcome != FrameOutcome::on_time)
+        reports.misses.push_back({name, outcome.outcome, cause_of_miss(frame.times, frame.deadline), lateness});
+
+    if (++display.outcomes_since_report >= outcome_window)
+    {
+        display.outcomes_since_report = 0;
+        reports.histograms.emplace_back(name, display.histogram);
+    }
+}
+
+void mga::JankDetector::report(Reports const& reports)
+{
+    for (auto const& miss : reports.misses)
+        hwc_report->report_missed_deadline(miss.name, miss.outcome, miss.cause, miss.lateness);
+    for (auto const& histogram : reports.histograms)
+        hwc_report->report_frame_histogram(histogram.first, histogram.second);
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_ANDROID_JANK_DETECTOR_H_
+#define MIR_GRAPHICS_ANDROID_JANK_DETECTOR_H_
+
+#include "display_name.h"
+#include "frame_stage.h"
+#include "vsync_period.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace mir
+{
+namespace graphics
+{
+namespace android
+{
+class HwcReport;
+
+//Works out whether each committed frame made the vsync it was committed for, from the
+//vsync, commit and present times of each display, and reports the frames that did not.
+//The times are all on CLOCK_MONOTONIC, as the hwc's vsync timestamps are.
+//Every few seconds of frames, it reports how the frames of each display fared.
+class JankDetector
+{
+public:
+    struct CommitTimes
+    {
+        std::chrono::nanoseconds start;
+        std::chrono::nanoseconds prepared;
+        std::chrono::nanoseconds rendered;
+        std::chrono::nanoseconds set;
+    };
+
+    JankDetector(std::shared_ptr<HwcReport> const& report);
+
+    void vsync(DisplayName name, std::chrono::nanoseconds time);
+    //returns the number of the frame, which is passed to presented() once it is on the display.
+    //Frames that are never presented are passed over by the next presented() of a later frame.
+    uint64_t committed(DisplayName name, CommitTimes const& times);
+    void presented(DisplayName name, uint64_t frame, std::chrono::nanoseconds time);
+
+    //the outcomes of the last few seconds of frames on the display
+    FrameHistogram histogram(DisplayName name) const;
+
+private:
+    struct Frame
+    {
+        uint64_t number;
+        CommitTimes times;
+        std::chrono::nanoseconds deadline;
+        std::chrono::nanoseconds present;
+    };
+    struct Outcome
+    {
+        FrameOutcome outcome;
+        unsigned int vsyncs_missed;
+    };
+    struct Miss
+    {
+        DisplayName name;
+        FrameOutcome outcome;
+        FrameStage cause;
+        std::chrono::nanoseconds lateness;
+    };
+    struct Reports
+    {
+        std::vector<Miss> misses;
+        std::vector<std::pair<DisplayName, FrameHistogram>> histograms;
+    };
+    struct DisplayTiming
+    {
+        std::chrono::nanoseconds last_vsync{0};
+        VsyncPeriod vsync_period;
+        std::chrono::nanoseconds period{0};
+        uint64_t frames_committed{0};
+        std::deque<Frame> committed;
+        //the last frame presented, until a vsync shows that no later frame replaced it
+        bool awaiting_confirmation{false};
+        Frame presented;
+        std::deque<Outcome> outcomes;
+        FrameHistogram histogram;
+        size_t outcomes_since_report{0};
+    };
+
+    void finish(
+        DisplayName name, DisplayTiming& display, Frame const& frame, bool replaced, Reports& reports);
+    void report(Reports const& reports);
+
+    std::shared_ptr<HwcReport> const hwc_report;
+    std::mutex mutable mutex;
+    std::map<DisplayName, DisplayTiming> displays;
+};
+
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_ANDROID_JANK_DETECTOR_H_ */
@@ -22,14 +22,20 @@
 #include "display_device_exceptions.h"
 #include <boost/throw_exception.hpp>
 #include <stdexcept>
+#include <system_error>
 #include <sstream>
 #include <algorithm>
+#include <cerrno>
+#include <sys/eventfd.h>
 
 namespace mg = mir::graphics;
 namespace mga=mir::graphics::android;
+namespace geom=mir::geometry;
 
 namespace
 {
+std::chrono::seconds const max_wait_for_set{1};
+
 int num_displays(std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& displays)
 {
     return std::distance(displays.begin(), 
@@ -58,37 +64,58 @@ mga::DisplayName display_name(int raw_name)
 //note: The destruction ordering of RealHwcWrapper should be enough to ensure that the
 //callbacks are not called after the hwc module is closed. However, some badly synchronized
 //drivers continue to call the hooks for a short period after we call close(). (LP: 1364637)
-static std::mutex callback_lock;
+//The wrapper waits for the hooks running when it goes, rather than the hooks taking a lock.
+static std::atomic<int> hooks_running{0};
+class RunningHook
+{
+public:
+    RunningHook(const struct hwc_procs* procs) :
+        callbacks{reinterpret_cast<mga::HwcCallbacks const*>(procs)}
+    {
+        hooks_running++;
+    }
+    ~RunningHook()
+    {
+        hooks_running--;
+    }
+    mga::RealHwcWrapper* wrapper() const
+    {
+        return callbacks ? callbacks->self.load() : nullptr;
+    }
+private:
+    mga::HwcCallbacks const* const callbacks;
+};
+
 static void invalidate_hook(const struct hwc_procs* procs)
 {
-    mga::HwcCallbacks const* callbacks{nullptr};
-    std::unique_lock<std::mutex> lk(callback_lock);
-    if ((callbacks = reinterpret_cast<mga::HwcCallbacks const*>(procs)) && callbacks->self)
-        callbacks->self->invalidate();
+    RunningHook hook(procs);
+    if (auto wrapper = hook.wrapper())
+        wrapper->invalidate();
 }
 
 static void vsync_hook(const struct hwc_procs* procs, int display, int64_t timestamp)
 {
-    mga::HwcCallbacks const* callbacks{nullptr};
-    std::unique_lock<std::mutex> lk(callback_lock);
-    if ((callbacks = reinterpret_cast<mga::HwcCallbacks const*>(procs)) && callbacks->self)
+    RunningHook hook(procs);
+    if (auto wrapper = hook.wrapper())
     {
         // hwcomposer.h says the clock used is CLOCK_MONOTONIC, and testing
         // on various devices confirms this is the case...
         mg::Frame::Timestamp hwc_time{CLOCK_MONOTONIC,
                                       std::chrono::nanoseconds{timestamp}};
-        callbacks->self->vsync(display_name(display), hwc_time);
+        wrapper->vsync(display_name(display), hwc_time);
     }
 }
 
 static void hotplug_hook(const struct hwc_procs* procs, int display, int connected)
 {
-    mga::HwcCallbacks const* callbacks{nullptr};
-    std::unique_lock<std::mutex> lk(callback_lock);
-    if ((callbacks = reinterpret_cast<mga::HwcCallbacks const*>(procs)) && callbacks->self)
-        callbacks->self->hotplug(display_name(display), connected);
+    RunningHook hook(procs);
+    if (auto wrapper = hook.wrapper())
+        wrapper->hotplug(display_name(display), connected);
 }
-static mga::HwcCallbacks hwc_callbacks{{invalidate_hook, vsync_hook, hotplug_hook}, nullptr};
+static mga::HwcCallbacks hwc_callbacks{hwc_procs_t{invalidate_hook, vsync_hook, hotplug_hook}};
+
+//set while the thread is handing out an event, on whichever thread the event came
+thread_local bool dispatching{false};
 
 }
 
@@ -96,25 +123,41 @@ mga::RealHwcWrapper::RealHwcWrapper(
     std::shared_ptr<hwc_composer_device_1> const& hwc_device,
     std::shared_ptr<mga::HwcReport> const& report) :
     hwc_device(hwc_device),
-    report(report)
+    report(report),
+    callback_map{new CallbackMap},
+    vsync_event{eventfd(0, EFD_CLOEXEC)}
 {
-    std::unique_lock<std::mutex> lk(callback_lock);
-    hwc_callbacks.self = this;
-    hwc_device->registerProcs(hwc_device.get(), reinterpret_cast<hwc_procs_t*>(&hwc_callbacks));
+    if (vsync_event < 0)
+    {
+        delete callback_map.load();
+        BOOST_THROW_EXCEPTION(std::system_error(errno, std::system_category(), "could not create vsync eventfd"));
+    }
+    vsync_thread = std::thread{[this] { dispatch_vsyncs(); }};
+
     is_plugged[HWC_DISPLAY_PRIMARY].store(true);
     is_plugged[HWC_DISPLAY_EXTERNAL].store(false);
     is_plugged[HWC_DISPLAY_VIRTUAL].store(true);
+    hwc_callbacks.self.store(this);
+    hwc_device->registerProcs(hwc_device.get(), reinterpret_cast<hwc_procs_t*>(&hwc_callbacks));
 }
 
 mga::RealHwcWrapper::~RealHwcWrapper()
 {
-    std::unique_lock<std::mutex> lk(callback_lock);
-    hwc_callbacks.self = nullptr;
+    hwc_callbacks.self.store(nullptr);
+    while (hooks_running.load() != 0)
+        std::this_thread::yield();
+
+    //the vsyncs already queued are handed out before the thread goes
+    stopping = true;
+    eventfd_write(vsync_event, 1);
+    vsync_thread.join();
+    delete callback_map.load();
 }
 
 void mga::RealHwcWrapper::prepare(
     std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& displays) const
 {
+    std::lock_guard<std::mutex> lk(commit_lock);
     report->report_list_submitted_to_prepare(displays);
     if (auto rc = hwc_device->prepare(hwc_device.get(), num_displays(displays),
         const_cast<hwc_display_contents_1**>(displays.data())))
@@ -124,12 +167,17 @@ void mga::RealHwcWrapper::prepare(
         BOOST_THROW_EXCEPTION(std::runtime_error(ss.str()));
     }
 
+    set_pending = true;
     report->report_prepare_done(displays);
 }
 
 void mga::RealHwcWrapper::set(
     std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& displays) const
 {
+    std::lock_guard<std::mutex> lk(commit_lock);
+    //the calls waiting for it get in once this returns, even if it throws
+    set_pending = false;
+    set_done.notify_all();
     report->report_set_list(displays);
     auto const num_displays = ::num_displays(displays);
     if (auto rc = hwc_device->set(hwc_device.get(), num_displays,
@@ -151,8 +199,19 @@ void mga::RealHwcWrapper::set(
     report->report_set_done(displays);
 }
 
+/* A set() always follows a prepare(), unless the frame is abandoned, eg because rendering it
+ * threw. So as not to hang on such a frame, the wait for its set() is bounded. */
+std::unique_lock<std::mutex> mga::RealHwcWrapper::lock_between_frames() const
+{
+    std::unique_lock<std::mutex> lk(commit_lock);
+    set_done.wait_for(lk, max_wait_for_set, [this] { return !set_pending; });
+    set_pending = false;
+    return lk;
+}
+
 void mga::RealHwcWrapper::vsync_signal_on(DisplayName display_name) const
 {
+    auto const lk = lock_between_frames();
     if (auto rc = hwc_device->eventControl(hwc_device.get(), as_hwc_display(display_name), HWC_EVENT_VSYNC, 1))
     {
         std::stringstream ss;
@@ -164,6 +223,7 @@ void mga::RealHwcWrapper::vsync_signal_on(DisplayName display_name) const
 
 void mga::RealHwcWrapper::vsync_signal_off(DisplayName display_name) const
 {
+    auto const lk = lock_between_frames();
     if (auto rc = hwc_device->eventControl(hwc_device.get(), as_hwc_display(display_name), HWC_EVENT_VSYNC, 0))
     {
         std::stringstream ss;
@@ -175,6 +235,7 @@ void mga::RealHwcWrapper::vsync_signal_off(DisplayName display_name) const
 
 void mga::RealHwcWrapper::display_on(DisplayName display_name) const
 {
+    auto const lk = lock_between_frames();
     if (auto rc = hwc_device->blank(hwc_device.get(), as_hwc_display(display_name), 0))
     {
         std::stringstream ss;
@@ -186,6 +247,7 @@ void mga::RealHwcWrapper::display_on(DisplayName display_name) const
 
 void mga::RealHwcWrapper::display_off(DisplayName display_name) const
 {
+    auto const lk = lock_between_frames();
     if (auto rc = hwc_device->blank(hwc_device.get(), as_hwc_display(display_name), 1))
     {
         std::stringstream ss;
@@ -202,64 +264,111 @@ void mga::RealHwcWrapper::subscribe_to_events(
         std::function<void()> const& invalidate)
 {
     std::unique_lock<std::mutex> lk(callback_map_lock);
-    callback_map[subscriber] = {vsync, hotplug, invalidate};
+    std::unique_ptr<CallbackMap> new_map{new CallbackMap(*callback_map.load())};
+    (*new_map)[subscriber] = {vsync, hotplug, invalidate};
+    publish(std::move(new_map));
 }
 
+/* Once this returns, none of the subscriber's callbacks are running, and none are called again.
+ * It waits for the events being handed out, so it must not be called while holding a lock that
+ * a subscriber's callbacks take. A callback can unsubscribe (or subscribe) without waiting, but
+ * then the subscriber's callbacks may still be running for events on other threads. */
 void mga::RealHwcWrapper::unsubscribe_from_events(void const* subscriber) noexcept
 {
     std::unique_lock<std::mutex> lk(callback_map_lock);
-    auto it = callback_map.find(subscriber);
-    if (it != callback_map.end())
-        callback_map.erase(it);
+    auto const current_map = callback_map.load();
+    if (current_map->find(subscriber) == current_map->end())
+        return;
+    std::unique_ptr<CallbackMap> new_map{new CallbackMap(*current_map)};
+    new_map->erase(subscriber);
+    publish(std::move(new_map));
 }
 
-void mga::RealHwcWrapper::vsync(DisplayName name, mg::Frame::Timestamp timestamp) noexcept
+void mga::RealHwcWrapper::publish(std::unique_ptr<CallbackMap const> new_map)
 {
-    std::unique_lock<std::mutex> lk(callback_map_lock);
-    for(auto const& callbacks : callback_map)
-    {
-        try
-        {
-            callbacks.second.vsync(name, timestamp);
-        }
-        catch (...)
-        {
-        }
-    }
+    retired_callback_maps.emplace_back(callback_map.exchange(new_map.release()));
+    if (wait_for_dispatches())
+        retired_callback_maps.clear();
 }
 
-void mga::RealHwcWrapper::hotplug(DisplayName name, bool connected) noexcept
+/* Events are handed out from the map loaded after the dispatch was counted, so
+ * once no dispatches are counted, none can be using a map replaced before */
+bool mga::RealHwcWrapper::wait_for_dispatches()
 {
-    is_plugged[mga::as_hwc_display(name)].store(connected);
+    //the callback this is called from counts as a dispatch, and is using a replaced map
+    if (dispatching)
+        return false;
 
-    std::unique_lock<std::mutex> lk(callback_map_lock);
-    for(auto const& callbacks : callback_map)
+    std::unique_lock<std::mutex> lk(dispatches_lock);
+    dispatches_done.wait(lk, [this] { return dispatches.load() == 0; });
+    return true;
+}
+
+/* The lock is only taken by the last dispatch to finish, so that a waiter cannot miss it */
+template<typename Call>
+void mga::RealHwcWrapper::dispatch(Call const& call) noexcept
+{
+    bool const nested = dispatching;
+    dispatching = true;
+    dispatches++;
+    for(auto const& callbacks : *callback_map.load())
     {
         try
         {
-            callbacks.second.hotplug(name, connected);
+            call(callbacks.second);
         }
         catch (...)
         {
         }
     }
+    dispatching = nested;
+    if (--dispatches == 0)
+    {
+        {
+            std::lock_guard<std::mutex> lk(dispatches_lock);
+        }
+        dispatches_done.notify_all();
+    }
 }
 
-void mga::RealHwcWrapper::invalidate() noexcept
+void mga::RealHwcWrapper::dispatch_vsyncs()
 {
-    std::unique_lock<std::mutex> lk(callback_map_lock);
-    for(auto const& callbacks : callback_map)
+    while (true)
     {
-        try
-        {
-            callbacks.second.invalidate();
-        }
-        catch (...)
-        {
-        }
+        eventfd_t count{0};
+        if ((eventfd_read(vsync_event, &count) < 0) && (errno == EINTR))
+            continue;
+
+        //the wrapper stops once the hooks have returned, so the vsyncs queued by then are handed out
+        bool const last = stopping;
+        VsyncQueue::Vsync vsync;
+        while (vsync_queue.pop(vsync))
+            dispatch([&vsync](Callbacks const& callbacks) { callbacks.vsync(vsync.name, vsync.timestamp); });
+
+        if (last)
+            return;
     }
 }
 
+/* Called on the hwc's vsync thread, which only queues the vsync and wakes the thread
+ * that hands it out. A vsync that does not fit in the queue is dropped. */
+void mga::RealHwcWrapper::vsync(DisplayName name, mg::Frame::Timestamp timestamp) noexcept
+{
+    if (vsync_queue.push({name, timestamp}))
+        eventfd_write(vsync_event, 1);
+}
+
+void mga::RealHwcWrapper::hotplug(DisplayName name, bool connected) noexcept
+{
+    is_plugged[mga::as_hwc_display(name)].store(connected);
+    dispatch([&](Callbacks const& callbacks) { callbacks.hotplug(name, connected); });
+}
+
+void mga::RealHwcWrapper::invalidate() noexcept
+{
+    dispatch([](Callbacks const& callbacks) { callbacks.invalidate(); });
+}
+
 std::vector<mga::ConfigId> mga::RealHwcWrapper::display_configs(DisplayName display_name) const
 {
     //Check first if display is unplugged, as some hw composers incorrectly report display configurations
@@ -267,17 +376,25 @@ std::vector<mga::ConfigId> mga::RealHwcWrapper::display_configs(DisplayName disp
     if (!is_plugged[mga::as_hwc_display(display_name)].load())
         return {};
 
-    //No way to get the number of display configs. SF uses 128 possible spots, but that seems excessive.
-    static size_t const max_configs = 16;
-    size_t num_configs = max_configs;
-    static uint32_t display_config[max_configs] = {};
-    if (hwc_device->getDisplayConfigs(hwc_device.get(), as_hwc_display(display_name), display_config, &num_configs))
-        return {};
+    //No way to get the number of display configs, other than offering more room until some is left over.
+    //SF uses 128 possible spots, which is also where this stops.
+    size_t const max_configs = 128;
+    std::vector<uint32_t> display_config(16);
+    size_t num_configs{0};
+    while (true)
+    {
+        num_configs = display_config.size();
+        if (hwc_device->getDisplayConfigs(
+                hwc_device.get(), as_hwc_display(display_name), display_config.data(), &num_configs))
+            return {};
+        if ((num_configs < display_config.size()) || (display_config.size() >= max_configs))
+            break;
+        display_config.resize(display_config.size() * 2);
+    }
 
-    auto i = 0u;
-    std::vector<mga::ConfigId> config_ids{std::min(max_configs, num_configs)};
-    for(auto& id : config_ids)
-        id = mga::ConfigId{display_config[i++]};
+    std::vector<mga::ConfigId> config_ids;
+    for (auto i = 0u; i != std::min(num_configs, display_config.size()); i++)
+        config_ids.emplace_back(mga::ConfigId{display_config[i]});
     return config_ids;
 }
 
@@ -290,6 +407,7 @@ int mga::RealHwcWrapper::display_attributes(
 
 void mga::RealHwcWrapper::power_mode(DisplayName display_name, PowerMode mode) const
 {
+    auto const lk = lock_between_frames();
     if (auto rc = hwc_device->setPowerMode(hwc_device.get(), as_hwc_display(display_name), static_cast<int>(mode)))
     {
         std::stringstream ss;
@@ -305,25 +423,43 @@ bool mga::RealHwcWrapper::has_active_config(DisplayName display_name) const
     return hwc_device->getActiveConfig(hwc_device.get(), as_hwc_display(display_name)) != no_active_config;
 }
 
+/* The hwc refers to the active config by its index in the list of configs, not by its id */
 mga::ConfigId mga::RealHwcWrapper::active_config_for(DisplayName display_name) const
 {
-    int id = hwc_device->getActiveConfig(hwc_device.get(), as_hwc_display(display_name));
-    if (id == -1)
+    int index = hwc_device->getActiveConfig(hwc_device.get(), as_hwc_display(display_name));
+    auto const configs = display_configs(display_name);
+    if ((index < 0) || (static_cast<size_t>(index) >= configs.size()))
     {
         std::stringstream ss;
         ss << "No active configuration for display: " << as_hwc_display(display_name);
         BOOST_THROW_EXCEPTION(std::runtime_error(ss.str()));
     }
-    return mga::ConfigId{static_cast<uint32_t>(id)};
+    return configs[index];
 }
 
 void mga::RealHwcWrapper::set_active_config(DisplayName display_name, ConfigId id) const
 {
-    int rc = hwc_device->setActiveConfig(hwc_device.get(), as_hwc_display(display_name), id.as_value());
+    auto const configs = display_configs(display_name);
+    auto const config = std::find(configs.begin(), configs.end(), id);
+    if (config == configs.end())
+        BOOST_THROW_EXCEPTION(std::invalid_argument("display config is not one of the display's configs"));
+
+    auto const lk = lock_between_frames();
+    int rc = hwc_device->setActiveConfig(
+        hwc_device.get(), as_hwc_display(display_name), std::distance(configs.begin(), config));
     if (rc < 0)
         BOOST_THROW_EXCEPTION(std::system_error(rc, std::system_category(), "unable to set active display config"));
 }
 
+bool mga::RealHwcWrapper::set_cursor_position(DisplayName display_name, geom::Point position) const
+{
+    if ((hwc_device->common.version < HWC_DEVICE_API_VERSION_1_4) || !hwc_device->setCursorPositionAsync)
+        return false;
+
+    return hwc_device->setCursorPositionAsync(
+        hwc_device.get(), as_hwc_display(display_name), position.x.as_int(), position.y.as_int()) == 0;
+}
+
 bool mga::RealHwcWrapper::display_connected(DisplayName display_name) const
 {
     size_t num_configs = 0;
@@ -20,11 +20,16 @@
 #define MIR_GRAPHICS_ANDROID_REAL_HWC_WRAPPER_H_
 
 #include "hwc_wrapper.h"
+#include "vsync_queue.h"
+#include "mir/fd.h"
 #include <memory>
 #include <hardware/hwcomposer.h>
 
 #include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 #include <atomic>
 
 namespace mir
@@ -37,8 +42,9 @@ class HwcReport;
 class RealHwcWrapper;
 struct HwcCallbacks
 {
+    HwcCallbacks(hwc_procs_t const& hooks) : hooks(hooks), self{nullptr} {}
     hwc_procs_t hooks;
-    RealHwcWrapper* self;
+    std::atomic<RealHwcWrapper*> self;
 };
 
 class RealHwcWrapper : public HwcWrapper
@@ -70,6 +76,7 @@ public:
     bool has_active_config(DisplayName name) const override;
     ConfigId active_config_for(DisplayName name) const override;
     void set_active_config(DisplayName name, ConfigId id) const override;
+    bool set_cursor_position(DisplayName name, geometry::Point position) const override;
 
     void vsync(DisplayName, graphics::Frame::Timestamp) noexcept;
     void hotplug(DisplayName, bool) noexcept;
@@ -77,17 +84,48 @@ public:
 
     bool display_connected(DisplayName) const;
 private:
-    std::shared_ptr<hwc_composer_device_1> const hwc_device;
-    std::shared_ptr<HwcReport> const report;
-    std::mutex callback_map_lock;
     struct Callbacks
     {
         std::function<void(DisplayName, graphics::Frame::Timestamp)> vsync;
         std::function<void(DisplayName, bool)> hotplug;
         std::function<void()> invalidate;
     };
-    std::unordered_map<void const*, Callbacks> callback_map;
+    using CallbackMap = std::unordered_map<void const*, Callbacks>;
+
+    template<typename Call>
+    void dispatch(Call const& call) noexcept;
+    void publish(std::unique_ptr<CallbackMap const> new_map);
+    //once this returns true, no callbacks are running from the maps replaced before it was called.
+    //Called from a callback, it returns false straight away.
+    bool wait_for_dispatches();
+    void dispatch_vsyncs();
+
+    std::shared_ptr<hwc_composer_device_1> const hwc_device;
+    std::shared_ptr<HwcReport> const report;
+
+    //the events are handed out without locks, from a map of the subscribers that is replaced
+    //whenever they change. A replaced map is kept until no events are being handed out from it.
+    std::mutex callback_map_lock;
+    std::atomic<CallbackMap const*> callback_map;
+    std::vector<std::unique_ptr<CallbackMap const>> retired_callback_maps;
+    std::atomic<int> dispatches{0};
+    std::mutex dispatches_lock;
+    std::condition_variable dispatches_done;
+
+    //the hwc's vsync thread only queues the vsync, which is handed out on a thread of our own
+    VsyncQueue vsync_queue;
+    Fd const vsync_event;
+    std::atomic<bool> stopping{false};
+    std::thread vsync_thread;
+
     std::atomic<bool> is_plugged[HWC_NUM_DISPLAY_TYPES];
+
+    //prepare() and set() can run on a commit thread. The calls that change the state of a display
+    //wait for the set() of a prepared frame, so that they do not come between the two.
+    std::unique_lock<std::mutex> lock_between_frames() const;
+    std::mutex mutable commit_lock;
+    std::condition_variable mutable set_done;
+    bool mutable set_pending{false};
 };
 
 }
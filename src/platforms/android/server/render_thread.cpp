@@ -0,0 +1,83 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "render_thread.h"
+
+#include <boost/throw_exception.hpp>
+#include <stdexcept>
+
+namespace mga = mir::graphics::android;
+
+mga::RenderThread::RenderThread() :
+    thread{[this] { run_tasks(); }}
+{
+}
+
+mga::RenderThread::~RenderThread()
+{
+    {
+        std::lock_guard<decltype(mutex)> lk(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    thread.join();
+}
+
+void mga::RenderThread::run(std::function<void()> const& next_task)
+{
+    std::lock_guard<decltype(mutex)> lk(mutex);
+    if (task)
+        BOOST_THROW_EXCEPTION(std::logic_error("render thread is already running a task"));
+    task = next_task;
+    changed.notify_all();
+}
+
+void mga::RenderThread::wait()
+{
+    std::unique_lock<decltype(mutex)> lk(mutex);
+    changed.wait(lk, [this] { return !task; });
+    auto const task_error = error;
+    error = nullptr;
+    if (task_error)
+        std::rethrow_exception(task_error);
+}
+
+void mga::RenderThread::run_tasks()
+{
+    std::unique_lock<decltype(mutex)> lk(mutex);
+    while (true)
+    {
+        changed.wait(lk, [this] { return stopping || task; });
+        if (!task)
+            return;
+
+        lk.unlock();
+        std::exception_ptr task_error;
+        try
+        {
+            task();
+        }
+        catch (...)
+        {
+            task_error = std::current_exception();
+        }
+        lk.lock();
+
+        error = task_error;
+        task = nullptr;
+        changed.notify_all();
+    }
+}
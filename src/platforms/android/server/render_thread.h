@@ -0,0 +1,63 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_ANDROID_RENDER_THREAD_H_
+#define MIR_GRAPHICS_ANDROID_RENDER_THREAD_H_
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+namespace mir
+{
+namespace graphics
+{
+namespace android
+{
+
+//Runs one task at a time on a thread of its own, so that one display's gl render
+//can overlap another's. Each render makes its context current and releases it again,
+//as the same display may be rendered inline on the compositor thread on another frame.
+class RenderThread
+{
+public:
+    RenderThread();
+    ~RenderThread();
+
+    void run(std::function<void()> const& task);
+    //waits for the task to finish, and rethrows anything it threw
+    void wait();
+
+private:
+    RenderThread(RenderThread const&) = delete;
+    RenderThread& operator=(RenderThread const&) = delete;
+    void run_tasks();
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::function<void()> task;
+    std::exception_ptr error;
+    bool stopping{false};
+    std::thread thread;
+};
+
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_ANDROID_RENDER_THREAD_H_ */
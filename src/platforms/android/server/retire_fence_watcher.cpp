@@ -0,0 +1,131 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "retire_fence_watcher.h"
+#include "sync_fence.h"
+
+#include <linux/sync.h>
+#include <algorithm>
+#include <vector>
+#include <time.h>
+
+namespace mg = mir::graphics;
+namespace mga = mir::graphics::android;
+
+namespace
+{
+//bounds the wait, so that the watcher can stop while a fence is outstanding
+int const wait_timeout_ms{1000};
+//room for the points of a few merged fences
+size_t const fence_info_size{4096};
+//a few frames' worth. If the hwc stops signalling, the fences beyond it are given up on.
+size_t const max_watched_fences{4};
+}
+
+mga::RetireFenceWatcher::RetireFenceWatcher(std::shared_ptr<SyncFileOps> const& ops) :
+    ops(ops)
+{
+}
+
+mga::RetireFenceWatcher::~RetireFenceWatcher()
+{
+    {
+        std::lock_guard<decltype(mutex)> lk(mutex);
+        stopping = true;
+    }
+    fences_changed.notify_all();
+    if (thread.joinable())
+        thread.join();
+}
+
+void mga::RetireFenceWatcher::set_callback(PresentedCallback const& presented)
+{
+    std::lock_guard<decltype(callback_mutex)> lk(callback_mutex);
+    callback = presented;
+}
+
+void mga::RetireFenceWatcher::watch(DisplayName name, uint64_t frame, Fd retire_fence)
+{
+    if (retire_fence < 0)
+        return;
+
+    {
+        std::lock_guard<decltype(callback_mutex)> lk(callback_mutex);
+        if (!callback)
+            return;
+    }
+
+    std::lock_guard<decltype(mutex)> lk(mutex);
+    if (!thread.joinable())
+        thread = std::thread{[this] { run(); }};
+    fences.push_back({name, frame, std::move(retire_fence)});
+    while (fences.size() > max_watched_fences)
+        fences.pop_front();
+    fences_changed.notify_all();
+}
+
+void mga::RetireFenceWatcher::run()
+{
+    std::unique_lock<decltype(mutex)> lk(mutex);
+    while (true)
+    {
+        fences_changed.wait(lk, [this] { return stopping || !fences.empty(); });
+        if (stopping)
+            return;
+
+        auto fence = std::move(fences.front());
+        fences.pop_front();
+        lk.unlock();
+
+        int timeout = wait_timeout_ms;
+        Frame::Timestamp presented;
+        if ((ops->ioctl(fence.fence, SYNC_IOC_WAIT, &timeout) >= 0) && signal_time(fence.fence, presented))
+        {
+            std::lock_guard<decltype(callback_mutex)> callback_lk(callback_mutex);
+            if (callback)
+                callback(fence.name, fence.frame, presented);
+        }
+
+        lk.lock();
+    }
+}
+
+/* The time the fence signalled is that of its last point to signal, as it may be a merge
+ * of several. The sync driver stamps points with CLOCK_MONOTONIC, as the hwc does vsyncs. */
+bool mga::RetireFenceWatcher::signal_time(Fd const& fence, Frame::Timestamp& time)
+{
+    std::vector<uint8_t> buffer(fence_info_size);
+    auto const info = reinterpret_cast<sync_fence_info_data*>(buffer.data());
+    info->len = buffer.size();
+    if ((ops->ioctl(fence, SYNC_IOC_FENCE_INFO, info) < 0) || (info->status != 1))
+        return false;
+
+    uint64_t latest{0};
+    auto const points_size = std::min<size_t>(info->len, buffer.size()) - sizeof(sync_fence_info_data);
+    for (size_t offset = 0; offset + sizeof(sync_pt_info) <= points_size;)
+    {
+        auto const point = reinterpret_cast<sync_pt_info*>(info->pt_info + offset);
+        if (point->len < sizeof(sync_pt_info))
+            break;
+        latest = std::max<uint64_t>(latest, point->timestamp_ns);
+        offset += point->len;
+    }
+
+    if (latest == 0)
+        return false;
+    time = Frame::Timestamp{CLOCK_MONOTONIC, std::chrono::nanoseconds{latest}};
+    return true;
+}
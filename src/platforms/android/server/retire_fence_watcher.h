@@ -0,0 +1,84 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_ANDROID_RETIRE_FENCE_WATCHER_H_
+#define MIR_GRAPHICS_ANDROID_RETIRE_FENCE_WATCHER_H_
+
+#include "mir/graphics/frame.h"
+#include "mir/fd.h"
+#include "display_name.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace mir
+{
+namespace graphics
+{
+namespace android
+{
+class SyncFileOps;
+
+//Waits for the retire fences of committed frames on a thread of its own, and passes on the
+//time each one signalled. That is when the frame went on to the display. Frames are passed on
+//by the number they were watched with, as a frame whose fence is not waited for is left out.
+//Only the last few fences are kept waiting, so the oldest are closed unwatched if the hwc stalls.
+class RetireFenceWatcher
+{
+public:
+    using PresentedCallback = std::function<void(DisplayName, uint64_t frame, Frame::Timestamp)>;
+
+    RetireFenceWatcher(std::shared_ptr<SyncFileOps> const& ops);
+    ~RetireFenceWatcher();
+
+    //once this returns, the last callback has returned. Fences are closed unwatched without one.
+    void set_callback(PresentedCallback const& presented);
+    void watch(DisplayName name, uint64_t frame, Fd retire_fence);
+
+private:
+    RetireFenceWatcher(RetireFenceWatcher const&) = delete;
+    RetireFenceWatcher& operator=(RetireFenceWatcher const&) = delete;
+    void run();
+    bool signal_time(Fd const& fence, Frame::Timestamp& time);
+
+    std::shared_ptr<SyncFileOps> const ops;
+
+    std::mutex callback_mutex;
+    PresentedCallback callback;
+
+    std::mutex mutex;
+    std::condition_variable fences_changed;
+    struct WatchedFence
+    {
+        DisplayName name;
+        uint64_t frame;
+        Fd fence;
+    };
+    std::deque<WatchedFence> fences;
+    bool stopping{false};
+    std::thread thread;
+};
+
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_ANDROID_RETIRE_FENCE_WATCHER_H_ */
@@ -99,8 +99,7 @@ int mga::ServerRenderWindow::driver_requests_info(int key) const
         case NATIVE_WINDOW_CONSUMER_USAGE_BITS:
             return GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_COMPOSER | GRALLOC_USAGE_HW_FB;
         case NATIVE_WINDOW_BUFFER_AGE:
-            // 0 is a safe fallback since no buffer tracking is in place
-            return 0;
+            return fb_bundle->buffer_age();
         case NATIVE_WINDOW_LAST_QUEUE_DURATION:
             return 20;
         case NATIVE_WINDOW_LAST_DEQUEUE_DURATION:
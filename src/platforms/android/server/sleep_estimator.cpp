@@ -0,0 +1,58 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sleep_estimator.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace mga = mir::graphics::android;
+
+namespace
+{
+//about a second at 60Hz
+size_t const window{60};
+//the 90th percentile, so that the odd slow frame does not stop the compositor sleeping
+size_t const percentile{90};
+//covers waking up late
+std::chrono::nanoseconds const margin{std::chrono::milliseconds{2}};
+}
+
+void mga::SleepEstimator::frame_took(std::chrono::nanoseconds duration)
+{
+    durations.push_back(duration);
+    if (durations.size() > window)
+        durations.pop_front();
+}
+
+std::chrono::nanoseconds mga::SleepEstimator::expected_frame_duration() const
+{
+    if (durations.empty())
+        return std::chrono::nanoseconds{0};
+
+    std::vector<std::chrono::nanoseconds> sorted(durations.begin(), durations.end());
+    auto const nth = sorted.begin() + (sorted.size() - 1) * percentile / 100;
+    std::nth_element(sorted.begin(), nth, sorted.end());
+    return *nth;
+}
+
+std::chrono::milliseconds mga::SleepEstimator::sleep_before(std::chrono::nanoseconds time_until_vsync) const
+{
+    auto const sleep = time_until_vsync - expected_frame_duration() - margin;
+    if (sleep.count() <= 0)
+        return std::chrono::milliseconds{0};
+    return std::chrono::duration_cast<std::chrono::milliseconds>(sleep);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_ANDROID_SLEEP_ESTIMATOR_H_
+#define MIR_GRAPHICS_ANDROID_SLEEP_ESTIMATOR_H_
+
+#include <chrono>
+#include <deque>
+
+namespace mir
+{
+namespace graphics
+{
+namespace android
+{
+
+//Works out how long the compositor can sleep before starting a frame and still have it committed
+//by a vsync, from how long the last frames took from the start of composition to the end of commit.
+class SleepEstimator
+{
+public:
+    void frame_took(std::chrono::nanoseconds duration);
+    //most frames are done within this long
+    std::chrono::nanoseconds expected_frame_duration() const;
+    std::chrono::milliseconds sleep_before(std::chrono::nanoseconds time_until_vsync) const;
+
+private:
+    std::deque<std::chrono::nanoseconds> durations;
+};
+
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_ANDROID_SLEEP_ESTIMATOR_H_ */
@@ -19,6 +19,7 @@
 #ifndef MIR_GRAPHICS_ANDROID_SWAPPING_GL_CONTEXT_H_
 #define MIR_GRAPHICS_ANDROID_SWAPPING_GL_CONTEXT_H_
 
+#include "mir/geometry/rectangle.h"
 #include <memory>
 
 namespace mir
@@ -35,7 +36,13 @@ public:
     virtual void make_current() const = 0;
     virtual void release_current() const = 0;
     virtual void swap_buffers() const = 0;
+    //damage is in the coordinates of the surface, with the origin at the top left
+    virtual void swap_buffers_with_damage(geometry::Rectangle const& damage) const = 0;
+    //frames since the current back buffer was last swapped, or 0 if its contents are undefined
+    virtual unsigned int buffer_age() const = 0;
     virtual std::shared_ptr<Buffer> last_rendered_buffer() const = 0;
+    //renders with an extra buffer while the hwc asks for one (HWC_HINT_TRIPLE_BUFFER)
+    virtual void set_triple_buffering(bool enabled) const = 0;
 
 protected:
     SwappingGLContext() = default;
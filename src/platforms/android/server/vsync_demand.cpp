@@ -0,0 +1,158 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "vsync_demand.h"
+#include "hwc_wrapper.h"
+
+#include <algorithm>
+#include <vector>
+
+#define MIR_LOG_COMPONENT "android/server"
+#include "mir/log.h"
+
+namespace mga = mir::graphics::android;
+
+mga::VsyncDemand::VsyncDemand(std::shared_ptr<HwcWrapper> const& hwc_wrapper, unsigned int idle_frames) :
+    hwc_wrapper(hwc_wrapper),
+    idle_frames(idle_frames),
+    thread{[this] { run(); }}
+{
+}
+
+mga::VsyncDemand::~VsyncDemand()
+{
+    {
+        std::lock_guard<decltype(state_mutex)> lk(state_mutex);
+        stopping = true;
+    }
+    state_changed.notify_all();
+    thread.join();
+}
+
+void mga::VsyncDemand::display_on(DisplayName name)
+{
+    std::lock_guard<decltype(control_mutex)> control_lk(control_mutex);
+    {
+        std::lock_guard<decltype(state_mutex)> lk(state_mutex);
+        auto& state = states[name];
+        state = State{};
+        state.powered = true;
+        state.enabled = true;
+        state.wanted = true;
+    }
+    hwc_wrapper->vsync_signal_on(name);
+}
+
+void mga::VsyncDemand::display_off(DisplayName name)
+{
+    std::lock_guard<decltype(control_mutex)> control_lk(control_mutex);
+    {
+        std::lock_guard<decltype(state_mutex)> lk(state_mutex);
+        states[name] = State{};
+    }
+    hwc_wrapper->vsync_signal_off(name);
+}
+
+void mga::VsyncDemand::request(DisplayName name, unsigned int frames)
+{
+    {
+        std::lock_guard<decltype(state_mutex)> lk(state_mutex);
+        auto& state = states[name];
+        state.frames_requested = std::max(state.frames_requested, frames);
+        state.frames_idle = 0;
+        if (!state.powered || state.wanted)
+            return;
+        state.wanted = true;
+    }
+    state_changed.notify_all();
+}
+
+/* Requested frames are counted down first, then the idle ones */
+void mga::VsyncDemand::vsync(DisplayName name)
+{
+    {
+        std::lock_guard<decltype(state_mutex)> lk(state_mutex);
+        auto& state = states[name];
+        if (state.frames_requested > 0)
+        {
+            state.frames_requested--;
+            return;
+        }
+        if (!state.wanted || (++state.frames_idle < idle_frames))
+            return;
+        state.wanted = false;
+    }
+    state_changed.notify_all();
+}
+
+bool mga::VsyncDemand::change_pending() const
+{
+    return std::any_of(states.begin(), states.end(),
+        [](std::pair<DisplayName const, State> const& state)
+        {
+            return state.second.powered && (state.second.enabled != state.second.wanted);
+        });
+}
+
+/* The state is checked again, as the display could have been turned off since the change was asked for */
+void mga::VsyncDemand::apply(DisplayName name)
+{
+    bool enable{false};
+    {
+        std::lock_guard<decltype(state_mutex)> lk(state_mutex);
+        auto& state = states[name];
+        if (!state.powered || (state.enabled == state.wanted))
+            return;
+        state.enabled = enable = state.wanted;
+    }
+
+    //the driver leaves the signal as it was, which is no worse than before on demand vsync
+    try
+    {
+        if (enable)
+            hwc_wrapper->vsync_signal_on(name);
+        else
+            hwc_wrapper->vsync_signal_off(name);
+    }
+    catch (std::exception const& e)
+    {
+        mir::log_warning("could not change the vsync signal: %s", e.what());
+    }
+}
+
+void mga::VsyncDemand::run()
+{
+    std::unique_lock<decltype(state_mutex)> lk(state_mutex);
+    while (true)
+    {
+        state_changed.wait(lk, [this] { return stopping || change_pending(); });
+        if (stopping)
+            return;
+
+        std::vector<DisplayName> names;
+        for (auto const& state : states)
+            names.push_back(state.first);
+        lk.unlock();
+
+        {
+            std::lock_guard<decltype(control_mutex)> control_lk(control_mutex);
+            for (auto name : names)
+                apply(name);
+        }
+
+        lk.lock();
+    }
+}
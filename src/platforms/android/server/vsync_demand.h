@@ -0,0 +1,83 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_ANDROID_VSYNC_DEMAND_H_
+#define MIR_GRAPHICS_ANDROID_VSYNC_DEMAND_H_
+
+#include "display_name.h"
+
+#include <memory>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace mir
+{
+namespace graphics
+{
+namespace android
+{
+class HwcWrapper;
+
+//Keeps the hwc vsync signal of a powered display on only while something wants vsync. It goes
+//on when frames are requested, and off once the display has been idle for a while. Turning it
+//off from the vsync callback could deadlock the driver, so the changes are made on a thread.
+class VsyncDemand
+{
+public:
+    VsyncDemand(std::shared_ptr<HwcWrapper> const& hwc_wrapper, unsigned int idle_frames);
+    ~VsyncDemand();
+
+    //the frames just after a display comes on are wanted, so vsync goes on with it
+    void display_on(DisplayName name);
+    void display_off(DisplayName name);
+
+    void request(DisplayName name, unsigned int frames);
+    void vsync(DisplayName name);
+
+private:
+    VsyncDemand(VsyncDemand const&) = delete;
+    VsyncDemand& operator=(VsyncDemand const&) = delete;
+    struct State
+    {
+        bool powered{false};
+        bool enabled{false};
+        bool wanted{false};
+        unsigned int frames_requested{0};
+        unsigned int frames_idle{0};
+    };
+    bool change_pending() const;
+    void apply(DisplayName name);
+    void run();
+
+    std::shared_ptr<HwcWrapper> const hwc_wrapper;
+    unsigned int const idle_frames;
+
+    //serializes the calls to the hwc, and is taken before the state mutex
+    std::mutex control_mutex;
+    std::mutex state_mutex;
+    std::condition_variable state_changed;
+    std::map<DisplayName, State> states;
+    bool stopping{false};
+    std::thread thread;
+};
+
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_ANDROID_VSYNC_DEMAND_H_ */
@@ -0,0 +1,80 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "vsync_period.h"
+
+namespace mga = mir::graphics::android;
+
+namespace
+{
+//the refresh rate is taken to have dropped after this many long intervals of the same length
+unsigned int const long_intervals_before_relearning{4};
+//vsync being turned off leaves a gap of any length, a rate drop of no more than this
+int64_t const max_rate_drop{3};
+
+bool about_the_same(std::chrono::nanoseconds a, std::chrono::nanoseconds b)
+{
+    auto const difference = (a > b) ? (a - b) : (b - a);
+    return difference <= a / 8;
+}
+}
+
+int64_t mga::VsyncPeriod::vsyncs_in(std::chrono::nanoseconds interval)
+{
+    if (interval.count() <= 0)
+        return 1;
+
+    if (learned.count() == 0)
+    {
+        learned = interval;
+        return 1;
+    }
+
+    if (interval < learned * 3 / 2)
+    {
+        long_intervals = 0;
+        learned = (learned * 7 + interval) / 8;
+        return 1;
+    }
+
+    if (interval >= learned * max_rate_drop)
+        long_intervals = 0;
+    else if ((long_intervals > 0) && about_the_same(last_long_interval, interval))
+        long_intervals++;
+    else
+        long_intervals = 1;
+    last_long_interval = interval;
+
+    if (long_intervals >= long_intervals_before_relearning)
+    {
+        long_intervals = 0;
+        learned = interval;
+        return 1;
+    }
+    return (interval + learned / 2) / learned;
+}
+
+std::chrono::nanoseconds mga::VsyncPeriod::period() const
+{
+    return learned;
+}
+
+void mga::VsyncPeriod::reset()
+{
+    learned = std::chrono::nanoseconds{0};
+    last_long_interval = std::chrono::nanoseconds{0};
+    long_intervals = 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MIR_GRAPHICS_ANDROID_VSYNC_PERIOD_H_
+#define MIR_GRAPHICS_ANDROID_VSYNC_PERIOD_H_
+
+#include <chrono>
+#include <cstdint>
+
+namespace mir
+{
+namespace graphics
+{
+namespace android
+{
+
+//Learns the vsync period of a display from the intervals between its vsyncs. An interval of more
+//than one and a half periods spans vsyncs that were not delivered, unless a few such intervals
+//in a row are the same length, which is the refresh rate having dropped.
+class VsyncPeriod
+{
+public:
+    //returns how many vsyncs the interval since the last vsync spans
+    int64_t vsyncs_in(std::chrono::nanoseconds interval);
+    //zero until there has been an interval to learn from
+    std::chrono::nanoseconds period() const;
+    //a new mode may have another refresh rate
+    void reset();
+
+private:
+    std::chrono::nanoseconds learned{0};
+    std::chrono::nanoseconds last_long_interval{0};
+    unsigned int long_intervals{0};
+};
+
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_ANDROID_VSYNC_PERIOD_H_ */
@@ -0,0 +1,75 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "vsync_queue.h"
+
+namespace mga = mir::graphics::android;
+
+size_t const mga::VsyncQueue::capacity;
+
+mga::VsyncQueue::VsyncQueue()
+{
+    for (auto i = 0u; i != capacity; i++)
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+/* Pushers claim a position by moving the tail on, and publish the vsync in the slot
+ * with its sequence. The slot is free while its sequence is the position claimed. */
+bool mga::VsyncQueue::push(Vsync const& vsync) noexcept
+{
+    auto position = tail.load(std::memory_order_relaxed);
+    while (true)
+    {
+        auto& slot = slots[position % capacity];
+        auto const sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == position)
+        {
+            if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                slot.vsync = vsync;
+                slot.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (sequence < position)
+        {
+            //the slot still holds the vsync from a lap ago
+            return false;
+        }
+        else
+        {
+            position = tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool mga::VsyncQueue::pop(Vsync& vsync) noexcept
+{
+    auto const position = head.load(std::memory_order_relaxed);
+    auto& slot = slots[position % capacity];
+    if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+        return false;
+
+    vsync = slot.vsync;
+    slot.sequence.store(position + capacity, std::memory_order_release);
+    head.store(position + 1, std::memory_order_relaxed);
+    return true;
+}
+
+uint64_t mga::VsyncQueue::pushed() const noexcept
+{
+    return tail.load(std::memory_order_acquire);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_ANDROID_VSYNC_QUEUE_H_
+#define MIR_GRAPHICS_ANDROID_VSYNC_QUEUE_H_
+
+#include "mir/graphics/frame.h"
+#include "display_name.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace mir
+{
+namespace graphics
+{
+namespace android
+{
+
+//Passes vsyncs from the threads the hwc delivers them on to the thread that hands them out,
+//without locks. The hwc may deliver the vsyncs of each display on a thread of its own, so any
+//number of threads can push, but only one thread pops. Vsyncs that do not fit are dropped.
+class VsyncQueue
+{
+public:
+    struct Vsync
+    {
+        DisplayName name;
+        Frame::Timestamp timestamp;
+    };
+
+    VsyncQueue();
+
+    bool push(Vsync const& vsync) noexcept;
+    bool pop(Vsync& vsync) noexcept;
+    //the number of vsyncs pushed so far, including those still being written
+    uint64_t pushed() const noexcept;
+
+private:
+    VsyncQueue(VsyncQueue const&) = delete;
+    VsyncQueue& operator=(VsyncQueue const&) = delete;
+
+    //a slot holds a vsync once its sequence is one past the position it was claimed for
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence;
+        Vsync vsync;
+    };
+    static size_t const capacity{16};
+    std::array<Slot, capacity> slots;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+};
+
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_ANDROID_VSYNC_QUEUE_H_ */
@@ -49,6 +49,8 @@ public:
         graphics::RenderableList const&));
     MOCK_CONST_METHOD0(recommended_sleep, std::chrono::milliseconds());
     MOCK_CONST_METHOD0(can_swap_buffers, bool());
+    MOCK_METHOD1(subscribe_to_presentation, void(
+        std::function<void(graphics::android::DisplayName, graphics::Frame::Timestamp)> const&));
 };
 }
 }
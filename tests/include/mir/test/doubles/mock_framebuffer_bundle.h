@@ -48,6 +48,8 @@ struct MockFBBundle : public graphics::android::FramebufferBundle
     MOCK_METHOD0(fb_size, geometry::Size());
     MOCK_METHOD0(buffer_for_render, std::shared_ptr<graphics::Buffer>());
     MOCK_METHOD0(last_rendered_buffer, std::shared_ptr<graphics::Buffer>());
+    MOCK_METHOD0(buffer_age, unsigned int());
+    MOCK_METHOD1(set_triple_buffering, void(bool));
 };
 }
 }
@@ -98,6 +98,7 @@ public:
     MOCK_METHOD9(glTexImage2D,
                  void(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum,
                       GLenum,const GLvoid*));
+    MOCK_METHOD4(glScissor, void(GLint, GLint, GLsizei, GLsizei));
     MOCK_METHOD3(glTexParameteri, void(GLenum, GLenum, GLenum));
     MOCK_METHOD2(glUniform1f, void(GLint, GLfloat));
     MOCK_METHOD3(glUniform2f, void(GLint, GLfloat, GLfloat));
@@ -47,6 +47,8 @@ public:
         blank = hook_blank;
         getDisplayConfigs = hook_getDisplayConfigs;
         getDisplayAttributes = hook_getDisplayAttributes;
+        setCursorPositionAsync = hook_setCursorPositionAsync;
+        setActiveConfig = hook_setActiveConfig;
     }
 
     static void hook_registerProcs(struct hwc_composer_device_1* mock_hwc, hwc_procs_t const* procs)
@@ -87,6 +89,18 @@ public:
         return mocker->getDisplayAttributes_interface(mock_hwc, disp, config, attributes, values);
     }
 
+    static int hook_setCursorPositionAsync(struct hwc_composer_device_1* mock_hwc, int disp, int x_pos, int y_pos)
+    {
+        MockHWCComposerDevice1* mocker = static_cast<MockHWCComposerDevice1*>(mock_hwc);
+        return mocker->setCursorPositionAsync_interface(mock_hwc, disp, x_pos, y_pos);
+    }
+
+    static int hook_setActiveConfig(struct hwc_composer_device_1* mock_hwc, int disp, int index)
+    {
+        MockHWCComposerDevice1* mocker = static_cast<MockHWCComposerDevice1*>(mock_hwc);
+        return mocker->setActiveConfig_interface(mock_hwc, disp, index);
+    }
+
     MOCK_METHOD2(registerProcs_interface, void(struct hwc_composer_device_1*, hwc_procs_t const*));
     MOCK_METHOD4(eventControl_interface, int(struct hwc_composer_device_1* dev, int disp, int event, int enabled));
     MOCK_METHOD3(set_interface, int(struct hwc_composer_device_1 *, size_t, hwc_display_contents_1_t**));
@@ -94,6 +108,8 @@ public:
     MOCK_METHOD3(blank_interface, int(struct hwc_composer_device_1 *, int, int));
     MOCK_METHOD4(getDisplayConfigs_interface, int(struct hwc_composer_device_1*, int, uint32_t*, size_t*));
     MOCK_METHOD5(getDisplayAttributes_interface, int(struct hwc_composer_device_1*, int, uint32_t, const uint32_t*, int32_t*));
+    MOCK_METHOD4(setCursorPositionAsync_interface, int(struct hwc_composer_device_1*, int, int, int));
+    MOCK_METHOD3(setActiveConfig_interface, int(struct hwc_composer_device_1*, int, int));
 };
 
 }
@@ -61,6 +61,7 @@ struct MockHWCDeviceWrapper : public graphics::android::HwcWrapper
     MOCK_CONST_METHOD1(has_active_config, bool(graphics::android::DisplayName));
     MOCK_CONST_METHOD1(active_config_for, graphics::android::ConfigId(graphics::android::DisplayName));
     MOCK_CONST_METHOD2(set_active_config, void(graphics::android::DisplayName name, graphics::android::ConfigId id));
+    MOCK_CONST_METHOD2(set_cursor_position, bool(graphics::android::DisplayName, geometry::Point));
 
 };
 
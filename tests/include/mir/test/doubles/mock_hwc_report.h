@@ -38,6 +38,8 @@ struct MockHwcReport : public graphics::android::HwcReport
         void(std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& displays));
     MOCK_CONST_METHOD1(report_set_done,
         void(std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& displays)); 
+    MOCK_CONST_METHOD0(report_prepare_skipped, void());
+    MOCK_CONST_METHOD0(report_frame_elided, void());
     MOCK_CONST_METHOD1(report_overlay_optimization, void(graphics::android::OverlayOptimization));
     MOCK_CONST_METHOD0(report_display_on, void());
     MOCK_CONST_METHOD0(report_display_off, void());
@@ -46,6 +48,10 @@ struct MockHwcReport : public graphics::android::HwcReport
     MOCK_CONST_METHOD1(report_hwc_version, void(graphics::android::HwcVersion));
     MOCK_CONST_METHOD0(report_legacy_fb_module, void());
     MOCK_CONST_METHOD1(report_power_mode, void(graphics::android::PowerMode));
+    MOCK_CONST_METHOD4(report_missed_deadline, void(graphics::android::DisplayName,
+        graphics::android::FrameOutcome, graphics::android::FrameStage, std::chrono::nanoseconds));
+    MOCK_CONST_METHOD2(report_frame_histogram, void(graphics::android::DisplayName,
+        graphics::android::FrameHistogram const&));
 };
 }
 }
@@ -31,8 +31,9 @@ namespace doubles
 
 struct MockRenderableListCompositor : public graphics::android::RenderableListCompositor
 {
-    MOCK_CONST_METHOD3(render,
-        void(graphics::RenderableList const&, geometry::Displacement, graphics::android::SwappingGLContext const&));
+    MOCK_CONST_METHOD4(render,
+        void(graphics::RenderableList const&, geometry::Displacement,
+             std::vector<geometry::Rectangle> const&, graphics::android::SwappingGLContext const&));
 };
 
 }
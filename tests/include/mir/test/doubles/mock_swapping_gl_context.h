@@ -31,9 +31,12 @@ namespace doubles
 struct MockSwappingGLContext : public graphics::android::SwappingGLContext
 {
     MOCK_CONST_METHOD0(swap_buffers, void());
+    MOCK_CONST_METHOD1(swap_buffers_with_damage, void(geometry::Rectangle const&));
+    MOCK_CONST_METHOD0(buffer_age, unsigned int());
     MOCK_CONST_METHOD0(make_current, void());
     MOCK_CONST_METHOD0(release_current, void());
     MOCK_CONST_METHOD0(last_rendered_buffer, std::shared_ptr<graphics::Buffer>());
+    MOCK_CONST_METHOD1(set_triple_buffering, void(bool));
 };
 
 }
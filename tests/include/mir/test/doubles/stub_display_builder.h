@@ -39,6 +39,8 @@ struct StubFramebufferBundle : public graphics::android::FramebufferBundle
     geometry::Size fb_size() override { return {33, 34}; }
     std::shared_ptr<graphics::Buffer> buffer_for_render() { return nullptr; }
     std::shared_ptr<graphics::Buffer> last_rendered_buffer() { return nullptr; }
+    unsigned int buffer_age() override { return 0; }
+    void set_triple_buffering(bool) override {}
 };
 
 struct MockHwcConfiguration : public graphics::android::HwcConfiguration
@@ -55,9 +57,11 @@ struct MockHwcConfiguration : public graphics::android::HwcConfiguration
     }
     MOCK_METHOD2(power_mode, void(graphics::android::DisplayName, MirPowerMode));
     MOCK_METHOD1(active_config_for, graphics::DisplayConfigurationOutput(graphics::android::DisplayName));
+    MOCK_METHOD2(set_active_mode, void(graphics::android::DisplayName, size_t));
     MOCK_METHOD2(subscribe_to_config_changes,
         graphics::android::ConfigChangeSubscription(
             std::function<void()> const&, std::function<void(graphics::android::DisplayName, mir::graphics::Frame::Timestamp)> const&));
+    MOCK_METHOD2(request_vsync, void(graphics::android::DisplayName, unsigned int));
 };
 
 struct StubHwcConfiguration : public graphics::android::HwcConfiguration
@@ -73,6 +77,10 @@ struct StubHwcConfiguration : public graphics::android::HwcConfiguration
         config.id = as_output_id(name);
         return config;
     }
+
+    void set_active_mode(graphics::android::DisplayName, size_t) override
+    {
+    }
     
     graphics::android::ConfigChangeSubscription subscribe_to_config_changes(
         std::function<void()> const&,
@@ -82,6 +90,10 @@ struct StubHwcConfiguration : public graphics::android::HwcConfiguration
     {
         return nullptr;
     }
+
+    void request_vsync(graphics::android::DisplayName, unsigned int) override
+    {
+    }
 };
 
 struct StubDisplayBuilder : public graphics::android::DisplayComponentFactory
@@ -109,6 +121,11 @@ struct StubDisplayBuilder : public graphics::android::DisplayComponentFactory
                 std::make_shared<graphics::android::IntegerSourceCrop>(), {}, geometry::Displacement{0,0}));
     }
 
+    std::shared_ptr<graphics::android::HwcCursor> create_cursor()
+    {
+        return nullptr;
+    }
+
     std::unique_ptr<graphics::android::FramebufferBundle> create_framebuffers(graphics::DisplayConfigurationOutput const&) override
     {
         return std::unique_ptr<graphics::android::FramebufferBundle>(new StubFramebufferBundle());
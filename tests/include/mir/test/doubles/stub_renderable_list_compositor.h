@@ -33,6 +33,7 @@ struct StubRenderableListCompositor : public graphics::android::RenderableListCo
     void render(
         graphics::RenderableList const&,
         geometry::Displacement,
+        std::vector<geometry::Rectangle> const&,
         graphics::android::SwappingGLContext const&) const
     {
     }
@@ -43,10 +43,13 @@ struct StubSwappingGLContext : public graphics::android::SwappingGLContext
     void make_current() const {}
     void release_current() const {}
     void swap_buffers() const {}
+    void swap_buffers_with_damage(geometry::Rectangle const&) const {}
+    unsigned int buffer_age() const { return 0; }
     std::shared_ptr<graphics::Buffer> last_rendered_buffer() const
     {
         return buffer;
     }
+    void set_triple_buffering(bool) const {}
 private:
     std::shared_ptr<graphics::Buffer> const buffer;
 };
@@ -441,6 +441,12 @@ void glRenderbufferStorage(GLenum target, GLenum internalformat,
                                           width, height);
 }
 
+void glScissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    CHECK_GLOBAL_VOID_MOCK();
+    global_mock_gl->glScissor(x, y, width, height);
+}
+
 void glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
 {
     CHECK_GLOBAL_VOID_MOCK();
@@ -41,6 +41,7 @@
 #include <memory>
 #include <stdexcept>
 #include <unordered_set>
+#include <vector>
 #include <algorithm>
 
 namespace mg=mir::graphics;
@@ -623,6 +624,93 @@ TEST_F(Display, can_configure_orientation)
     });
 }
 
+TEST_F(Display, switches_the_hwc_to_the_mode_chosen)
+{
+    using namespace testing;
+    geom::Size pixel_size{344, 111};
+    stub_db_factory->with_next_config([&](mtd::MockHwcConfiguration& mock_config)
+    {
+        mg::DisplayConfigurationOutput output = mtd::StubDisplayConfigurationOutput{
+            pixel_size, {4230, 2229}, mir_pixel_format_abgr_8888, 60.0, true};
+        output.modes.push_back(mg::DisplayConfigurationMode{pixel_size, 30.0});
+        ON_CALL(mock_config, active_config_for(mga::DisplayName::primary))
+            .WillByDefault(Return(output));
+        EXPECT_CALL(mock_config, set_active_mode(mga::DisplayName::primary, 1));
+    });
+
+    mga::Display display(
+        stub_db_factory,
+        stub_gl_program_factory,
+        stub_gl_config,
+        null_display_report,
+        null_anw_report,
+        mga::OverlayOptimization::enabled);
+
+    auto config = display.configuration();
+    config->for_each_output([](mg::UserDisplayConfigurationOutput const& c){
+        if (c.id == primary_output_id)
+            c.current_mode_index = 1;
+    });
+    display.configure(*config);
+
+    config = display.configuration();
+    config->for_each_output([](mg::UserDisplayConfigurationOutput const& c){
+        if (c.id == primary_output_id)
+            EXPECT_THAT(c.current_mode_index, Eq(1u));
+    });
+}
+
+TEST_F(Display, replaces_the_display_buffer_with_one_of_the_size_of_the_mode_chosen)
+{
+    using namespace testing;
+    geom::Size pixel_size{344, 111};
+    geom::Size other_pixel_size{172, 55};
+    stub_db_factory->with_next_config([&](mtd::MockHwcConfiguration& mock_config)
+    {
+        mg::DisplayConfigurationOutput output = mtd::StubDisplayConfigurationOutput{
+            pixel_size, {4230, 2229}, mir_pixel_format_abgr_8888, 60.0, true};
+        output.modes.push_back(mg::DisplayConfigurationMode{other_pixel_size, 60.0});
+        ON_CALL(mock_config, active_config_for(mga::DisplayName::primary))
+            .WillByDefault(Return(output));
+    });
+
+    mga::Display display(
+        stub_db_factory,
+        stub_gl_program_factory,
+        stub_gl_config,
+        null_display_report,
+        null_anw_report,
+        mga::OverlayOptimization::enabled);
+
+    std::vector<mg::DisplayBuffer*> buffers;
+    auto const collect_buffers = [&]
+    {
+        buffers.clear();
+        display.for_each_display_sync_group([&](mg::DisplaySyncGroup& group) {
+            group.for_each_display_buffer([&](mg::DisplayBuffer& db) {
+                buffers.push_back(&db);
+            });
+        });
+    };
+
+    collect_buffers();
+    ASSERT_THAT(buffers.size(), Eq(1u));
+    auto const original_buffer = buffers[0];
+    EXPECT_THAT(original_buffer->view_area().size, Eq(pixel_size));
+
+    auto config = display.configuration();
+    config->for_each_output([](mg::UserDisplayConfigurationOutput const& c){
+        if (c.id == primary_output_id)
+            c.current_mode_index = 1;
+    });
+    display.configure(*config);
+
+    collect_buffers();
+    ASSERT_THAT(buffers.size(), Eq(1u));
+    EXPECT_THAT(buffers[0], Ne(original_buffer));
+    EXPECT_THAT(buffers[0]->view_area().size, Eq(other_pixel_size));
+}
+
 TEST_F(Display, can_configure_form_factor)
 {
     mga::Display display(
@@ -930,6 +1018,83 @@ TEST_F(Display, reports_vsync)
     vsync_fn(mga::DisplayName::primary, {});
 }
 
+TEST_F(Display, counts_the_frames_that_went_by_while_vsync_was_off)
+{
+    using namespace testing;
+    using namespace std::chrono;
+    std::function<void(mga::DisplayName, mg::Frame::Timestamp)> vsync_fn = [](mga::DisplayName, mg::Frame::Timestamp){};
+    stub_db_factory->with_next_config([&](mtd::MockHwcConfiguration& mock_config)
+    {
+        EXPECT_CALL(mock_config, subscribe_to_config_changes(_,_))
+            .WillOnce(DoAll(SaveArg<1>(&vsync_fn), Return(std::make_shared<char>('2'))));
+    });
+
+    mga::Display display(
+        stub_db_factory,
+        stub_gl_program_factory,
+        stub_gl_config,
+        null_display_report,
+        null_anw_report,
+        mga::OverlayOptimization::enabled);
+
+    auto const now = mg::Frame::Timestamp::now(CLOCK_MONOTONIC);
+    vsync_fn(mga::DisplayName::primary, mg::Frame::Timestamp{CLOCK_MONOTONIC, now.nanoseconds - milliseconds{80}});
+    vsync_fn(mga::DisplayName::primary, mg::Frame::Timestamp{CLOCK_MONOTONIC, now.nanoseconds - milliseconds{64}});
+    vsync_fn(mga::DisplayName::primary, now);
+
+    auto const frame = display.last_frame_on(primary_output_id.as_value());
+    EXPECT_THAT(frame.msc, Eq(6));
+    EXPECT_THAT(frame.ust.nanoseconds, Eq(now.nanoseconds));
+}
+
+TEST_F(Display, learns_the_vsync_period_again_after_a_change_of_mode)
+{
+    using namespace testing;
+    using namespace std::chrono;
+    geom::Size pixel_size{344, 111};
+    std::function<void(mga::DisplayName, mg::Frame::Timestamp)> vsync_fn = [](mga::DisplayName, mg::Frame::Timestamp){};
+    stub_db_factory->with_next_config([&](mtd::MockHwcConfiguration& mock_config)
+    {
+        mg::DisplayConfigurationOutput output = mtd::StubDisplayConfigurationOutput{
+            pixel_size, {4230, 2229}, mir_pixel_format_abgr_8888, 60.0, true};
+        output.modes.push_back(mg::DisplayConfigurationMode{pixel_size, 30.0});
+        ON_CALL(mock_config, active_config_for(mga::DisplayName::primary))
+            .WillByDefault(Return(output));
+        EXPECT_CALL(mock_config, subscribe_to_config_changes(_,_))
+            .WillOnce(DoAll(SaveArg<1>(&vsync_fn), Return(std::make_shared<char>('2'))));
+    });
+
+    mga::Display display(
+        stub_db_factory,
+        stub_gl_program_factory,
+        stub_gl_config,
+        null_display_report,
+        null_anw_report,
+        mga::OverlayOptimization::enabled);
+
+    auto const start = mg::Frame::Timestamp::now(CLOCK_MONOTONIC).nanoseconds;
+    auto const vsync_at = [&](milliseconds time)
+    {
+        vsync_fn(mga::DisplayName::primary, mg::Frame::Timestamp{CLOCK_MONOTONIC, start + time});
+    };
+    vsync_at(milliseconds{0});
+    vsync_at(milliseconds{16});
+    vsync_at(milliseconds{32});
+
+    auto config = display.configuration();
+    config->for_each_output([](mg::UserDisplayConfigurationOutput const& c){
+        if (c.id == primary_output_id)
+            c.current_mode_index = 1;
+    });
+    display.configure(*config);
+
+    vsync_at(milliseconds{65});
+    vsync_at(milliseconds{98});
+
+    auto const frame = display.last_frame_on(primary_output_id.as_value());
+    EXPECT_THAT(frame.msc, Eq(5));
+}
+
 TEST_F(Display, can_configure_positioning_of_dbs)
 {
     using namespace testing;
@@ -1165,3 +1330,34 @@ TEST_F(Display, does_not_invalidate_display_buffers_when_it_promised_not_to)
         EXPECT_THAT(db->transformation(), AnyOf(Eq(rotate_inverted), Eq(rotate_none)));
     }
 }
+
+TEST_F(Display, gives_displays_with_different_refresh_rates_sync_groups_of_their_own)
+{
+    using namespace testing;
+    stub_db_factory->with_next_config([&](mtd::MockHwcConfiguration& mock_config)
+    {
+        ON_CALL(mock_config, active_config_for(mga::DisplayName::primary))
+            .WillByDefault(Return(mtd::StubDisplayConfigurationOutput{
+                primary_output_id, {20,20}, {4,4}, mir_pixel_format_abgr_8888, 60.0f, true}));
+        ON_CALL(mock_config, active_config_for(mga::DisplayName::external))
+            .WillByDefault(Return(mtd::StubDisplayConfigurationOutput{
+                external_output_id, {20,20}, {4,4}, mir_pixel_format_abgr_8888, 30.0f, true}));
+    });
+
+    mga::Display display(
+        stub_db_factory,
+        stub_gl_program_factory,
+        stub_gl_config,
+        null_display_report,
+        null_anw_report,
+        mga::OverlayOptimization::enabled);
+
+    auto group_count = 0;
+    auto db_count = 0;
+    display.for_each_display_sync_group([&](mg::DisplaySyncGroup& group) {
+        group_count++;
+        group.for_each_display_buffer([&](mg::DisplayBuffer&) {db_count++;});
+    });
+    EXPECT_THAT(group_count, Eq(2));
+    EXPECT_THAT(db_count, Eq(2));
+}
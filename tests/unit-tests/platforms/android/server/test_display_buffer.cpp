@@ -110,7 +110,7 @@ TEST_F(DisplayBuffer, posts_overlay_list_returns_display_device_decision)
             std::make_shared<mtd::StubBuffer>(std::make_shared<mtd::StubAndroidNativeBuffer>()))
     };
 
-    EXPECT_CALL(*mock_display_device, compatible_renderlist(Ref(renderlist)))
+    EXPECT_CALL(*mock_display_device, compatible_renderlist(Eq(renderlist)))
         .Times(2)
         .WillOnce(Return(true))
         .WillOnce(Return(false));
@@ -277,16 +277,34 @@ TEST_F(DisplayBuffer, swaps_when_allowed)
     db.swap_buffers();
 }
 
+//a dozing display still shows its content
 TEST_F(DisplayBuffer, notifies_list_that_content_is_cleared)
 {
     EXPECT_CALL(*mock_display_device, content_cleared())
-        .Times(3);
+        .Times(1);
     db.configure(mir_power_mode_off, {}, area);
     db.configure(mir_power_mode_suspend, {}, area);
     db.configure(mir_power_mode_standby, {}, area);
     db.configure(mir_power_mode_on, {}, area);
 }
 
+TEST_F(DisplayBuffer, does_not_submit_renderables_hidden_by_opaque_renderables)
+{
+    using namespace testing;
+    auto hidden = std::make_shared<mtd::StubRenderable>(
+        std::make_shared<mtd::StubBuffer>(std::make_shared<mtd::StubAndroidNativeBuffer>()),
+        geom::Rectangle{{10, 10}, {10, 10}});
+    auto fullscreen = std::make_shared<mtd::StubRenderable>(
+        std::make_shared<mtd::StubBuffer>(std::make_shared<mtd::StubAndroidNativeBuffer>()), area);
+    mg::RenderableList const visible{fullscreen};
+
+    EXPECT_CALL(*mock_display_device, compatible_renderlist(Eq(visible)))
+        .WillOnce(Return(true));
+
+    EXPECT_TRUE(db.overlay({hidden, fullscreen}));
+    EXPECT_THAT(std::distance(db.contents().list.begin(), db.contents().list.end()), Eq(2));
+}
+
 TEST_F(DisplayBuffer, reject_list_if_option_disabled)
 {
     using namespace testing;
@@ -361,8 +379,7 @@ TEST_F(DisplayBuffer, reports_position_correctly)
     EXPECT_THAT(db.view_area().top_left, Eq(offset_top_left_point));
 }
 
-//lp: #1485070. Could alternitvely rotate all the renderables, once rotation is supported
-TEST_F(DisplayBuffer, rejects_lists_if_db_is_rotated)
+TEST_F(DisplayBuffer, accepts_lists_if_db_is_rotated)
 {
     ON_CALL(*mock_display_device, compatible_renderlist(testing::_))
         .WillByDefault(testing::Return(true));
@@ -373,7 +390,20 @@ TEST_F(DisplayBuffer, rejects_lists_if_db_is_rotated)
             std::make_shared<mtd::StubBuffer>(std::make_shared<mtd::StubAndroidNativeBuffer>()))};
 
     db.configure(mir_power_mode_on, rotate_inverted, area);
-    EXPECT_FALSE(db.overlay(renderlist));
+    EXPECT_TRUE(db.overlay(renderlist));
     db.configure(mir_power_mode_on, rotate_none, area);
     EXPECT_TRUE(db.overlay(renderlist));
 }
+
+TEST_F(DisplayBuffer, rejects_lists_if_db_transform_is_not_a_right_angle)
+{
+    ON_CALL(*mock_display_device, compatible_renderlist(testing::_))
+        .WillByDefault(testing::Return(true));
+    mg::RenderableList const renderlist{
+        std::make_shared<mtd::StubRenderable>(
+            std::make_shared<mtd::StubBuffer>(std::make_shared<mtd::StubAndroidNativeBuffer>()))};
+    glm::mat2 const skewed(1, 0.5, 0, 1);
+
+    db.configure(mir_power_mode_on, skewed, area);
+    EXPECT_FALSE(db.overlay(renderlist));
+}
@@ -24,6 +24,8 @@
 #include "mir/test/doubles/stub_swapping_gl_context.h"
 #include "mir/test/fake_shared.h"
 #include <memory>
+#include <thread>
+#include <time.h>
 
 namespace mg=mir::graphics;
 namespace mga=mir::graphics::android;
@@ -38,17 +40,33 @@ struct StubConfigurableDB : mga::ConfigurableDisplayBuffer, mg::NativeDisplayBuf
     bool overlay(mg::RenderableList const&) override { return false; }
     glm::mat2 transformation() const override { return {}; }
     mg::NativeDisplayBuffer* native_display_buffer() override { return this; }
-    void configure(MirPowerMode, glm::mat2 const&, mir::geometry::Rectangle const&) override {}
+    void configure(MirPowerMode mode, glm::mat2 const&, mir::geometry::Rectangle const&) override { power = mode; }
     mga::DisplayContents contents() override
     {
         return mga::DisplayContents{mga::DisplayName::primary, list, offset, context, compositor};
     }
-    MirPowerMode power_mode() const override { return mir_power_mode_on; }
+    MirPowerMode power_mode() const override { return power; }
+    MirPowerMode power{mir_power_mode_on};
     mtd::StubRenderableListCompositor mutable compositor;
     mtd::StubSwappingGLContext mutable context;
     mir::geometry::Displacement offset { 0, 0 };
     mga::LayerList mutable list{std::make_shared<mga::IntegerSourceCrop>(), {}, offset};
 };
+
+mg::Frame vsync_frame(int64_t msc, std::chrono::nanoseconds ust)
+{
+    mg::Frame frame;
+    frame.msc = msc;
+    frame.ust = mg::Frame::Timestamp{CLOCK_MONOTONIC, ust};
+    return frame;
+}
+
+std::chrono::nanoseconds monotonic_now()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return std::chrono::seconds{now.tv_sec} + std::chrono::nanoseconds{now.tv_nsec};
+}
 }
 
 TEST(DisplayGroup, db_additions_and_removals)
@@ -115,3 +133,187 @@ TEST(DisplayGroup, calls_error_handler_on_external_display_error)
     EXPECT_NO_THROW({group.post();});
     EXPECT_TRUE(error_handler_called);
 }
+
+TEST(DisplayGroup, is_one_sync_group_unless_the_displays_have_independent_cadence)
+{
+    using namespace testing;
+    NiceMock<mtd::MockDisplayDevice> mock_device;
+    mga::DisplayGroup group(mt::fake_shared(mock_device), std::make_unique<StubConfigurableDB>());
+    group.add(mga::DisplayName::external, std::make_unique<StubConfigurableDB>());
+
+    std::vector<mg::DisplaySyncGroup*> sync_groups;
+    auto const collect = [&](mg::DisplaySyncGroup& sync_group) { sync_groups.push_back(&sync_group); };
+    group.for_each_sync_group(collect);
+    ASSERT_THAT(sync_groups, ElementsAre(&group));
+
+    sync_groups.clear();
+    group.set_independent_cadence(true);
+    group.for_each_sync_group(collect);
+    ASSERT_THAT(sync_groups.size(), Eq(2u));
+
+    EXPECT_CALL(mock_device, commit(SizeIs(1)))
+        .Times(2);
+    for (auto sync_group : sync_groups)
+    {
+        int buffers{0};
+        sync_group->for_each_display_buffer([&](mg::DisplayBuffer&) { buffers++; });
+        EXPECT_THAT(buffers, Eq(1));
+        sync_group->post();
+    }
+}
+
+TEST(DisplayGroup, keeps_a_sync_group_handed_out_alive_when_its_display_is_removed)
+{
+    using namespace testing;
+    NiceMock<mtd::MockDisplayDevice> mock_device;
+    mga::DisplayGroup group(mt::fake_shared(mock_device), std::make_unique<StubConfigurableDB>());
+    group.add(mga::DisplayName::external, std::make_unique<StubConfigurableDB>());
+    group.set_independent_cadence(true);
+
+    int sync_groups{0};
+    int buffers{0};
+    group.for_each_sync_group([&](mg::DisplaySyncGroup& sync_group)
+    {
+        if (sync_groups++ == 0)
+            group.remove(mga::DisplayName::external);
+        sync_group.for_each_display_buffer([&](mg::DisplayBuffer&) { buffers++; });
+    });
+
+    EXPECT_THAT(sync_groups, Eq(2));
+    EXPECT_THAT(buffers, Eq(1));
+}
+
+TEST(DisplayGroup, display_with_independent_cadence_posts_once_per_vsync)
+{
+    using namespace testing;
+    NiceMock<mtd::MockDisplayDevice> mock_device;
+    mga::DisplayGroup group(mt::fake_shared(mock_device), std::make_unique<StubConfigurableDB>());
+    group.set_independent_cadence(true);
+    mg::DisplaySyncGroup* primary{nullptr};
+    group.for_each_sync_group([&](mg::DisplaySyncGroup& sync_group) { primary = &sync_group; });
+    ASSERT_THAT(primary, Ne(nullptr));
+
+    group.on_vsync(mga::DisplayName::primary, vsync_frame(1, monotonic_now()));
+    primary->post();
+
+    std::thread vsync([&]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        group.on_vsync(mga::DisplayName::primary, vsync_frame(2, monotonic_now()));
+    });
+    auto const start = std::chrono::steady_clock::now();
+    primary->post();
+    vsync.join();
+
+    EXPECT_THAT(std::chrono::steady_clock::now() - start, Ge(std::chrono::milliseconds{10}));
+}
+
+TEST(DisplayGroup, recommends_the_device_sleep_until_the_vsync_rate_is_known)
+{
+    using namespace testing;
+    NiceMock<mtd::MockDisplayDevice> mock_device;
+    ON_CALL(mock_device, recommended_sleep())
+        .WillByDefault(Return(std::chrono::milliseconds{7}));
+    mga::DisplayGroup group(mt::fake_shared(mock_device), std::make_unique<StubConfigurableDB>());
+
+    group.for_each_display_buffer([](mg::DisplayBuffer&) {});
+    group.post();
+
+    EXPECT_THAT(group.recommended_sleep(), Eq(std::chrono::milliseconds{7}));
+}
+
+TEST(DisplayGroup, starts_the_next_frame_as_late_as_it_can_to_make_the_vsync_after_next)
+{
+    using namespace testing;
+    using namespace std::chrono;
+    NiceMock<mtd::MockDisplayDevice> mock_device;
+    mga::DisplayGroup group(mt::fake_shared(mock_device), std::make_unique<StubConfigurableDB>());
+
+    auto const now = monotonic_now();
+    group.on_vsync(mga::DisplayName::primary, vsync_frame(1, now - milliseconds{32}));
+    group.on_vsync(mga::DisplayName::primary, vsync_frame(3, now));
+
+    group.for_each_display_buffer([](mg::DisplayBuffer&) {});
+    group.post();
+
+    //the frame just posted is due 16ms from now, and the next one 32ms from now, less a margin
+    auto const sleep = group.recommended_sleep();
+    EXPECT_THAT(sleep, Le(milliseconds{30}));
+    EXPECT_THAT(sleep, Ge(milliseconds{20}));
+}
+
+TEST(DisplayGroup, requests_vsync_for_the_displays_it_posts)
+{
+    using namespace testing;
+    NiceMock<mtd::MockDisplayDevice> mock_device;
+    std::vector<mga::DisplayName> requested;
+    mga::DisplayGroup group(mt::fake_shared(mock_device), std::make_unique<StubConfigurableDB>(), []{},
+        [&](mga::DisplayName name, unsigned int frames)
+        {
+            EXPECT_THAT(frames, Ge(1u));
+            requested.push_back(name);
+        });
+    group.add(mga::DisplayName::external, std::make_unique<StubConfigurableDB>());
+
+    group.post();
+    EXPECT_THAT(requested, ElementsAre(mga::DisplayName::primary, mga::DisplayName::external));
+
+    requested.clear();
+    group.set_independent_cadence(true);
+    group.for_each_sync_group([](mg::DisplaySyncGroup& sync_group)
+    {
+        sync_group.post();
+    });
+    EXPECT_THAT(requested, UnorderedElementsAre(mga::DisplayName::primary, mga::DisplayName::external));
+}
+
+TEST(DisplayGroup, dozes_without_vsync_at_a_low_rate)
+{
+    using namespace testing;
+    NiceMock<mtd::MockDisplayDevice> mock_device;
+    std::vector<mga::DisplayName> requested;
+    mga::DisplayGroup group(mt::fake_shared(mock_device), std::make_unique<StubConfigurableDB>(), []{},
+        [&](mga::DisplayName name, unsigned int) { requested.push_back(name); });
+    group.configure(mga::DisplayName::primary, mir_power_mode_standby, glm::mat2{1}, {});
+
+    EXPECT_CALL(mock_device, commit(SizeIs(1)));
+    int buffers{0};
+    group.for_each_display_buffer([&](mg::DisplayBuffer&) { buffers++; });
+    group.post();
+
+    EXPECT_THAT(buffers, Eq(1));
+    EXPECT_THAT(requested, IsEmpty());
+    EXPECT_THAT(group.recommended_sleep(), Eq(std::chrono::milliseconds{100}));
+}
+
+TEST(DisplayGroup, leaves_displays_in_doze_suspend_as_they_are)
+{
+    using namespace testing;
+    NiceMock<mtd::MockDisplayDevice> mock_device;
+    mga::DisplayGroup group(mt::fake_shared(mock_device), std::make_unique<StubConfigurableDB>());
+    group.add(mga::DisplayName::external, std::make_unique<StubConfigurableDB>());
+    group.configure(mga::DisplayName::external, mir_power_mode_suspend, glm::mat2{1}, {});
+
+    EXPECT_CALL(mock_device, commit(SizeIs(1)));
+    int buffers{0};
+    group.for_each_display_buffer([&](mg::DisplayBuffer&) { buffers++; });
+    group.post();
+    EXPECT_THAT(buffers, Eq(1));
+
+    //the display that is on paces the group
+    ON_CALL(mock_device, recommended_sleep())
+        .WillByDefault(Return(std::chrono::milliseconds{0}));
+    EXPECT_THAT(group.recommended_sleep(), Lt(std::chrono::milliseconds{50}));
+}
+
+TEST(DisplayGroup, commits_when_every_display_is_in_doze_suspend)
+{
+    using namespace testing;
+    NiceMock<mtd::MockDisplayDevice> mock_device;
+    mga::DisplayGroup group(mt::fake_shared(mock_device), std::make_unique<StubConfigurableDB>());
+    group.configure(mga::DisplayName::primary, mir_power_mode_suspend, glm::mat2{1}, {});
+
+    //the device sets the last lists of the displays that were left out
+    EXPECT_CALL(mock_device, commit(IsEmpty()));
+    group.post();
+}
@@ -48,12 +48,14 @@ struct DisplayHotplug : ::testing::Test
         {
             return mtd::StubDisplayConfig({{true,true}}).outputs[0];
         } 
+        void set_active_mode(mga::DisplayName, size_t) override {}
         mga::ConfigChangeSubscription subscribe_to_config_changes(
             std::function<void()> const& cb, std::function<void(mga::DisplayName, mg::Frame::Timestamp)> const&) override
         {
             hotplug_fn = cb;
             return {};
         }
+        void request_vsync(mga::DisplayName, unsigned int) override {}
         void simulate_hotplug()
         {
             hotplug_fn();
@@ -73,11 +75,19 @@ struct DisplayHotplug : ::testing::Test
         {
             return wrapped.active_config_for(d);
         } 
+        void set_active_mode(mga::DisplayName d, size_t mode_index) override
+        {
+            wrapped.set_active_mode(d, mode_index);
+        }
         mga::ConfigChangeSubscription subscribe_to_config_changes(
             std::function<void()> const& hotplug, std::function<void(mga::DisplayName, mg::Frame::Timestamp)> const& vsync) override
         {
             return wrapped.subscribe_to_config_changes(hotplug, vsync);
         }
+        void request_vsync(mga::DisplayName d, unsigned int frames) override
+        {
+            wrapped.request_vsync(d, frames);
+        }
         mga::HwcConfiguration& wrapped;
     };
 
@@ -104,6 +114,11 @@ struct DisplayHotplug : ::testing::Test
                 new mga::LayerList(std::make_shared<mga::IntegerSourceCrop>(), {}, geom::Displacement{}));
         }
 
+        std::shared_ptr<mga::HwcCursor> create_cursor() override
+        {
+            return nullptr;
+        }
+
         std::unique_ptr<mg::CommandStreamSync> create_command_stream_sync()
         {
             return nullptr;
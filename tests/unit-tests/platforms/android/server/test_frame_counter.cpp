@@ -0,0 +1,96 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/platforms/android/server/frame_counter.h"
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <atomic>
+#include <thread>
+
+namespace mg=mir::graphics;
+namespace mga=mir::graphics::android;
+
+namespace
+{
+mga::FrameCounter::Frames frames_at(int64_t msc)
+{
+    mga::FrameCounter::Frames frames;
+    frames.vsync.msc = msc;
+    frames.vsync.ust = mg::Frame::Timestamp{CLOCK_MONOTONIC, std::chrono::nanoseconds{msc * 1000}};
+    frames.presented.msc = msc - 1;
+    frames.presented.ust = mg::Frame::Timestamp{CLOCK_MONOTONIC, std::chrono::nanoseconds{msc * 1000 - 500}};
+    frames.period = std::chrono::nanoseconds{msc};
+    return frames;
+}
+
+bool same_frame(mg::Frame const& a, mg::Frame const& b)
+{
+    return (a.msc == b.msc) && (a.ust.clock_id == b.ust.clock_id) && (a.ust.nanoseconds == b.ust.nanoseconds);
+}
+}
+
+TEST(FrameCounter, loads_what_was_stored)
+{
+    using namespace testing;
+    mga::FrameCounter counter;
+    EXPECT_THAT(counter.load().vsync.msc, Eq(0));
+
+    counter.store(frames_at(4));
+    auto const frames = counter.load();
+    EXPECT_TRUE(same_frame(frames.vsync, frames_at(4).vsync));
+    EXPECT_TRUE(same_frame(frames.presented, frames_at(4).presented));
+    EXPECT_THAT(frames.period, Eq(std::chrono::nanoseconds{4}));
+}
+
+TEST(FrameCounter, readers_never_see_a_store_half_done)
+{
+    using namespace testing;
+    mga::FrameCounter counter;
+    counter.store(frames_at(1));
+    std::atomic<bool> done{false};
+    std::atomic<int> torn{0};
+
+    std::vector<std::thread> readers;
+    for (auto i = 0; i != 3; ++i)
+    {
+        readers.emplace_back([&]
+        {
+            int64_t last_msc{0};
+            while (!done)
+            {
+                auto const frames = counter.load();
+                auto const expected = frames_at(frames.vsync.msc);
+                if (!same_frame(frames.vsync, expected.vsync) ||
+                    !same_frame(frames.presented, expected.presented) ||
+                    (frames.period != expected.period) ||
+                    (frames.vsync.msc < last_msc))
+                {
+                    torn++;
+                }
+                last_msc = frames.vsync.msc;
+            }
+        });
+    }
+
+    for (int64_t msc = 2; msc != 200000; ++msc)
+        counter.store(frames_at(msc));
+    done = true;
+    for (auto& reader : readers)
+        reader.join();
+
+    EXPECT_THAT(torn, Eq(0));
+}
@@ -20,12 +20,17 @@
 #include "src/platforms/android/server/graphic_buffer_allocator.h"
 #include "src/platforms/android/server/cmdstream_sync_factory.h"
 #include "src/platforms/android/server/device_quirks.h"
+#include "native_buffer.h"
+#include "sync_fence.h"
 #include "mir/test/doubles/mock_android_hw.h"
 #include "mir/test/doubles/mock_buffer.h"
 #include "mir/test/doubles/mock_egl.h"
 
+#include <android/linux/sync.h>
+#include <fcntl.h>
 #include <future>
 #include <initializer_list>
+#include <set>
 #include <thread>
 #include <stdexcept>
 #include <gtest/gtest.h>
@@ -38,6 +43,13 @@ using namespace testing;
 
 namespace
 {
+struct MockFileOps : public mga::SyncFileOps
+{
+    MOCK_METHOD3(ioctl, int(int,int,void*));
+    MOCK_METHOD1(dup, int(int));
+    MOCK_METHOD1(close, int(int));
+};
+
 struct Framebuffers : Test
 {
     NiceMock<mtd::MockEGL> mock_egl;
@@ -95,3 +107,103 @@ TEST_F(Framebuffers, three_buffers_for_hwc)
 
     EXPECT_EQ(buffer1, buffer4);
 }
+
+TEST_F(Framebuffers, tracks_the_age_of_the_buffer_being_rendered)
+{
+    mga::Framebuffers framebuffers(allocator, display_size, format, 3u);
+
+    EXPECT_THAT(framebuffers.buffer_age(), Eq(0u));
+    for (auto i = 0u; i < 3u; i++)
+    {
+        auto buffer = framebuffers.buffer_for_render();
+        EXPECT_THAT(framebuffers.buffer_age(), Eq(0u));
+    }
+
+    auto buffer = framebuffers.buffer_for_render();
+    EXPECT_THAT(framebuffers.buffer_age(), Eq(3u));
+    buffer.reset();
+    buffer = framebuffers.buffer_for_render();
+    EXPECT_THAT(framebuffers.buffer_age(), Eq(3u));
+}
+
+TEST_F(Framebuffers, adds_a_third_buffer_while_triple_buffering)
+{
+    mga::Framebuffers framebuffers(allocator, display_size, format, 2u);
+
+    auto buffer1 = framebuffers.buffer_for_render().get();
+    auto buffer2 = framebuffers.buffer_for_render().get();
+    framebuffers.set_triple_buffering(true);
+    auto buffer3 = framebuffers.buffer_for_render();
+    EXPECT_THAT(buffer3.get(), Ne(buffer1));
+    EXPECT_THAT(buffer3.get(), Ne(buffer2));
+    EXPECT_THAT(framebuffers.buffer_age(), Eq(0u));
+    EXPECT_THAT(framebuffers.last_rendered_buffer().get(), Eq(buffer2));
+    auto buffer3_ptr = buffer3.get();
+    buffer3.reset();
+    EXPECT_THAT(framebuffers.buffer_for_render().get(), Eq(buffer1));
+
+    //the oldest buffer is dropped once the hint has stayed off for a while
+    framebuffers.set_triple_buffering(false);
+    std::set<mg::Buffer*> rendered;
+    for (auto i = 0u; i < mga::Framebuffers::frames_before_shrinking; i++)
+        rendered.insert(framebuffers.buffer_for_render().get());
+    EXPECT_THAT(rendered.size(), Eq(3u));
+
+    auto const buffer_a = framebuffers.buffer_for_render().get();
+    auto const buffer_b = framebuffers.buffer_for_render().get();
+    EXPECT_THAT(buffer_a, Ne(buffer_b));
+    EXPECT_THAT(framebuffers.buffer_for_render().get(), Eq(buffer_a));
+    EXPECT_THAT(framebuffers.buffer_for_render().get(), Eq(buffer_b));
+}
+
+TEST_F(Framebuffers, keeps_the_third_buffer_while_the_hint_flips)
+{
+    mga::Framebuffers framebuffers(allocator, display_size, format, 2u);
+
+    framebuffers.set_triple_buffering(true);
+    std::set<mg::Buffer*> allocated;
+    for (auto i = 0u; i < 3u; i++)
+        allocated.insert(framebuffers.buffer_for_render().get());
+    EXPECT_THAT(allocated.size(), Eq(3u));
+
+    for (auto i = 0u; i < 2 * mga::Framebuffers::frames_before_shrinking; i++)
+    {
+        framebuffers.set_triple_buffering((i % 2) == 1);
+        EXPECT_THAT(allocated.count(framebuffers.buffer_for_render().get()), Eq(1u));
+    }
+    std::set<mg::Buffer*> rendered;
+    for (auto i = 0u; i < 3u; i++)
+        rendered.insert(framebuffers.buffer_for_render().get());
+    EXPECT_THAT(rendered.size(), Eq(3u));
+}
+
+TEST_F(Framebuffers, keeps_the_third_buffer_until_its_release_fence_signals)
+{
+    auto const mock_ops = std::make_shared<NiceMock<MockFileOps>>();
+    bool signalled{false};
+    ON_CALL(*mock_ops, ioctl(_, SYNC_IOC_WAIT, _))
+        .WillByDefault(Invoke([&](int, int, void*) { return signalled ? 0 : -1; }));
+    mga::Framebuffers framebuffers(allocator, display_size, format, 2u, mock_ops);
+
+    framebuffers.set_triple_buffering(true);
+    for (auto i = 0u; i < 3u; i++)
+    {
+        auto const buffer = framebuffers.buffer_for_render();
+        mga::NativeFence release_fence = ::open("/dev/null", O_RDONLY);
+        mga::to_native_buffer_checked(buffer->native_buffer_handle())->update_usage(
+            release_fence, mga::BufferAccess::read);
+    }
+
+    framebuffers.set_triple_buffering(false);
+    std::set<mg::Buffer*> rendered;
+    for (auto i = 0u; i < mga::Framebuffers::frames_before_shrinking + 3u; i++)
+        rendered.insert(framebuffers.buffer_for_render().get());
+    EXPECT_THAT(rendered.size(), Eq(3u));
+
+    signalled = true;
+    framebuffers.buffer_for_render();
+    rendered.clear();
+    for (auto i = 0u; i < 4u; i++)
+        rendered.insert(framebuffers.buffer_for_render().get());
+    EXPECT_THAT(rendered.size(), Eq(2u));
+}
@@ -147,6 +147,25 @@ TEST_F(HwcConfiguration, translates_mir_power_mode_to_hwc_power_mode)
     power_mode_config.power_mode(display, mir_power_mode_on);
 }
 
+TEST_F(HwcConfiguration, turns_vsync_off_while_dozing)
+{
+    using namespace testing;
+    InSequence seq;
+    EXPECT_CALL(*mock_hwc_wrapper, vsync_signal_off(display));
+    EXPECT_CALL(*mock_hwc_wrapper, power_mode(display, mga::PowerMode::doze));
+    EXPECT_CALL(*mock_hwc_wrapper, power_mode(display, mga::PowerMode::doze_suspend));
+    EXPECT_CALL(*mock_hwc_wrapper, power_mode(display, mga::PowerMode::normal));
+    EXPECT_CALL(*mock_hwc_wrapper, vsync_signal_on(display));
+    EXPECT_CALL(*mock_hwc_wrapper, power_mode(display, mga::PowerMode::off));
+    EXPECT_CALL(*mock_hwc_wrapper, power_mode(display, mga::PowerMode::normal));
+
+    power_mode_config.power_mode(display, mir_power_mode_standby);
+    power_mode_config.power_mode(display, mir_power_mode_suspend);
+    power_mode_config.power_mode(display, mir_power_mode_on);
+    power_mode_config.power_mode(display, mir_power_mode_off);
+    power_mode_config.power_mode(display, mir_power_mode_on);
+}
+
 TEST_F(HwcConfiguration, queries_connected_primary_display_properties)
 {
     using namespace testing;
@@ -319,7 +338,59 @@ TEST_F(HwcConfiguration, uses_given_active_config_id)
         .WillOnce(Return(true));
     EXPECT_CALL(*mock_hwc_wrapper, active_config_for(display_name))
         .WillOnce(Return(config_ids[1]));
+    EXPECT_CALL(*mock_hwc_wrapper, display_attributes(display_name, config_ids[0], _, _));
     EXPECT_CALL(*mock_hwc_wrapper, display_attributes(display_name, config_ids[1], _, _));
 
-    power_mode_config.active_config_for(display_name);
+    auto const attribs = power_mode_config.active_config_for(display_name);
+    EXPECT_THAT(attribs.current_mode_index, Eq(1u));
+}
+
+namespace
+{
+int32_t const attribute_values_60hz[] = {1920, 1080, 16666666, 0, 0};
+int32_t const attribute_values_30hz[] = {1920, 1080, 33333333, 0, 0};
+int32_t const attribute_values_720p[] = {1280, 720, 16666666, 0, 0};
+}
+
+TEST_F(HwcConfiguration, offers_every_config_as_a_mode_from_hwc14)
+{
+    using namespace testing;
+    std::vector<mga::ConfigId> config_ids{mga::ConfigId{3}, mga::ConfigId{5}, mga::ConfigId{9}};
+    ON_CALL(*mock_hwc_wrapper, display_configs(display))
+        .WillByDefault(Return(config_ids));
+    ON_CALL(*mock_hwc_wrapper, has_active_config(display))
+        .WillByDefault(Return(true));
+    ON_CALL(*mock_hwc_wrapper, active_config_for(display))
+        .WillByDefault(Return(config_ids[2]));
+    EXPECT_CALL(*mock_hwc_wrapper, display_attributes(display, config_ids[0], _, _))
+        .WillOnce(DoAll(SetArrayArgument<3>(attribute_values_60hz, attribute_values_60hz + 5), Return(0)));
+    EXPECT_CALL(*mock_hwc_wrapper, display_attributes(display, config_ids[1], _, _))
+        .WillOnce(DoAll(SetArrayArgument<3>(attribute_values_30hz, attribute_values_30hz + 5), Return(0)));
+    EXPECT_CALL(*mock_hwc_wrapper, display_attributes(display, config_ids[2], _, _))
+        .WillOnce(DoAll(SetArrayArgument<3>(attribute_values_720p, attribute_values_720p + 5), Return(0)));
+
+    auto const attribs = power_mode_config.active_config_for(display);
+    ASSERT_THAT(attribs.modes.size(), Eq(3u));
+    EXPECT_THAT(attribs.modes[0].size, Eq(geom::Size{1920, 1080}));
+    EXPECT_THAT(attribs.modes[1].vrefresh_hz, DoubleNear(30.0, 0.1));
+    EXPECT_THAT(attribs.modes[2].size, Eq(geom::Size{1280, 720}));
+    EXPECT_THAT(attribs.current_mode_index, Eq(2u));
+}
+
+TEST_F(HwcConfiguration, sets_the_config_of_the_chosen_mode)
+{
+    using namespace testing;
+    std::vector<mga::ConfigId> config_ids{mga::ConfigId{3}, mga::ConfigId{5}};
+    ON_CALL(*mock_hwc_wrapper, display_configs(display))
+        .WillByDefault(Return(config_ids));
+
+    EXPECT_CALL(*mock_hwc_wrapper, set_active_config(display, config_ids[1]));
+    power_mode_config.set_active_mode(display, 1);
+
+    EXPECT_THROW({
+        power_mode_config.set_active_mode(display, 2);
+    }, std::invalid_argument);
+    EXPECT_THROW({
+        config.set_active_mode(display, 1);
+    }, std::invalid_argument);
 }
@@ -0,0 +1,242 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/platforms/android/server/hwc_cursor.h"
+#include "mir/graphics/cursor_image.h"
+#include "mir/graphics/graphic_buffer_allocator.h"
+#include "mir/test/doubles/mock_hwc_device_wrapper.h"
+#include "mir/test/doubles/stub_buffer.h"
+#include "mir/test/doubles/stub_android_native_buffer.h"
+#include <hardware/gralloc.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+namespace mg=mir::graphics;
+namespace mga=mir::graphics::android;
+namespace mtd=mir::test::doubles;
+namespace geom=mir::geometry;
+
+namespace
+{
+struct MockBufferAllocator : public mg::GraphicBufferAllocator
+{
+    MOCK_METHOD1(alloc_buffer, std::shared_ptr<mg::Buffer>(mg::BufferProperties const&));
+    MOCK_METHOD2(alloc_software_buffer, std::shared_ptr<mg::Buffer>(geom::Size, MirPixelFormat));
+    MOCK_METHOD3(alloc_buffer, std::shared_ptr<mg::Buffer>(geom::Size, uint32_t, uint32_t));
+    MOCK_METHOD0(supported_pixel_formats, std::vector<MirPixelFormat>());
+};
+
+struct StubCursorImage : public mg::CursorImage
+{
+    StubCursorImage(geom::Size size, geom::Displacement hotspot) :
+        pixels(size.width.as_int() * size.height.as_int() * 4, 0x5a),
+        image_size{size},
+        image_hotspot{hotspot}
+    {
+    }
+
+    void const* as_argb_8888() const override
+    {
+        return pixels.data();
+    }
+
+    geom::Size size() const override
+    {
+        return image_size;
+    }
+
+    geom::Displacement hotspot() const override
+    {
+        return image_hotspot;
+    }
+
+    std::vector<unsigned char> pixels;
+    geom::Size image_size;
+    geom::Displacement image_hotspot;
+};
+
+struct HwcCursor : public testing::Test
+{
+    HwcCursor()
+    {
+        using namespace testing;
+        ON_CALL(*mock_allocator, alloc_buffer(_,_,_))
+            .WillByDefault(Return(buffer));
+    }
+
+    geom::Size const cursor_size{16, 24};
+    std::shared_ptr<mtd::StubBuffer> const buffer{std::make_shared<mtd::StubBuffer>(
+        std::make_shared<mtd::StubAndroidNativeBuffer>(cursor_size), cursor_size)};
+    std::shared_ptr<testing::NiceMock<MockBufferAllocator>> const mock_allocator{
+        std::make_shared<testing::NiceMock<MockBufferAllocator>>()};
+    std::shared_ptr<testing::NiceMock<mtd::MockHWCDeviceWrapper>> const mock_wrapper{
+        std::make_shared<testing::NiceMock<mtd::MockHWCDeviceWrapper>>()};
+    StubCursorImage const image{cursor_size, {2, 3}};
+    geom::Rectangle const primary_area{{0, 0}, {100, 100}};
+    geom::Rectangle const external_area{{100, 0}, {100, 100}};
+    glm::mat2 const no_rotation{1};
+};
+}
+
+TEST_F(HwcCursor, writes_image_into_a_cursor_buffer)
+{
+    using namespace testing;
+    EXPECT_CALL(*mock_allocator, alloc_buffer(cursor_size, HAL_PIXEL_FORMAT_BGRA_8888, _))
+        .WillOnce(Return(buffer));
+
+    mga::HwcCursor cursor(mock_wrapper, mock_allocator);
+    cursor.show(image);
+    cursor.move_to({50, 60});
+
+    auto const renderable = cursor.renderable_for(mga::DisplayName::primary, primary_area, no_rotation);
+    ASSERT_THAT(renderable, Ne(nullptr));
+    EXPECT_THAT(renderable->buffer(), Eq(buffer));
+    EXPECT_THAT(renderable->screen_position(), Eq(geom::Rectangle{{48, 57}, cursor_size}));
+    EXPECT_TRUE(renderable->shaped());
+    EXPECT_THAT(buffer->written_pixels, ContainerEq(image.pixels));
+}
+
+TEST_F(HwcCursor, writes_new_images_into_a_buffer_the_hwc_is_not_given)
+{
+    using namespace testing;
+    auto const other_buffer = std::make_shared<mtd::StubBuffer>(
+        std::make_shared<mtd::StubAndroidNativeBuffer>(cursor_size), cursor_size);
+    EXPECT_CALL(*mock_allocator, alloc_buffer(_,_,_))
+        .WillOnce(Return(buffer))
+        .WillOnce(Return(other_buffer));
+
+    mga::HwcCursor cursor(mock_wrapper, mock_allocator);
+    cursor.show(image);
+    cursor.show(image);
+    auto const first = cursor.renderable_for(mga::DisplayName::primary, primary_area, no_rotation);
+    cursor.show(image);
+    auto const second = cursor.renderable_for(mga::DisplayName::primary, primary_area, no_rotation);
+    cursor.show(image);
+    auto const third = cursor.renderable_for(mga::DisplayName::primary, primary_area, no_rotation);
+
+    EXPECT_THAT(first->buffer(), Eq(buffer));
+    EXPECT_THAT(second->buffer(), Eq(other_buffer));
+    EXPECT_THAT(third->buffer(), Eq(buffer));
+    EXPECT_THAT(second->id(), Ne(first->id()));
+    EXPECT_THAT(third->id(), Ne(first->id()));
+}
+
+TEST_F(HwcCursor, is_only_on_the_display_it_is_over_while_shown)
+{
+    using namespace testing;
+    mga::HwcCursor cursor(mock_wrapper, mock_allocator);
+    EXPECT_THAT(cursor.renderable_for(mga::DisplayName::primary, primary_area, no_rotation), Eq(nullptr));
+
+    cursor.show(image);
+    cursor.move_to({150, 20});
+    EXPECT_THAT(cursor.renderable_for(mga::DisplayName::primary, primary_area, no_rotation), Eq(nullptr));
+    EXPECT_THAT(cursor.renderable_for(mga::DisplayName::external, external_area, no_rotation), Ne(nullptr));
+
+    cursor.hide();
+    EXPECT_THAT(cursor.renderable_for(mga::DisplayName::external, external_area, no_rotation), Eq(nullptr));
+    cursor.show();
+    EXPECT_THAT(cursor.renderable_for(mga::DisplayName::external, external_area, no_rotation), Ne(nullptr));
+}
+
+TEST_F(HwcCursor, moves_the_cursor_layer_of_the_display_it_is_over)
+{
+    using namespace testing;
+    mga::HwcCursor cursor(mock_wrapper, mock_allocator);
+    cursor.show(image);
+    cursor.move_to({150, 20});
+    cursor.renderable_for(mga::DisplayName::primary, primary_area, no_rotation);
+    cursor.renderable_for(mga::DisplayName::external, external_area, no_rotation);
+
+    EXPECT_CALL(*mock_wrapper, set_cursor_position(mga::DisplayName::external, geom::Point{58, 27}))
+        .WillOnce(Return(true));
+    EXPECT_CALL(*mock_wrapper, set_cursor_position(mga::DisplayName::primary, _))
+        .Times(0);
+
+    cursor.move_to({160, 30});
+}
+
+TEST_F(HwcCursor, moves_the_cursor_layer_off_a_display_it_leaves)
+{
+    using namespace testing;
+    mga::HwcCursor cursor(mock_wrapper, mock_allocator);
+    cursor.show(image);
+    cursor.move_to({50, 60});
+    cursor.renderable_for(mga::DisplayName::primary, primary_area, no_rotation);
+    cursor.renderable_for(mga::DisplayName::external, external_area, no_rotation);
+
+    EXPECT_CALL(*mock_wrapper, set_cursor_position(mga::DisplayName::primary, geom::Point{100, 100}))
+        .WillOnce(Return(true));
+    EXPECT_CALL(*mock_wrapper, set_cursor_position(mga::DisplayName::external, _))
+        .Times(0);
+
+    cursor.move_to({150, 20});
+    cursor.move_to({160, 30});
+}
+
+TEST_F(HwcCursor, hides_and_shows_the_cursor_layer_without_a_composition)
+{
+    using namespace testing;
+    mga::HwcCursor cursor(mock_wrapper, mock_allocator);
+    cursor.show(image);
+    cursor.move_to({50, 60});
+    cursor.renderable_for(mga::DisplayName::primary, primary_area, no_rotation);
+
+    InSequence seq;
+    EXPECT_CALL(*mock_wrapper, set_cursor_position(mga::DisplayName::primary, geom::Point{100, 100}))
+        .WillOnce(Return(true));
+    EXPECT_CALL(*mock_wrapper, set_cursor_position(mga::DisplayName::primary, geom::Point{48, 57}))
+        .WillOnce(Return(true));
+
+    cursor.hide();
+    cursor.move_to({40, 40});
+    cursor.move_to({50, 60});
+    cursor.show();
+}
+
+TEST_F(HwcCursor, moves_the_cursor_layer_on_rotated_displays)
+{
+    using namespace testing;
+    mga::HwcCursor cursor(mock_wrapper, mock_allocator);
+    cursor.show(image);
+    cursor.renderable_for(mga::DisplayName::primary, primary_area, glm::mat2{0, 1, -1, 0});
+
+    EXPECT_CALL(*mock_wrapper, set_cursor_position(mga::DisplayName::primary, geom::Point{57, 36}))
+        .WillOnce(Return(true));
+
+    cursor.move_to({50, 60});
+}
+
+TEST_F(HwcCursor, leaves_moves_the_hwc_refuses_to_the_next_composition)
+{
+    using namespace testing;
+    mga::HwcCursor cursor(mock_wrapper, mock_allocator);
+    cursor.show(image);
+    cursor.renderable_for(mga::DisplayName::primary, primary_area, no_rotation);
+
+    EXPECT_CALL(*mock_wrapper, set_cursor_position(mga::DisplayName::primary, _))
+        .WillOnce(Return(false));
+    cursor.move_to({50, 60});
+    cursor.move_to({40, 40});
+    Mock::VerifyAndClearExpectations(mock_wrapper.get());
+
+    auto const renderable = cursor.renderable_for(mga::DisplayName::primary, primary_area, no_rotation);
+    ASSERT_THAT(renderable, Ne(nullptr));
+    EXPECT_THAT(renderable->screen_position().top_left, Eq(geom::Point{38, 37}));
+
+    EXPECT_CALL(*mock_wrapper, set_cursor_position(mga::DisplayName::primary, geom::Point{48, 57}))
+        .WillOnce(Return(true));
+    cursor.move_to({50, 60});
+}
@@ -28,6 +28,7 @@
 #include "mir/test/doubles/mock_framebuffer_bundle.h"
 #include "mir/test/doubles/stub_buffer.h"
 #include "mir/test/doubles/mock_hwc_device_wrapper.h"
+#include "mir/test/doubles/mock_hwc_report.h"
 #include "mir/test/fake_shared.h"
 #include "hwc_struct_helpers.h"
 #include "mir/test/doubles/mock_swapping_gl_context.h"
@@ -41,6 +42,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <stdexcept>
+#include <thread>
 
 namespace mg=mir::graphics;
 namespace mga=mir::graphics::android;
@@ -69,6 +71,7 @@ struct HwcDevice : public ::testing::Test
         stub_renderable1(std::make_shared<mtd::StubRenderable>(stub_buffer1, position1)),
         stub_renderable2(std::make_shared<mtd::StubRenderable>(stub_buffer2, position2)),
         mock_device(std::make_shared<testing::NiceMock<mtd::MockHWCDeviceWrapper>>()),
+        mock_report(std::make_shared<testing::NiceMock<mtd::MockHwcReport>>()),
         stub_context{stub_fb_buffer},
         renderlist({stub_renderable1, stub_renderable2}),
         layer_adapter{std::make_shared<mga::IntegerSourceCrop>()}
@@ -113,6 +116,7 @@ struct HwcDevice : public ::testing::Test
     std::shared_ptr<mtd::StubRenderable> const stub_renderable1;
     std::shared_ptr<mtd::StubRenderable> const stub_renderable2;
     std::shared_ptr<mtd::MockHWCDeviceWrapper> const mock_device;
+    std::shared_ptr<mtd::MockHwcReport> const mock_report;
     mtd::StubSwappingGLContext stub_context;
     mg::RenderableList renderlist;
     std::shared_ptr<mga::LayerAdapter> const layer_adapter;
@@ -123,7 +127,7 @@ struct HwcDevice : public ::testing::Test
 
 TEST_F(HwcDevice, reports_it_can_swap)
 {
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     EXPECT_TRUE(device.can_swap_buffers());
 }
 
@@ -141,7 +145,7 @@ TEST_F(HwcDevice, prepares_a_skip_and_target_layer_by_default)
 
     mga::LayerList list(layer_adapter, {}, geom::Displacement{0,0});
     mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     device.commit({content});
 }
 
@@ -172,12 +176,12 @@ TEST_F(HwcDevice, calls_backup_compositor_when_overlay_rejected)
             contents[0]->hwLayers[2].compositionType = HWC_FRAMEBUFFER_TARGET;
         }));
 
-    EXPECT_CALL(mock_compositor, render(expected_renderable_list, offset, Ref(stub_context)))
+    EXPECT_CALL(mock_compositor, render(expected_renderable_list, offset, _, Ref(stub_context)))
         .InSequence(seq);
 
     mga::LayerList list(layer_adapter, renderlist, geom::Displacement{});
     mga::DisplayContents content{primary, list, offset, stub_context, mock_compositor};
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     device.commit({content});
 }
 
@@ -189,14 +193,14 @@ TEST_F(HwcDevice, does_not_swap_buffers_when_no_renderables)
     ON_CALL(mock_context, last_rendered_buffer())
         .WillByDefault(Return(stub_fb_buffer));
 
-    EXPECT_CALL(mock_compositor, render(_,_,_))
+    EXPECT_CALL(mock_compositor, render(_,_,_,_))
         .Times(0);
     EXPECT_CALL(mock_context, swap_buffers())
         .Times(0);
 
     mga::LayerList list(layer_adapter, {}, geom::Displacement{});
     mga::DisplayContents content{primary, list, offset, mock_context, mock_compositor};
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     device.commit({content});
 }
 
@@ -222,7 +226,7 @@ TEST_F(HwcDevice, resets_layers_when_prepare_gl_called)
     EXPECT_CALL(*mock_device, prepare(MatchesPrimaryList(expected_list2)))
         .InSequence(seq);
 
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     mga::LayerList list(layer_adapter, renderlist, geom::Displacement{});
     mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
     device.commit({content});
@@ -257,7 +261,7 @@ TEST_F(HwcDevice, sets_and_updates_fences)
     EXPECT_CALL(*mock_native_buffer3, update_usage(fb_release_fence, mga::BufferAccess::read))
         .InSequence(seq);
 
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     mga::LayerList list(layer_adapter, {}, geom::Displacement{});
     mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
     device.commit({content});
@@ -309,7 +313,7 @@ TEST_F(HwcDevice, commits_correct_list_with_rejected_renderables)
     EXPECT_CALL(*mock_native_buffer3, update_usage(fb_release_fence, mga::BufferAccess::read))
         .InSequence(seq);
 
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     mga::LayerList list(layer_adapter, {stub_renderable1}, geom::Displacement{});
     mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
     device.commit({content});
@@ -373,7 +377,7 @@ TEST_F(HwcDevice, commits_correct_list_when_all_accepted_as_overlays)
     EXPECT_CALL(*mock_native_buffer2, update_usage(release_fence2, mga::BufferAccess::read))
         .InSequence(seq);
 
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     mga::LayerList list(layer_adapter, renderlist, geom::Displacement{});
     mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
     device.commit({content});
@@ -382,7 +386,7 @@ TEST_F(HwcDevice, commits_correct_list_when_all_accepted_as_overlays)
 TEST_F(HwcDevice, submits_every_time_if_at_least_one_layer_is_gl_rendered)
 {
     using namespace testing;
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
 
     ON_CALL(*mock_device, prepare(_))
         .WillByDefault(Invoke([&](std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& contents)
@@ -399,6 +403,7 @@ TEST_F(HwcDevice, submits_every_time_if_at_least_one_layer_is_gl_rendered)
     mga::LayerList list(layer_adapter, renderlist, geom::Displacement{});
     mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
     device.commit({content});
+    stub_renderable2->set_buffer(std::make_shared<mtd::StubBuffer>(mock_native_buffer1, size2));
     list.update_list(renderlist, geom::Displacement{});
     device.commit({content});
 }
@@ -408,7 +413,7 @@ TEST_F(HwcDevice, resets_composition_type_with_prepare) //lp:1314399
     using namespace testing;
     mg::RenderableList renderlist({stub_renderable1});
     mg::RenderableList renderlist2({stub_renderable2});
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
 
     std::list<hwc_layer_1_t*> expected_list1 { &layer, &target_layer };
     std::list<hwc_layer_1_t*> expected_list2 { &layer2, &target_layer };
@@ -427,6 +432,122 @@ TEST_F(HwcDevice, resets_composition_type_with_prepare) //lp:1314399
     device.commit({content});
 }
 
+TEST_F(HwcDevice, only_signals_geometry_change_when_the_list_changes)
+{
+    using namespace testing;
+    std::vector<uint32_t> prepared_flags;
+    ON_CALL(*mock_device, prepare(_))
+        .WillByDefault(Invoke([&](std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& contents)
+        {
+            prepared_flags.push_back(contents[0]->flags);
+            set_all_layers_to_overlay(contents);
+        }));
+
+    mga::HwcDevice device(mock_device, mock_report);
+    mga::LayerList list(layer_adapter, renderlist, geom::Displacement{});
+    mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
+    device.commit({content});
+    stub_renderable2->set_buffer(std::make_shared<mtd::StubBuffer>(mock_native_buffer1, size2));
+    list.update_list(renderlist, geom::Displacement{});
+    device.commit({content});
+    list.update_list({stub_renderable1, std::make_shared<mtd::StubRenderable>(stub_buffer2, position1)},
+        geom::Displacement{});
+    device.commit({content});
+
+    uint32_t const changed = HWC_GEOMETRY_CHANGED;
+    EXPECT_THAT(prepared_flags, ElementsAre(changed, 0u, changed));
+}
+
+TEST_F(HwcDevice, reuses_fb_target_when_gl_composited_renderables_are_unchanged)
+{
+    using namespace testing;
+    ON_CALL(*mock_device, prepare(_))
+        .WillByDefault(Invoke([](std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& contents)
+        {
+            //the first layer goes to gl, the second is an overlay
+            contents[0]->hwLayers[1].compositionType = HWC_OVERLAY;
+        }));
+
+    mtd::MockRenderableListCompositor mock_compositor;
+    mga::HwcDevice device(mock_device, mock_report);
+    mga::LayerList list(layer_adapter, renderlist, geom::Displacement{});
+    mga::DisplayContents content{primary, list, offset, stub_context, mock_compositor};
+
+    EXPECT_CALL(mock_compositor, render(_,_,_,_))
+        .Times(1);
+    EXPECT_CALL(*mock_native_buffer3, copy_fence())
+        .Times(1);
+    device.commit({content});
+    stub_renderable2->set_buffer(std::make_shared<mtd::StubBuffer>(mock_native_buffer1, size2));
+    list.update_list(renderlist, geom::Displacement{});
+    device.commit({content});
+    Mock::VerifyAndClearExpectations(&mock_compositor);
+    Mock::VerifyAndClearExpectations(mock_native_buffer3.get());
+
+    EXPECT_CALL(mock_compositor, render(_,_,_,_))
+        .Times(1);
+    EXPECT_CALL(*mock_native_buffer3, copy_fence())
+        .Times(1);
+    stub_renderable1->set_buffer(std::make_shared<mtd::StubBuffer>(mock_native_buffer2, size1));
+    list.update_list(renderlist, geom::Displacement{});
+    device.commit({content});
+}
+
+TEST_F(HwcDevice, leaves_fb_target_uncleared_only_under_overlays_without_clear_hint)
+{
+    using namespace testing;
+    uint32_t overlay_hints{0};
+    ON_CALL(*mock_device, prepare(_))
+        .WillByDefault(Invoke([&](std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& contents)
+        {
+            contents[0]->hwLayers[1].compositionType = HWC_OVERLAY;
+            contents[0]->hwLayers[1].hints = overlay_hints;
+        }));
+
+    mtd::MockRenderableListCompositor mock_compositor;
+    mga::HwcDevice device(mock_device, mock_report);
+    mga::LayerList list(layer_adapter, renderlist, geom::Displacement{});
+    mga::DisplayContents content{primary, list, offset, stub_context, mock_compositor};
+
+    EXPECT_CALL(mock_compositor, render(_, offset, ElementsAre(position2), Ref(stub_context)));
+    device.commit({content});
+    Mock::VerifyAndClearExpectations(&mock_compositor);
+
+    overlay_hints = HWC_HINT_CLEAR_FB;
+    stub_renderable1->set_buffer(std::make_shared<mtd::StubBuffer>(mock_native_buffer2, size1));
+    list.update_list(renderlist, geom::Displacement{});
+    EXPECT_CALL(mock_compositor, render(_, offset, IsEmpty(), Ref(stub_context)));
+    device.commit({content});
+}
+
+TEST_F(HwcDevice, triple_buffers_while_the_hwc_asks_for_it)
+{
+    using namespace testing;
+    uint32_t target_hints{HWC_HINT_TRIPLE_BUFFER};
+    ON_CALL(*mock_device, prepare(_))
+        .WillByDefault(Invoke([&](std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& contents)
+        {
+            contents[0]->hwLayers[0].hints = target_hints;
+        }));
+
+    NiceMock<mtd::MockSwappingGLContext> mock_context;
+    ON_CALL(mock_context, last_rendered_buffer())
+        .WillByDefault(Return(stub_fb_buffer));
+    mga::HwcDevice device(mock_device, mock_report);
+    mga::LayerList list(layer_adapter, renderlist, geom::Displacement{});
+    mga::DisplayContents content{primary, list, offset, mock_context, stub_compositor};
+
+    EXPECT_CALL(mock_context, set_triple_buffering(true));
+    device.commit({content});
+    Mock::VerifyAndClearExpectations(&mock_context);
+
+    target_hints = 0;
+    stub_renderable1->set_buffer(std::make_shared<mtd::StubBuffer>(mock_native_buffer2, size1));
+    list.update_list(renderlist, geom::Displacement{});
+    EXPECT_CALL(mock_context, set_triple_buffering(false));
+    device.commit({content});
+}
+
 //note: HWC models overlay layer buffers as owned by the display hardware until a subsequent set.
 TEST_F(HwcDevice, owns_overlay_buffers_until_next_set)
 {
@@ -435,25 +556,186 @@ TEST_F(HwcDevice, owns_overlay_buffers_until_next_set)
         .WillOnce(Invoke(set_all_layers_to_overlay))
         .WillOnce(Return());
 
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
 
     auto use_count_before = stub_buffer1.use_count();
     mga::LayerList list(layer_adapter, {stub_renderable1}, geom::Displacement{});
     mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
     device.commit({content});
     EXPECT_THAT(stub_buffer1.use_count(), Gt(use_count_before));
-    list.update_list({stub_renderable1}, geom::Displacement{});
+    list.update_list({stub_renderable2}, geom::Displacement{});
     device.commit({content});
     EXPECT_THAT(stub_buffer1.use_count(), Eq(use_count_before));
 }
 
+TEST_F(HwcDevice, elides_frames_when_nothing_changed)
+{
+    using namespace testing;
+    EXPECT_CALL(*mock_device, prepare(_))
+        .WillOnce(Invoke(set_all_layers_to_overlay));
+    EXPECT_CALL(*mock_device, set(_))
+        .Times(1);
+    EXPECT_CALL(*mock_report, report_frame_elided())
+        .Times(1);
+
+    mga::HwcDevice device(mock_device, mock_report);
+    mga::LayerList list(layer_adapter, renderlist, geom::Displacement{});
+    mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
+    device.commit({content});
+    list.update_list(renderlist, geom::Displacement{});
+    device.commit({content});
+}
+
+TEST_F(HwcDevice, sets_an_overlay_that_only_fades)
+{
+    using namespace testing;
+    float alpha{0.5f};
+    auto renderable = std::make_shared<NiceMock<mtd::MockRenderable>>();
+    ON_CALL(*renderable, buffer())
+        .WillByDefault(Return(stub_buffer1));
+    ON_CALL(*renderable, screen_position())
+        .WillByDefault(Return(position1));
+    ON_CALL(*renderable, alpha())
+        .WillByDefault(Invoke([&] { return alpha; }));
+    mg::RenderableList const renderlist{renderable};
+
+    EXPECT_CALL(*mock_device, prepare(_))
+        .Times(2)
+        .WillRepeatedly(Invoke(set_all_layers_to_overlay));
+    EXPECT_CALL(*mock_device, set(_))
+        .Times(2);
+    EXPECT_CALL(*mock_report, report_frame_elided())
+        .Times(0);
+
+    mga::HwcDevice device(mock_device, mock_report);
+    mga::LayerList list(std::make_shared<mga::Hwc12Adapter>(), renderlist, geom::Displacement{});
+    mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
+    device.commit({content});
+    alpha = 0.25f;
+    list.update_list(renderlist, geom::Displacement{});
+    device.commit({content});
+}
+
+TEST_F(HwcDevice, reuses_composition_when_only_the_framebuffer_changes)
+{
+    using namespace testing;
+    auto stub_fb_buffer2 = std::make_shared<mtd::StubBuffer>(
+        std::make_shared<NiceMock<mtd::MockAndroidNativeBuffer>>(size3), size3);
+    NiceMock<mtd::MockSwappingGLContext> mock_context;
+    EXPECT_CALL(mock_context, last_rendered_buffer())
+        .WillRepeatedly(Return(stub_fb_buffer));
+
+    std::list<hwc_layer_1_t*> expected_list{&skip_layer, &target_layer};
+    EXPECT_CALL(*mock_device, prepare(MatchesPrimaryList(expected_list)))
+        .Times(1);
+    EXPECT_CALL(*mock_device, set(_))
+        .Times(2);
+    EXPECT_CALL(*mock_report, report_prepare_skipped())
+        .Times(1);
+    EXPECT_CALL(*mock_report, report_frame_elided())
+        .Times(0);
+
+    mga::HwcDevice device(mock_device, mock_report);
+    mga::LayerList list(layer_adapter, {}, geom::Displacement{});
+    mga::DisplayContents content{primary, list, offset, mock_context, stub_compositor};
+    device.commit({content});
+
+    EXPECT_CALL(mock_context, last_rendered_buffer())
+        .WillRepeatedly(Return(stub_fb_buffer2));
+    list.update_list({}, geom::Displacement{});
+    device.commit({content});
+}
+
+TEST_F(HwcDevice, prepares_again_after_content_is_cleared)
+{
+    using namespace testing;
+    EXPECT_CALL(*mock_device, prepare(_))
+        .Times(2)
+        .WillRepeatedly(Invoke(set_all_layers_to_overlay));
+    EXPECT_CALL(*mock_device, set(_))
+        .Times(2);
+
+    mga::HwcDevice device(mock_device, mock_report);
+    mga::LayerList list(layer_adapter, renderlist, geom::Displacement{});
+    mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
+    device.commit({content});
+    device.content_cleared();
+    list.update_list(renderlist, geom::Displacement{});
+    device.commit({content});
+}
+
+TEST_F(HwcDevice, searches_for_the_composition_with_the_least_gl_fill)
+{
+    using namespace testing;
+    std::vector<uint32_t> bottom_layer_flags;
+    //the hwc has a single overlay, and gives it to the lowest layer it can
+    ON_CALL(*mock_device, prepare(_))
+        .WillByDefault(Invoke([&](std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& contents)
+        {
+            bottom_layer_flags.push_back(contents[0]->hwLayers[0].flags);
+            bool overlay_taken = false;
+            for (auto i = 0u; i < contents[0]->numHwLayers - 1; i++)
+            {
+                auto& layer = contents[0]->hwLayers[i];
+                layer.compositionType = HWC_FRAMEBUFFER;
+                if (!overlay_taken && !(layer.flags & HWC_SKIP_LAYER))
+                {
+                    layer.compositionType = HWC_OVERLAY;
+                    overlay_taken = true;
+                }
+            }
+        }));
+
+    mga::HwcDevice device(mock_device, mock_report, std::chrono::seconds{1});
+    mga::LayerList list(layer_adapter, renderlist, geom::Displacement{});
+    mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
+    device.commit({content});
+    EXPECT_THAT(list.native_list()->hwLayers[1].compositionType, Eq(HWC_OVERLAY));
+
+    //a different buffer is searched again
+    stub_renderable2->set_buffer(std::make_shared<mtd::StubBuffer>(mock_native_buffer1, size2));
+    list.update_list(renderlist, geom::Displacement{});
+    device.commit({content});
+    EXPECT_THAT(list.native_list()->hwLayers[1].compositionType, Eq(HWC_OVERLAY));
+
+    //the plan for the first buffers is remembered
+    stub_renderable2->set_buffer(stub_buffer2);
+    list.update_list(renderlist, geom::Displacement{});
+    device.commit({content});
+    EXPECT_THAT(list.native_list()->hwLayers[1].compositionType, Eq(HWC_OVERLAY));
+
+    uint32_t const skip = HWC_SKIP_LAYER;
+    EXPECT_THAT(bottom_layer_flags, ElementsAre(0u, skip, 0u, skip, skip));
+}
+
+TEST_F(HwcDevice, prepares_without_a_plan_when_not_searching)
+{
+    using namespace testing;
+    std::vector<uint32_t> bottom_layer_flags;
+    ON_CALL(*mock_device, prepare(_))
+        .WillByDefault(Invoke([&](std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& contents)
+        {
+            bottom_layer_flags.push_back(contents[0]->hwLayers[0].flags);
+            for (auto i = 0u; i < contents[0]->numHwLayers - 1; i++)
+                contents[0]->hwLayers[i].compositionType = HWC_FRAMEBUFFER;
+        }));
+
+    mga::HwcDevice device(mock_device, mock_report);
+    mga::LayerList list(layer_adapter, renderlist, geom::Displacement{});
+    list.force_gl_render({true, false});
+    mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
+    device.commit({content});
+
+    EXPECT_THAT(bottom_layer_flags, ElementsAre(0u));
+}
+
 TEST_F(HwcDevice, overlays_are_throttled_per_predictive_bypass)
 {
     using namespace testing;
     EXPECT_CALL(*mock_device, prepare(_))
         .WillRepeatedly(Invoke(set_all_layers_to_overlay));
 
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
 
     mga::LayerList list(layer_adapter, {stub_renderable1}, {0,0});
     mga::DisplayContents content{primary, list, offset, stub_context,
@@ -479,7 +761,7 @@ TEST_F(HwcDevice, compositing_disables_predictive_bypass)
     mga::DisplayContents content{primary, list, offset, mock_context,
                                  mock_compositor};
 
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     device.commit({content});
     for (int frame = 0; frame < 5; ++frame)
     {
@@ -561,7 +843,7 @@ TEST_F(HwcDevice, does_not_set_acquirefences_when_it_has_set_them_previously_wit
         .InSequence(seq)
         .WillOnce(Invoke(set_fences_fn));
 
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     mga::LayerList list(layer_adapter, renderlist, geom::Displacement{});
     mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
     device.commit({content});
@@ -583,7 +865,7 @@ TEST_F(HwcDevice, does_not_own_framebuffer_buffers_past_set)
             contents[0]->hwLayers[1].compositionType = HWC_FRAMEBUFFER_TARGET;
         }));
 
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
 
     auto use_count_before = stub_buffer1.use_count();
 
@@ -595,7 +877,7 @@ TEST_F(HwcDevice, does_not_own_framebuffer_buffers_past_set)
 
 TEST_F(HwcDevice, rejects_empty_list)
 {
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     mg::RenderableList renderlist{};
     EXPECT_FALSE(device.compatible_renderlist(renderlist));
 }
@@ -605,7 +887,7 @@ TEST_F(HwcDevice, accepts_list_containing_interval_0)
 {
     using namespace ::testing;
 
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     auto renderable = std::make_shared<NiceMock<mtd::MockRenderable>>();
 
     ON_CALL(*renderable, swap_interval())
@@ -618,19 +900,19 @@ TEST_F(HwcDevice, accepts_list_containing_interval_0)
 //TODO: we could accept a 90 degree transform
 TEST_F(HwcDevice, rejects_list_containing_transformed)
 {
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
 
     auto renderable = std::make_shared<mtd::StubTransformedRenderable>();
     mg::RenderableList renderlist{renderable};
     EXPECT_FALSE(device.compatible_renderlist(renderlist));
 }
 
-//TODO: support plane alpha for hwc 1.2 and later
-TEST_F(HwcDevice, rejects_list_containing_plane_alpha)
+//the layer list forces translucent layers to GL if the hwc cannot use planeAlpha
+TEST_F(HwcDevice, accepts_list_containing_plane_alpha)
 {
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     mg::RenderableList renderlist{std::make_shared<mtd::PlaneAlphaRenderable>()};
-    EXPECT_FALSE(device.compatible_renderlist(renderlist));
+    EXPECT_TRUE(device.compatible_renderlist(renderlist));
 }
 
 TEST_F(HwcDevice, does_not_own_overlay_buffers_after_screen_off)
@@ -639,7 +921,7 @@ TEST_F(HwcDevice, does_not_own_overlay_buffers_after_screen_off)
     EXPECT_CALL(*mock_device, prepare(_))
         .WillOnce(Invoke(set_all_layers_to_overlay));
 
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
 
     auto use_count_before = stub_buffer1.use_count();
     mga::LayerList list(layer_adapter, {stub_renderable1}, geom::Displacement{});
@@ -736,7 +1018,7 @@ TEST_F(HwcDevice, tracks_hwc_owned_fences_even_across_list_changes)
         .InSequence(seq);
     //end second post
 
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     mga::LayerList list(layer_adapter, renderlist1, geom::Displacement{});
     mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
     device.commit({content});
@@ -840,7 +1122,7 @@ TEST_F(HwcDevice, tracks_hwc_owned_fences_across_list_rearrange)
         .InSequence(seq);
     //end second post
 
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
     mga::LayerList list(layer_adapter, renderlist, geom::Displacement{});
     mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
     device.commit({content});
@@ -870,12 +1152,166 @@ TEST_F(HwcDevice, commits_external_list_with_both_force_gl)
     mga::LayerList primary_list(layer_adapter, {}, geom::Displacement{});
     mga::LayerList external_list(layer_adapter, {}, geom::Displacement{});
 
-    mga::HwcDevice device(mock_device);
+    mga::HwcDevice device(mock_device, mock_report);
+
+    mga::DisplayContents primary_content{
+        primary, primary_list, offset, mock_context1, stub_compositor};
+    mga::DisplayContents external_content{
+        mga::DisplayName::external, external_list, offset, mock_context2, stub_compositor};
+
+    device.commit({primary_content, external_content});
+}
+
+TEST_F(HwcDevice, sets_the_last_list_of_a_display_while_the_other_is_committed_on_its_own)
+{
+    using namespace testing;
+    testing::NiceMock<mtd::MockSwappingGLContext> mock_context1;
+    testing::NiceMock<mtd::MockSwappingGLContext> mock_context2;
+    ON_CALL(mock_context1, last_rendered_buffer())
+        .WillByDefault(Return(stub_fb_buffer));
+    ON_CALL(mock_context2, last_rendered_buffer())
+        .WillByDefault(Return(stub_fb_buffer));
+    std::list<hwc_layer_1_t*> expected_list
+    {
+        &skip_layer,
+        &target_layer
+    };
 
+    mga::LayerList primary_list(layer_adapter, {}, geom::Displacement{});
+    mga::LayerList external_list(layer_adapter, {}, geom::Displacement{});
     mga::DisplayContents primary_content{
         primary, primary_list, offset, mock_context1, stub_compositor};
     mga::DisplayContents external_content{
         mga::DisplayName::external, external_list, offset, mock_context2, stub_compositor};
 
+    mga::HwcDevice device(mock_device, mock_report);
     device.commit({primary_content, external_content});
+    Mock::VerifyAndClearExpectations(mock_device.get());
+
+    hwc_display_contents_1_t* set_primary_list{nullptr};
+    InSequence seq;
+    EXPECT_CALL(*mock_device, prepare(MatchesLists(expected_list, expected_list)));
+    EXPECT_CALL(*mock_device, set(MatchesLists(expected_list, expected_list)))
+        .WillOnce(Invoke([&](std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const& lists)
+        {
+            set_primary_list = lists[HWC_DISPLAY_PRIMARY];
+        }));
+
+    device.commit({external_content});
+    EXPECT_THAT(set_primary_list, Ne(primary_list.native_list()));
+
+    std::list<hwc_layer_1_t*> const no_list;
+    device.content_cleared();
+    EXPECT_CALL(*mock_device, prepare(MatchesLists(expected_list, no_list)));
+    EXPECT_CALL(*mock_device, set(MatchesLists(expected_list, no_list)));
+    device.commit({primary_content});
+}
+
+TEST_F(HwcDevice, sets_the_last_lists_when_no_display_is_committed)
+{
+    using namespace testing;
+    NiceMock<mtd::MockSwappingGLContext> mock_context;
+    ON_CALL(mock_context, last_rendered_buffer())
+        .WillByDefault(Return(stub_fb_buffer));
+    std::list<hwc_layer_1_t*> expected_list
+    {
+        &skip_layer,
+        &target_layer
+    };
+    std::list<hwc_layer_1_t*> const no_list;
+
+    mga::HwcDevice device(mock_device, mock_report);
+    EXPECT_CALL(*mock_device, prepare(_))
+        .Times(0);
+    EXPECT_CALL(*mock_device, set(_))
+        .Times(0);
+    device.commit({});
+    Mock::VerifyAndClearExpectations(mock_device.get());
+
+    mga::LayerList primary_list(layer_adapter, {}, geom::Displacement{});
+    mga::DisplayContents primary_content{primary, primary_list, offset, mock_context, stub_compositor};
+    device.commit({primary_content});
+    Mock::VerifyAndClearExpectations(mock_device.get());
+
+    InSequence seq;
+    EXPECT_CALL(*mock_device, prepare(MatchesLists(expected_list, no_list)));
+    EXPECT_CALL(*mock_device, set(MatchesLists(expected_list, no_list)));
+    device.commit({});
+}
+
+TEST_F(HwcDevice, sets_the_prepared_list_on_the_commit_thread_when_pipelined)
+{
+    using namespace testing;
+    std::list<hwc_layer_1_t*> expected_list
+    {
+        &skip_layer,
+        &target_layer
+    };
+    auto const compositor_thread = std::this_thread::get_id();
+    std::thread::id set_thread;
+
+    InSequence seq;
+    EXPECT_CALL(*mock_device, prepare(MatchesPrimaryList(expected_list)));
+    EXPECT_CALL(*mock_device, set(MatchesPrimaryList(expected_list)))
+        .WillOnce(Invoke([&](std::array<hwc_display_contents_1_t*, HWC_NUM_DISPLAY_TYPES> const&)
+        {
+            set_thread = std::this_thread::get_id();
+        }));
+
+    mga::LayerList list(layer_adapter, {}, geom::Displacement{});
+    mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
+    {
+        mga::HwcDevice device(mock_device, mock_report, std::chrono::microseconds{0}, true);
+        device.commit({content});
+    }
+
+    EXPECT_THAT(set_thread, Ne(compositor_thread));
+}
+
+TEST_F(HwcDevice, rethrows_a_failed_pipelined_set_on_the_next_commit)
+{
+    using namespace testing;
+    ON_CALL(*mock_device, set(_))
+        .WillByDefault(Throw(std::runtime_error("set failed")));
+
+    mga::LayerList list(layer_adapter, {}, geom::Displacement{});
+    mga::DisplayContents content{primary, list, offset, stub_context, stub_compositor};
+    mga::HwcDevice device(mock_device, mock_report, std::chrono::microseconds{0}, true);
+    device.commit({content});
+
+    EXPECT_THROW({
+        device.commit({content});
+    }, std::runtime_error);
+}
+
+TEST_F(HwcDevice, renders_the_fb_targets_of_both_displays_on_different_threads)
+{
+    using namespace testing;
+    NiceMock<mtd::MockSwappingGLContext> mock_context1;
+    NiceMock<mtd::MockSwappingGLContext> mock_context2;
+    ON_CALL(mock_context1, last_rendered_buffer())
+        .WillByDefault(Return(stub_fb_buffer));
+    ON_CALL(mock_context2, last_rendered_buffer())
+        .WillByDefault(Return(stub_fb_buffer));
+    mtd::MockRenderableListCompositor mock_compositor1;
+    mtd::MockRenderableListCompositor mock_compositor2;
+    std::thread::id primary_thread;
+    std::thread::id external_thread;
+
+    EXPECT_CALL(mock_compositor1, render(renderlist, _, _, Ref(mock_context1)))
+        .WillOnce(InvokeWithoutArgs([&] { primary_thread = std::this_thread::get_id(); }));
+    EXPECT_CALL(mock_compositor2, render(renderlist, _, _, Ref(mock_context2)))
+        .WillOnce(InvokeWithoutArgs([&] { external_thread = std::this_thread::get_id(); }));
+
+    mga::LayerList primary_list(layer_adapter, renderlist, geom::Displacement{});
+    mga::LayerList external_list(layer_adapter, renderlist, geom::Displacement{});
+    mga::DisplayContents primary_content{
+        primary, primary_list, offset, mock_context1, mock_compositor1};
+    mga::DisplayContents external_content{
+        mga::DisplayName::external, external_list, offset, mock_context2, mock_compositor2};
+
+    mga::HwcDevice device(mock_device, mock_report);
+    device.commit({primary_content, external_content});
+
+    EXPECT_THAT(primary_thread, Ne(external_thread));
 }
@@ -106,6 +106,8 @@ public:
             .WillByDefault(Return(display_transform_uniform_loc));
         ON_CALL(mock_gl, glGetUniformLocation(_, StrEq("tex")))
             .WillByDefault(Return(tex_uniform_loc));
+        ON_CALL(mock_gl, glGetUniformLocation(_, StrEq("alpha")))
+            .WillByDefault(Return(alpha_uniform_loc));
         ON_CALL(mock_gl, glGetAttribLocation(_, StrEq("position")))
             .WillByDefault(Return(position_attr_loc));
         ON_CALL(mock_gl, glGetAttribLocation(_, StrEq("texcoord")))
@@ -120,6 +122,7 @@ public:
     GLint const texcoord_attr_loc{3};
     GLint const tex_uniform_loc{4};
     GLint const texid{5};
+    GLint const alpha_uniform_loc{6};
     size_t const stride{sizeof(mgl::Vertex)};
 
     testing::NiceMock<MockGLProgramFactory> mock_gl_program_factory;
@@ -143,6 +146,8 @@ TEST_F(HWCFallbackGLRenderer, compiles_and_sets_up_gl_program)
     EXPECT_CALL(mock_gl, glGetAttribLocation(_, StrEq("texcoord")));
     EXPECT_CALL(mock_gl, glGetUniformLocation(_, StrEq("tex")));
     EXPECT_CALL(mock_gl, glUniform1i(tex_uniform_loc, 0));
+    EXPECT_CALL(mock_gl, glGetUniformLocation(_, StrEq("alpha")));
+    EXPECT_CALL(mock_gl, glUniform1f(alpha_uniform_loc, FloatEq(1.0f)));
     EXPECT_CALL(mock_gl, glUseProgram(0));
     EXPECT_CALL(mock_context, release_current());
 
@@ -240,7 +245,7 @@ TEST_F(HWCFallbackGLRenderer, computes_vertex_coordinates_correctly)
         .Times(1);
 
     mga::HWCFallbackGLRenderer glprogram(mock_gl_program_factory, mock_context, dummy_screen_pos);
-    glprogram.render(renderlist, offset, mock_swapping_context);
+    glprogram.render(renderlist, offset, {}, mock_swapping_context);
 }
 
 TEST_F(HWCFallbackGLRenderer, computes_vertex_coordinates_correctly_with_offset)
@@ -265,7 +270,7 @@ TEST_F(HWCFallbackGLRenderer, computes_vertex_coordinates_correctly_with_offset)
         .Times(1);
 
     mga::HWCFallbackGLRenderer glprogram(mock_gl_program_factory, mock_context, dummy_screen_pos);
-    glprogram.render(renderlist, offset, mock_swapping_context);
+    glprogram.render(renderlist, offset, {}, mock_swapping_context);
 }
 
 TEST_F(HWCFallbackGLRenderer, computes_texture_coordinates_correctly)
@@ -292,7 +297,7 @@ TEST_F(HWCFallbackGLRenderer, computes_texture_coordinates_correctly)
         .Times(2);
 
     mga::HWCFallbackGLRenderer glprogram(mock_gl_program_factory, mock_context, dummy_screen_pos);
-    glprogram.render(renderlist, offset, mock_swapping_context);
+    glprogram.render(renderlist, offset, {}, mock_swapping_context);
 }
 
 TEST_F(HWCFallbackGLRenderer, executes_render_in_sequence)
@@ -337,7 +342,7 @@ TEST_F(HWCFallbackGLRenderer, executes_render_in_sequence)
     EXPECT_CALL(mock_swapping_context, swap_buffers());
     EXPECT_CALL(mock_gl, glUseProgram(0));
 
-    glprogram.render(renderlist, offset, mock_swapping_context);
+    glprogram.render(renderlist, offset, {}, mock_swapping_context);
 }
 
 TEST_F(HWCFallbackGLRenderer, activates_alpha_per_renderable)
@@ -356,5 +361,170 @@ TEST_F(HWCFallbackGLRenderer, activates_alpha_per_renderable)
     EXPECT_CALL(mock_gl, glDisable(GL_BLEND));
     EXPECT_CALL(mock_gl, glEnable(GL_BLEND));
 
-    glprogram.render(renderlist, offset, mock_swapping_context);
+    glprogram.render(renderlist, offset, {}, mock_swapping_context);
+}
+
+TEST_F(HWCFallbackGLRenderer, applies_plane_alpha_per_renderable)
+{
+    using namespace testing;
+    auto translucent = std::make_shared<mtd::PlaneAlphaRenderable>();
+    mg::RenderableList renderlist{
+        translucent,
+        std::make_shared<mtd::StubRenderable>()
+    };
+
+    mga::HWCFallbackGLRenderer glprogram(mock_gl_program_factory, mock_context, dummy_screen_pos);
+
+    InSequence seq;
+    EXPECT_CALL(mock_gl, glEnable(GL_BLEND));
+    EXPECT_CALL(mock_gl, glUniform1f(alpha_uniform_loc, FloatEq(translucent->alpha())));
+    EXPECT_CALL(mock_gl, glDisable(GL_BLEND));
+    EXPECT_CALL(mock_gl, glUniform1f(alpha_uniform_loc, FloatEq(1.0f)));
+
+    glprogram.render(renderlist, offset, {}, mock_swapping_context);
+}
+
+TEST_F(HWCFallbackGLRenderer, rotates_output_when_transformed)
+{
+    using namespace testing;
+    geom::Size const view_size{400, 500};
+    glm::mat2 const rotate_left(0, 1, -1, 0);
+    float inv_w = 2.0/view_size.width.as_int();
+    float inv_h = 2.0/view_size.height.as_int() * -1.0;
+
+    //rotate_left * ortho(view_size)
+    float expected_matrix[]{
+        0.0   , inv_w , 0.0, 0.0,
+        -inv_h, 0.0   , 0.0, 0.0,
+        0.0   , 0.0   , 1.0, 0.0,
+        -1.0  , -1.0  , 0.0, 1.0
+    };
+
+    mga::HWCFallbackGLRenderer glprogram(mock_gl_program_factory, mock_context, dummy_screen_pos);
+    glprogram.set_transformation(rotate_left, view_size);
+
+    EXPECT_CALL(mock_gl, glUniformMatrix4fv(
+        display_transform_uniform_loc, 1, GL_FALSE, Matches4x4Matrix(expected_matrix)))
+        .Times(1);
+    glprogram.render({}, offset, {}, mock_swapping_context);
+    glprogram.render({}, offset, {}, mock_swapping_context);
+}
+
+TEST_F(HWCFallbackGLRenderer, redraws_only_damaged_area_of_aged_framebuffer)
+{
+    using namespace testing;
+    geom::Rectangle rect1{{100,200},{50, 60}};
+    geom::Rectangle rect2{{150,250},{150, 90}};
+    auto renderable1 = std::make_shared<mtd::StubRenderable>(rect1);
+    auto renderable2 = std::make_shared<mtd::StubRenderable>(rect2);
+    mg::RenderableList renderlist{renderable1, renderable2};
+    ON_CALL(mock_swapping_context, buffer_age())
+        .WillByDefault(Return(1u));
+
+    mga::HWCFallbackGLRenderer glprogram(mock_gl_program_factory, mock_context, dummy_screen_pos);
+
+    EXPECT_CALL(mock_gl, glScissor(_,_,_,_))
+        .Times(0);
+    EXPECT_CALL(mock_gl, glDrawArrays(_,_,_))
+        .Times(2);
+    EXPECT_CALL(mock_swapping_context, swap_buffers());
+    glprogram.render(renderlist, offset, {}, mock_swapping_context);
+    Mock::VerifyAndClearExpectations(&mock_gl);
+    Mock::VerifyAndClearExpectations(&mock_swapping_context);
+
+    renderable2->set_buffer(std::make_shared<mtd::StubBuffer>());
+    EXPECT_CALL(mock_gl, glEnable(_))
+        .Times(AnyNumber());
+    EXPECT_CALL(mock_gl, glDisable(_))
+        .Times(AnyNumber());
+    int const gl_y = dummy_screen_pos.size.height.as_int() - rect2.bottom_right().y.as_int();
+    EXPECT_CALL(mock_gl, glEnable(GL_SCISSOR_TEST));
+    EXPECT_CALL(mock_gl, glScissor(
+        rect2.top_left.x.as_int(), gl_y, rect2.size.width.as_int(), rect2.size.height.as_int()));
+    EXPECT_CALL(mock_gl, glDrawArrays(_,_,_))
+        .Times(1);
+    EXPECT_CALL(mock_gl, glDisable(GL_SCISSOR_TEST));
+    EXPECT_CALL(mock_swapping_context, swap_buffers_with_damage(rect2));
+    EXPECT_CALL(mock_swapping_context, swap_buffers())
+        .Times(0);
+    glprogram.render(renderlist, offset, {}, mock_swapping_context);
+}
+
+TEST_F(HWCFallbackGLRenderer, redraws_everything_until_damage_history_covers_buffer_age)
+{
+    using namespace testing;
+    mg::RenderableList renderlist{std::make_shared<mtd::StubRenderable>(geom::Rectangle{{1,2},{3,4}})};
+    ON_CALL(mock_swapping_context, buffer_age())
+        .WillByDefault(Return(2u));
+
+    mga::HWCFallbackGLRenderer glprogram(mock_gl_program_factory, mock_context, dummy_screen_pos);
+
+    EXPECT_CALL(mock_swapping_context, swap_buffers())
+        .Times(2);
+    glprogram.render(renderlist, offset, {}, mock_swapping_context);
+    glprogram.render(renderlist, offset, {}, mock_swapping_context);
+    Mock::VerifyAndClearExpectations(&mock_swapping_context);
+
+    EXPECT_CALL(mock_swapping_context, swap_buffers_with_damage(_));
+    glprogram.render(renderlist, offset, {}, mock_swapping_context);
+    Mock::VerifyAndClearExpectations(&mock_swapping_context);
+
+    glprogram.invalidate_damage();
+    EXPECT_CALL(mock_swapping_context, swap_buffers());
+    glprogram.render(renderlist, offset, {}, mock_swapping_context);
+}
+
+TEST_F(HWCFallbackGLRenderer, does_not_clear_under_opaque_renderables)
+{
+    using namespace testing;
+    mg::RenderableList renderlist{std::make_shared<mtd::StubRenderable>(dummy_screen_pos)};
+
+    mga::HWCFallbackGLRenderer glprogram(mock_gl_program_factory, mock_context, dummy_screen_pos);
+
+    EXPECT_CALL(mock_gl, glClear(_))
+        .Times(0);
+    EXPECT_CALL(mock_gl, glDrawArrays(_,_,_))
+        .Times(1);
+    glprogram.render(renderlist, offset, {}, mock_swapping_context);
+}
+
+TEST_F(HWCFallbackGLRenderer, clears_only_outside_of_overlaid_areas)
+{
+    using namespace testing;
+    geom::Rectangle const right_half{{250,0},{250,400}};
+    mg::RenderableList renderlist{std::make_shared<mtd::StubRenderable>(geom::Rectangle{{0,0},{10,10}})};
+
+    mga::HWCFallbackGLRenderer glprogram(mock_gl_program_factory, mock_context, dummy_screen_pos);
+
+    EXPECT_CALL(mock_gl, glEnable(GL_BLEND))
+        .Times(AnyNumber());
+    EXPECT_CALL(mock_gl, glDisable(GL_BLEND))
+        .Times(AnyNumber());
+    InSequence seq;
+    EXPECT_CALL(mock_gl, glEnable(GL_SCISSOR_TEST));
+    EXPECT_CALL(mock_gl, glScissor(0, 0, 250, 400));
+    EXPECT_CALL(mock_gl, glClear(GL_COLOR_BUFFER_BIT));
+    EXPECT_CALL(mock_gl, glDisable(GL_SCISSOR_TEST));
+    EXPECT_CALL(mock_gl, glDrawArrays(_,_,_));
+    EXPECT_CALL(mock_swapping_context, swap_buffers());
+    glprogram.render(renderlist, offset, {right_half}, mock_swapping_context);
+}
+
+TEST_F(HWCFallbackGLRenderer, redraws_and_clears_an_area_that_stops_being_overlaid)
+{
+    using namespace testing;
+    geom::Rectangle const right_half{{250,0},{250,400}};
+    mg::RenderableList renderlist{std::make_shared<mtd::StubRenderable>(geom::Rectangle{{0,0},{10,10}})};
+    ON_CALL(mock_swapping_context, buffer_age())
+        .WillByDefault(Return(1u));
+
+    mga::HWCFallbackGLRenderer glprogram(mock_gl_program_factory, mock_context, dummy_screen_pos);
+    glprogram.render(renderlist, offset, {right_half}, mock_swapping_context);
+    Mock::VerifyAndClearExpectations(&mock_gl);
+
+    EXPECT_CALL(mock_gl, glScissor(250, 0, 250, 400))
+        .Times(AtLeast(1));
+    EXPECT_CALL(mock_gl, glClear(GL_COLOR_BUFFER_BIT));
+    EXPECT_CALL(mock_swapping_context, swap_buffers_with_damage(right_half));
+    glprogram.render(renderlist, offset, {}, mock_swapping_context);
 }
@@ -17,6 +17,7 @@
  */
 
 #include "mir/test/doubles/stub_renderable.h"
+#include "mir/test/doubles/mock_renderable.h"
 #include "mir/test/doubles/stub_buffer.h"
 #include "mir/test/doubles/stub_android_native_buffer.h"
 #include "src/platforms/android/server/hwc_layerlist.h"
@@ -249,3 +250,202 @@ TEST_F(LayerListTest, list_is_offset_for_nonorigin_displays)
     EXPECT_THAT(l->hwLayers[l->numHwLayers-2], MatchesLegacyLayer(expected_layer));
     EXPECT_THAT(l->hwLayers[l->numHwLayers-1], MatchesLegacyLayer(fbtarget));
 }
+
+TEST_F(LayerListTest, rotates_layers_onto_the_framebuffer)
+{
+    using namespace testing;
+    glm::mat2 const rotate_left(0, 1, -1, 0);
+    geom::Size const view_size{400, 200};
+    geom::Rectangle const position{{10, 20}, {30, 40}};
+    mg::RenderableList renderable_list {std::make_shared<mtd::StubRenderable>(buffer1, position)};
+
+    mga::LayerList list(layer_adapter, {}, offset);
+    list.set_transformation(rotate_left, view_size);
+    list.update_list(renderable_list, offset);
+
+    //the top left corner of the view is at the bottom left of the framebuffer
+    hwc_rect_t const expected_frame{20, 360, 60, 390};
+    auto l = list.native_list();
+    ASSERT_THAT(l->numHwLayers, Eq(2u));
+    EXPECT_THAT(l->hwLayers[0].displayFrame, MatchesRect(expected_frame, "displayFrame"));
+    EXPECT_THAT(l->hwLayers[0].transform, Eq(static_cast<uint32_t>(HWC_TRANSFORM_ROT_270)));
+}
+
+TEST_F(LayerListTest, only_flags_geometry_changes_when_layers_move)
+{
+    using namespace testing;
+    geom::Rectangle const position{{10, 20}, {30, 40}};
+    auto renderable = std::make_shared<mtd::StubRenderable>(buffer1, position);
+    mga::LayerList list(layer_adapter, {renderable}, offset);
+    list.setup_fb(stub_fb);
+    EXPECT_THAT(list.native_list()->flags, Eq(static_cast<uint32_t>(HWC_GEOMETRY_CHANGED)));
+    list.set_occurred();
+    EXPECT_THAT(list.native_list()->flags, Eq(0u));
+
+    list.update_list({renderable}, offset);
+    list.setup_fb(stub_fb);
+    EXPECT_THAT(list.native_list()->flags, Eq(0u));
+
+    list.update_list({std::make_shared<mtd::StubRenderable>(buffer1, geom::Rectangle{{11, 20}, {30, 40}})}, offset);
+    EXPECT_THAT(list.native_list()->flags, Eq(static_cast<uint32_t>(HWC_GEOMETRY_CHANGED)));
+    list.set_occurred();
+
+    list.update_list({renderable, renderable}, offset);
+    EXPECT_THAT(list.native_list()->flags, Eq(static_cast<uint32_t>(HWC_GEOMETRY_CHANGED)));
+}
+
+TEST_F(LayerListTest, keeps_the_prepared_composition_until_the_geometry_changes)
+{
+    using namespace testing;
+    geom::Rectangle const position{{10, 20}, {30, 40}};
+    auto renderable = std::make_shared<mtd::StubRenderable>(buffer1, position);
+    mga::LayerList list(layer_adapter, {renderable}, offset);
+    list.setup_fb(stub_fb);
+    auto const native_list = list.native_list();
+    native_list->hwLayers[0].compositionType = HWC_OVERLAY;
+    list.prepare_occurred();
+    list.set_occurred();
+
+    //without HWC_GEOMETRY_CHANGED, the hwc does not set the composition types again
+    renderable->set_buffer(buffer2);
+    list.update_list({renderable}, offset);
+    list.setup_fb(stub_fb);
+    EXPECT_THAT(native_list->flags, Eq(0u));
+    EXPECT_THAT(native_list->hwLayers[0].compositionType, Eq(HWC_OVERLAY));
+    EXPECT_THAT(native_list->hwLayers[1].compositionType, Eq(HWC_FRAMEBUFFER_TARGET));
+    list.set_occurred();
+
+    list.update_list({std::make_shared<mtd::StubRenderable>(buffer1, geom::Rectangle{{11, 20}, {30, 40}})}, offset);
+    list.setup_fb(stub_fb);
+    EXPECT_THAT(native_list->flags, Eq(static_cast<uint32_t>(HWC_GEOMETRY_CHANGED)));
+    EXPECT_THAT(native_list->hwLayers[0].compositionType, Eq(HWC_FRAMEBUFFER));
+    EXPECT_THAT(native_list->hwLayers[1].compositionType, Eq(HWC_FRAMEBUFFER_TARGET));
+}
+
+TEST_F(LayerListTest, culls_renderables_hidden_by_opaque_renderables)
+{
+    using namespace testing;
+    auto hidden = std::make_shared<mtd::StubRenderable>(buffer1, geom::Rectangle{{10, 10}, {20, 20}});
+    auto partially_hidden = std::make_shared<mtd::StubRenderable>(buffer2, geom::Rectangle{{0, 0}, {50, 40}});
+    auto fullscreen = std::make_shared<mtd::StubRenderable>(buffer3, geom::Rectangle{{0, 0}, {40, 40}});
+    auto translucent = std::make_shared<NiceMock<mtd::MockRenderable>>();
+    ON_CALL(*translucent, screen_position())
+        .WillByDefault(Return(geom::Rectangle{{0, 0}, {100, 100}}));
+    ON_CALL(*translucent, alpha())
+        .WillByDefault(Return(0.5f));
+
+    EXPECT_THAT(mga::visible_renderables({hidden, partially_hidden, fullscreen, translucent}),
+        ElementsAre(partially_hidden, fullscreen, translucent));
+}
+
+TEST_F(LayerListTest, visible_region_excludes_parts_under_opaque_layers)
+{
+    using namespace testing;
+    auto bottom = std::make_shared<mtd::StubRenderable>(buffer1, geom::Rectangle{{0, 0}, {100, 100}});
+    auto top = std::make_shared<mtd::StubRenderable>(buffer2, geom::Rectangle{{50, 0}, {50, 100}});
+    auto shaped = std::make_shared<NiceMock<mtd::MockRenderable>>();
+    ON_CALL(*shaped, screen_position())
+        .WillByDefault(Return(geom::Rectangle{{0, 0}, {10, 10}}));
+    ON_CALL(*shaped, shaped())
+        .WillByDefault(Return(true));
+    ON_CALL(*shaped, buffer())
+        .WillByDefault(Return(buffer3));
+
+    mga::LayerList list(layer_adapter, {bottom, top, shaped}, offset);
+    auto const& bottom_region = list.native_list()->hwLayers[0].visibleRegionScreen;
+    ASSERT_THAT(bottom_region.numRects, Eq(1u));
+    EXPECT_THAT(bottom_region.rects[0].left, Eq(0));
+    EXPECT_THAT(bottom_region.rects[0].top, Eq(0));
+    EXPECT_THAT(bottom_region.rects[0].right, Eq(50));
+    EXPECT_THAT(bottom_region.rects[0].bottom, Eq(100));
+
+    auto const& top_region = list.native_list()->hwLayers[1].visibleRegionScreen;
+    ASSERT_THAT(top_region.numRects, Eq(1u));
+    EXPECT_THAT(top_region.rects[0].left, Eq(50));
+    EXPECT_THAT(top_region.rects[0].right, Eq(100));
+}
+
+TEST_F(LayerListTest, squashes_static_bottom_layers_once_overlays_run_out)
+{
+    using namespace testing;
+    auto bottom = std::make_shared<mtd::StubRenderable>(buffer1, geom::Rectangle{{0, 0}, {10, 10}});
+    auto middle = std::make_shared<mtd::StubRenderable>(buffer2, geom::Rectangle{{10, 0}, {10, 10}});
+    auto top = std::make_shared<mtd::StubRenderable>(buffer3, geom::Rectangle{{20, 0}, {10, 10}});
+    mg::RenderableList const renderlist{bottom, middle, top};
+    auto const squashed = [](hwc_layer_1_t const& layer) { return (layer.flags & HWC_SKIP_LAYER) != 0; };
+    auto const new_buffer = []
+    {
+        return std::make_shared<mtd::StubBuffer>(std::make_shared<mtd::StubAndroidNativeBuffer>());
+    };
+
+    mga::LayerList list(layer_adapter, renderlist, offset);
+    for (auto i = 0; i < 3; i++)
+    {
+        top->set_buffer(new_buffer());
+        list.update_list(renderlist, offset);
+    }
+    EXPECT_FALSE(squashed(list.native_list()->hwLayers[0]));
+
+    //the hwc leaves two layers to gl
+    list.native_list()->hwLayers[2].compositionType = HWC_OVERLAY;
+    list.prepare_occurred();
+
+    top->set_buffer(new_buffer());
+    list.update_list(renderlist, offset);
+    EXPECT_TRUE(squashed(list.native_list()->hwLayers[0]));
+    EXPECT_TRUE(squashed(list.native_list()->hwLayers[1]));
+    EXPECT_FALSE(squashed(list.native_list()->hwLayers[2]));
+    list.native_list()->hwLayers[2].compositionType = HWC_OVERLAY;
+    EXPECT_THAT(list.rejected_renderables(), ElementsAre(bottom, middle));
+
+    middle->set_buffer(new_buffer());
+    list.update_list(renderlist, offset);
+    EXPECT_TRUE(squashed(list.native_list()->hwLayers[0]));
+    EXPECT_FALSE(squashed(list.native_list()->hwLayers[1]));
+    EXPECT_THAT(list.native_list()->flags & HWC_GEOMETRY_CHANGED, Ne(0u));
+}
+
+TEST_F(LayerListTest, puts_the_cursor_in_a_cursor_layer_under_the_fb_target)
+{
+    using namespace testing;
+    auto const cursor = std::make_shared<mtd::StubRenderable>(buffer3, geom::Rectangle{{5, 6}, {4, 4}});
+    mga::LayerList list(layer_adapter, {}, offset);
+    list.set_cursor(cursor);
+    list.update_list({renderables[0]}, offset);
+    list.setup_fb(stub_fb);
+
+    auto const native_list = list.native_list();
+    ASSERT_THAT(native_list->numHwLayers, Eq(3u));
+    EXPECT_THAT(native_list->hwLayers[1].flags, Eq(static_cast<uint32_t>(HWC_IS_CURSOR_LAYER)));
+    EXPECT_THAT(native_list->hwLayers[1].displayFrame, MatchesRect(hwc_rect_t{5, 6, 9, 10}, "displayFrame"));
+    EXPECT_THAT(native_list->hwLayers[2].compositionType, Eq(HWC_FRAMEBUFFER_TARGET));
+
+    //the hwc overlays the renderable, but leaves the cursor to gl
+    native_list->hwLayers[0].compositionType = HWC_OVERLAY;
+    list.prepare_occurred();
+    EXPECT_TRUE(list.cursor_rejected());
+    EXPECT_THAT(list.rejected_renderables(), ElementsAre(cursor));
+}
+
+TEST_F(LayerListTest, leaves_a_rejected_cursor_over_the_skip_layer_to_the_display_buffer)
+{
+    using namespace testing;
+    auto const cursor = std::make_shared<mtd::StubRenderable>(buffer3, geom::Rectangle{{5, 6}, {4, 4}});
+    mga::LayerList list(layer_adapter, {}, offset);
+    list.set_cursor(cursor);
+    list.update_list({}, offset);
+    list.setup_fb(stub_fb);
+
+    auto const native_list = list.native_list();
+    ASSERT_THAT(native_list->numHwLayers, Eq(3u));
+    EXPECT_THAT(native_list->hwLayers[0].flags, Eq(static_cast<uint32_t>(HWC_SKIP_LAYER)));
+    EXPECT_THAT(native_list->hwLayers[1].flags, Eq(static_cast<uint32_t>(HWC_IS_CURSOR_LAYER)));
+
+    list.prepare_occurred();
+    EXPECT_TRUE(list.cursor_rejected());
+    EXPECT_THAT(list.rejected_renderables(), IsEmpty());
+
+    native_list->hwLayers[1].compositionType = HWC_CURSOR_OVERLAY;
+    list.prepare_occurred();
+    EXPECT_FALSE(list.cursor_rejected());
+}
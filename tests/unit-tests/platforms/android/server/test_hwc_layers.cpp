@@ -116,7 +116,7 @@ TEST_F(HWCLayersTest, check_if_layer_needs_gl_render)
 
 TEST_F(HWCLayersTest, move_layer_positions)
 {
-    mga::HWCLayer layer(layer_adapter, list, list_index, type, screen_position, false, mock_buffer);
+    mga::HWCLayer layer(layer_adapter, list, list_index, type, screen_position, false, 1.0f, 0, mock_buffer);
     mga::HWCLayer second_layer(std::move(layer));
 
     EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
@@ -130,7 +130,7 @@ TEST_F(HWCLayersTest, change_layer_types)
     mga::HWCLayer layer(
         layer_adapter, list, list_index,
         mga::LayerType::framebuffer_target,
-        screen_position, alpha_enabled, mock_buffer);
+        screen_position, alpha_enabled, 1.0f, 0, mock_buffer);
     EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
 
     EXPECT_THROW({
@@ -138,21 +138,23 @@ TEST_F(HWCLayersTest, change_layer_types)
             mga::LayerType::overlay,
             screen_position,
             alpha_enabled,
+            1.0f,
+            0,
             mock_buffer);
     }, std::logic_error);
 
     expected_layer.compositionType = HWC_FRAMEBUFFER;
-    layer.setup_layer(mga::LayerType::gl_rendered, screen_position, alpha_enabled, mock_buffer);
+    layer.setup_layer(mga::LayerType::gl_rendered, screen_position, alpha_enabled, 1.0f, 0, mock_buffer);
     EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
 
     expected_layer.compositionType = HWC_FRAMEBUFFER;
     expected_layer.flags = HWC_SKIP_LAYER;
-    layer.setup_layer(mga::LayerType::skip, screen_position, alpha_enabled, mock_buffer);
+    layer.setup_layer(mga::LayerType::skip, screen_position, alpha_enabled, 1.0f, 0, mock_buffer);
     EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
 
     expected_layer.compositionType = HWC_FRAMEBUFFER;
     expected_layer.flags = 0;
-    layer.setup_layer(mga::LayerType::gl_rendered, screen_position, alpha_enabled, mock_buffer);
+    layer.setup_layer(mga::LayerType::gl_rendered, screen_position, alpha_enabled, 1.0f, 0, mock_buffer);
     EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
 }
 
@@ -168,7 +170,7 @@ TEST_F(HWCLayersTest, apply_buffer_updates_to_framebuffer_layer)
     expected_layer.acquireFenceFd = -1;
     expected_layer.releaseFenceFd = -1;
 
-    mga::HWCLayer layer(layer_adapter, list, list_index, type, screen_position, alpha_enabled, mock_buffer);
+    mga::HWCLayer layer(layer_adapter, list, list_index, type, screen_position, alpha_enabled, 1.0f, 0, mock_buffer);
 
     EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
 }
@@ -184,7 +186,7 @@ TEST_F(HWCLayersTest, apply_buffer_updates_to_overlay_layers)
     expected_layer.acquireFenceFd = -1;
     expected_layer.releaseFenceFd = -1;
 
-    mga::HWCLayer layer(layer_adapter, list, list_index, type, screen_position, alpha_enabled, mock_buffer);
+    mga::HWCLayer layer(layer_adapter, list, list_index, type, screen_position, alpha_enabled, 1.0f, 0, mock_buffer);
     hwc_layer->compositionType = HWC_OVERLAY;
     EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
 
@@ -213,7 +215,7 @@ TEST_F(HWCLayersTest, apply_buffer_updates_to_fbtarget)
     mga::HWCLayer layer(
         layer_adapter, list, list_index,
         mga::LayerType::framebuffer_target,
-        screen_position, alpha_enabled, mock_buffer);
+        screen_position, alpha_enabled, 1.0f, 0, mock_buffer);
 
     EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
 
@@ -235,6 +237,8 @@ TEST_F(HWCLayersTest, apply_buffer_updates_to_fbtarget)
         mga::LayerType::framebuffer_target,
         screen_position,
         false,
+        1.0f,
+        0,
         mock_buffer);
     EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
 }
@@ -247,7 +251,7 @@ TEST_F(HWCLayersTest, buffer_fence_updates)
     mga::HWCLayer layer(
         layer_adapter, list, list_index,
         mga::LayerType::framebuffer_target,
-        screen_position, alpha_enabled, mock_buffer);
+        screen_position, alpha_enabled, 1.0f, 0, mock_buffer);
 
     hwc_layer->releaseFenceFd = fake_fence;
     layer.release_buffer();
@@ -293,6 +297,8 @@ TEST_F(HWCLayersTest, check_layer_defaults_and_alpha)
         mga::LayerType::gl_rendered,
         screen_position,
         true,
+        1.0f,
+        0,
         mock_buffer);
     EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
 
@@ -301,6 +307,8 @@ TEST_F(HWCLayersTest, check_layer_defaults_and_alpha)
         mga::LayerType::gl_rendered,
         screen_position,
         false,
+        1.0f,
+        0,
         mock_buffer);
     EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
 }
@@ -345,6 +353,8 @@ TEST_F(HWCLayersTest, has_float_sourcecrop)
         mga::LayerType::gl_rendered,
         screen_position,
         true,
+        1.0f,
+        0,
         mock_buffer);
     EXPECT_THAT(*hwc_layer, MatchesLayer(expected_layer));
 }
@@ -391,6 +401,8 @@ TEST_F(HWCLayersTest, list_can_be_offset_for_nonorigin_displays)
         mga::LayerType::gl_rendered,
         screen_position,
         true,
+        1.0f,
+        0,
         mock_buffer);
     EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
 
@@ -399,6 +411,152 @@ TEST_F(HWCLayersTest, list_can_be_offset_for_nonorigin_displays)
         mga::LayerType::gl_rendered,
         screen_position,
         false,
+        1.0f,
+        0,
         mock_buffer);
     EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
 }
+
+//HWC 1.2 and later can fade a layer with planeAlpha
+TEST_F(HWCLayersTest, sets_plane_alpha_when_supported)
+{
+    float const alpha{0.5f};
+    expected_layer.blending = HWC_BLENDING_PREMULT;
+    expected_layer.planeAlpha = 128;
+
+    mga::HWCLayer layer(std::make_shared<mga::Hwc12Adapter>(), list, list_index);
+    layer.setup_layer(
+        mga::LayerType::gl_rendered,
+        screen_position,
+        false,
+        alpha,
+        0,
+        mock_buffer);
+    EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
+
+    expected_layer.blending = HWC_BLENDING_NONE;
+    expected_layer.planeAlpha = std::numeric_limits<decltype(hwc_layer_1_t::planeAlpha)>::max();
+    layer.setup_layer(
+        mga::LayerType::gl_rendered,
+        screen_position,
+        false,
+        1.0f,
+        0,
+        mock_buffer);
+    EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
+}
+
+TEST_F(HWCLayersTest, forces_translucent_layers_to_gl_when_plane_alpha_unsupported)
+{
+    expected_layer.blending = HWC_BLENDING_PREMULT;
+    expected_layer.flags = HWC_SKIP_LAYER;
+
+    mga::HWCLayer layer(layer_adapter, list, list_index);
+    layer.setup_layer(
+        mga::LayerType::gl_rendered,
+        screen_position,
+        false,
+        0.5f,
+        0,
+        mock_buffer);
+    EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
+    EXPECT_TRUE(layer.needs_gl_render());
+}
+
+TEST_F(HWCLayersTest, sets_transform)
+{
+    expected_layer.transform = HWC_TRANSFORM_ROT_270;
+
+    mga::HWCLayer layer(layer_adapter, list, list_index);
+    layer.setup_layer(
+        mga::LayerType::gl_rendered,
+        screen_position,
+        false,
+        1.0f,
+        HWC_TRANSFORM_ROT_270,
+        mock_buffer);
+    EXPECT_THAT(*hwc_layer, MatchesLegacyLayer(expected_layer));
+}
+
+TEST_F(HWCLayersTest, converts_display_rotations_to_hwc_transforms)
+{
+    glm::mat2 const rotate_none(1, 0, 0, 1);
+    glm::mat2 const rotate_left(0, 1, -1, 0);
+    glm::mat2 const rotate_right(0, -1, 1, 0);
+    glm::mat2 const rotate_inverted(-1, 0, 0, -1);
+    glm::mat2 const rotate_45(0.7071f, 0.7071f, -0.7071f, 0.7071f);
+
+    EXPECT_EQ(0u, mga::as_hwc_transform(rotate_none));
+    EXPECT_EQ(static_cast<uint32_t>(HWC_TRANSFORM_ROT_270), mga::as_hwc_transform(rotate_left));
+    EXPECT_EQ(static_cast<uint32_t>(HWC_TRANSFORM_ROT_90), mga::as_hwc_transform(rotate_right));
+    EXPECT_EQ(static_cast<uint32_t>(HWC_TRANSFORM_ROT_180), mga::as_hwc_transform(rotate_inverted));
+    EXPECT_FALSE(mga::is_hwc_transform(rotate_45));
+    EXPECT_THROW({
+        mga::as_hwc_transform(rotate_45);
+    }, std::logic_error);
+}
+
+TEST_F(HWCLayersTest, reports_no_surface_damage_for_unchanged_layers_on_hwc15)
+{
+    using namespace testing;
+    auto const native_handle_2 = std::make_shared<NiceMock<mtd::MockAndroidNativeBuffer>>(buffer_size);
+    auto const buffer2 = std::make_shared<NiceMock<mtd::MockBuffer>>();
+    ON_CALL(*buffer2, size())
+        .WillByDefault(Return(buffer_size));
+    ON_CALL(*buffer2, native_buffer_handle())
+        .WillByDefault(Return(native_handle_2));
+
+    mga::HWCLayer layer(std::make_shared<mga::Hwc15Adapter>(), list, list_index);
+    layer.setup_layer(mga::LayerType::gl_rendered, screen_position, false, 1.0f, 0, mock_buffer);
+    EXPECT_THAT(hwc_layer->surfaceDamage.numRects, Eq(0u));
+
+    layer.setup_layer(mga::LayerType::gl_rendered, screen_position, false, 1.0f, 0, mock_buffer);
+    hwc_rect_t const empty{0, 0, 0, 0};
+    ASSERT_THAT(hwc_layer->surfaceDamage.numRects, Eq(1u));
+    EXPECT_THAT(hwc_layer->surfaceDamage.rects[0], MatchesRect(empty, "surfaceDamage"));
+
+    layer.setup_layer(mga::LayerType::gl_rendered, screen_position, false, 1.0f, 0, buffer2);
+    EXPECT_THAT(hwc_layer->surfaceDamage.numRects, Eq(0u));
+}
+
+TEST_F(HWCLayersTest, always_reports_full_damage_before_hwc15)
+{
+    using namespace testing;
+    mga::HWCLayer layer(std::make_shared<mga::FloatSourceCrop>(), list, list_index);
+    layer.setup_layer(mga::LayerType::gl_rendered, screen_position, false, 1.0f, 0, mock_buffer);
+    layer.setup_layer(mga::LayerType::gl_rendered, screen_position, false, 1.0f, 0, mock_buffer);
+    EXPECT_THAT(hwc_layer->surfaceDamage.numRects, Eq(0u));
+}
+
+TEST_F(HWCLayersTest, crops_the_source_of_layers_that_are_clipped)
+{
+    using namespace testing;
+    //the buffer is scaled to twice its width, and a quarter of it hangs off the left of the display
+    geom::Rectangle const position{{-166, 0}, {666, 444}};
+    geom::Rectangle const display{{0, 0}, {1000, 1000}};
+    hwc_frect_t const expected_crop{83.0f, 0.0f, 333.0f, 444.0f};
+    hwc_rect_t const expected_frame{0, 0, 500, 444};
+
+    mga::HWCLayer layer(std::make_shared<mga::FloatSourceCrop>(), list, list_index);
+    layer.setup_layer(mga::LayerType::gl_rendered, position, display, false, 1.0f, 0, mock_buffer);
+    EXPECT_THAT(hwc_layer->sourceCropf, MatchesRectf(expected_crop, "sourceCrop"));
+    EXPECT_THAT(hwc_layer->displayFrame, MatchesRect(expected_frame, "displayFrame"));
+
+    hwc_rect_t const expected_int_crop{83, 0, 333, 444};
+    mga::HWCLayer int_layer(layer_adapter, list, list_index);
+    int_layer.setup_layer(mga::LayerType::gl_rendered, position, display, false, 1.0f, 0, mock_buffer);
+    EXPECT_THAT(hwc_layer->sourceCropi, MatchesRect(expected_int_crop, "sourceCrop"));
+}
+
+TEST_F(HWCLayersTest, maps_clipped_edges_back_through_the_layer_transform)
+{
+    using namespace testing;
+    //rotated clockwise, the bottom of the buffer is on the left of the screen
+    geom::Rectangle const position{{-111, 0}, {444, 333}};
+    geom::Rectangle const display{{0, 0}, {1000, 1000}};
+    hwc_frect_t const expected_crop{0.0f, 0.0f, 333.0f, 333.0f};
+
+    mga::HWCLayer layer(std::make_shared<mga::FloatSourceCrop>(), list, list_index);
+    layer.setup_layer(mga::LayerType::gl_rendered, position, display, false, 1.0f, HWC_TRANSFORM_ROT_90, mock_buffer);
+    EXPECT_THAT(hwc_layer->sourceCropf, MatchesRectf(expected_crop, "sourceCrop"));
+}
@@ -206,6 +206,26 @@ TEST_F(HwcLogger, report_optimization)
     EXPECT_EQ(disabled_str.str(), test_stream.str()); 
 }
 
+TEST_F(HwcLogger, report_prepare_skipped)
+{
+    std::stringstream str;
+    str << "HWC: prepare() skipped, list unchanged" << std::endl;
+
+    mga::HwcFormattedLogger logger;
+    logger.report_prepare_skipped();
+    EXPECT_EQ(str.str(), test_stream.str());
+}
+
+TEST_F(HwcLogger, report_frame_elided)
+{
+    std::stringstream str;
+    str << "HWC: frame elided, nothing changed" << std::endl;
+
+    mga::HwcFormattedLogger logger;
+    logger.report_frame_elided();
+    EXPECT_EQ(str.str(), test_stream.str());
+}
+
 TEST_F(HwcLogger, report_vsync_on)
 {
     std::stringstream str;
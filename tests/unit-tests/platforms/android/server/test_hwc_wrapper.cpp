@@ -22,6 +22,12 @@
 #include "mir/test/doubles/mock_hwc_report.h"
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace mg = mir::graphics;
 namespace mga = mir::graphics::android;
@@ -366,3 +372,217 @@ TEST_F(HwcWrapper, callback_calls_hwcvsync_and_can_continue_calling_after_destru
 
     EXPECT_THAT(call_count, Eq(1u));
 }
+
+TEST_F(HwcWrapper, hands_out_vsyncs_off_the_hwc_thread)
+{
+    using namespace testing;
+    mga::HwcCallbacks const* callbacks{nullptr};
+    EXPECT_CALL(*mock_device, registerProcs_interface(mock_device.get(),_))
+        .WillOnce(Invoke([&](struct hwc_composer_device_1*, hwc_procs_t const* procs)
+            {callbacks = reinterpret_cast<mga::HwcCallbacks const*>(procs);}));
+
+    mga::RealHwcWrapper wrapper(mock_device, mock_report);
+    std::thread::id vsync_thread;
+    mg::Frame::Timestamp vsync_time;
+    std::promise<void> vsync_handed_out;
+    wrapper.subscribe_to_events(this,
+        [&](mga::DisplayName, mg::Frame::Timestamp timestamp)
+        {
+            vsync_thread = std::this_thread::get_id();
+            vsync_time = timestamp;
+            vsync_handed_out.set_value();
+        },
+        [](mga::DisplayName, bool){},
+        []{});
+
+    callbacks->hooks.vsync(&callbacks->hooks, 0, 33223);
+    vsync_handed_out.get_future().wait();
+    wrapper.unsubscribe_from_events(this);
+
+    EXPECT_THAT(vsync_thread, Ne(std::thread::id{}));
+    EXPECT_THAT(vsync_thread, Ne(std::this_thread::get_id()));
+    EXPECT_THAT(vsync_time.nanoseconds, Eq(std::chrono::nanoseconds{33223}));
+}
+
+//a callback counts as an event being handed out, which (un)subscribing would otherwise wait for
+TEST_F(HwcWrapper, callbacks_on_any_hook_thread_can_unsubscribe)
+{
+    using namespace testing;
+    mga::HwcCallbacks const* callbacks{nullptr};
+    EXPECT_CALL(*mock_device, registerProcs_interface(mock_device.get(),_))
+        .WillOnce(Invoke([&](struct hwc_composer_device_1*, hwc_procs_t const* procs)
+            {callbacks = reinterpret_cast<mga::HwcCallbacks const*>(procs);}));
+
+    mga::RealHwcWrapper wrapper(mock_device, mock_report);
+    int hotplugs{0};
+    int invalidates{0};
+    std::promise<void> vsync_unsubscribed;
+    auto const subscribe = [&]
+    {
+        wrapper.subscribe_to_events(this,
+            [&](mga::DisplayName, mg::Frame::Timestamp)
+            {
+                wrapper.unsubscribe_from_events(this);
+                vsync_unsubscribed.set_value();
+            },
+            [&](mga::DisplayName, bool)
+            {
+                hotplugs++;
+                wrapper.unsubscribe_from_events(this);
+            },
+            [&]
+            {
+                invalidates++;
+                wrapper.unsubscribe_from_events(this);
+            });
+    };
+
+    subscribe();
+    callbacks->hooks.hotplug(&callbacks->hooks, 0, 1);
+    callbacks->hooks.hotplug(&callbacks->hooks, 0, 1);
+    EXPECT_THAT(hotplugs, Eq(1));
+
+    subscribe();
+    callbacks->hooks.invalidate(&callbacks->hooks);
+    callbacks->hooks.invalidate(&callbacks->hooks);
+    EXPECT_THAT(invalidates, Eq(1));
+
+    subscribe();
+    callbacks->hooks.vsync(&callbacks->hooks, 0, 0);
+    vsync_unsubscribed.get_future().wait();
+    callbacks->hooks.hotplug(&callbacks->hooks, 0, 1);
+    EXPECT_THAT(hotplugs, Eq(1));
+}
+
+TEST_F(HwcWrapper, unsubscribing_waits_for_a_callback_running_on_another_thread)
+{
+    using namespace testing;
+    mga::HwcCallbacks const* callbacks{nullptr};
+    EXPECT_CALL(*mock_device, registerProcs_interface(mock_device.get(),_))
+        .WillOnce(Invoke([&](struct hwc_composer_device_1*, hwc_procs_t const* procs)
+            {callbacks = reinterpret_cast<mga::HwcCallbacks const*>(procs);}));
+
+    mga::RealHwcWrapper wrapper(mock_device, mock_report);
+    std::promise<void> invalidate_started;
+    std::promise<void> finish_invalidate;
+    std::atomic<bool> invalidate_done{false};
+    wrapper.subscribe_to_events(this,
+        [](mga::DisplayName, mg::Frame::Timestamp){},
+        [](mga::DisplayName, bool){},
+        [&]
+        {
+            invalidate_started.set_value();
+            finish_invalidate.get_future().wait();
+            invalidate_done = true;
+        });
+
+    std::thread hook_thread{[&] { callbacks->hooks.invalidate(&callbacks->hooks); }};
+    invalidate_started.get_future().wait();
+    std::thread finisher{[&]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+        finish_invalidate.set_value();
+    }};
+    wrapper.unsubscribe_from_events(this);
+    EXPECT_TRUE(invalidate_done);
+
+    finisher.join();
+    hook_thread.join();
+}
+
+TEST_F(HwcWrapper, moves_cursor_asynchronously_on_hwc14)
+{
+    using namespace testing;
+    mock_device->common.version = HWC_DEVICE_API_VERSION_1_4;
+    EXPECT_CALL(*mock_device, setCursorPositionAsync_interface(mock_device.get(), HWC_DISPLAY_PRIMARY, 12, 34))
+        .WillOnce(Return(0));
+
+    mga::RealHwcWrapper wrapper(mock_device, mock_report);
+    EXPECT_TRUE(wrapper.set_cursor_position(mga::DisplayName::primary, {12, 34}));
+}
+
+TEST_F(HwcWrapper, cannot_move_cursor_asynchronously_before_hwc14)
+{
+    using namespace testing;
+    EXPECT_CALL(*mock_device, setCursorPositionAsync_interface(_,_,_,_))
+        .Times(0);
+
+    mga::RealHwcWrapper wrapper(mock_device, mock_report);
+    EXPECT_FALSE(wrapper.set_cursor_position(mga::DisplayName::primary, {12, 34}));
+}
+
+TEST_F(HwcWrapper, changes_the_config_once_the_frame_being_set_is_done)
+{
+    using namespace testing;
+    ON_CALL(*mock_device, getDisplayConfigs_interface(_, HWC_DISPLAY_PRIMARY, _, _))
+        .WillByDefault(Invoke([](struct hwc_composer_device_1*, int, uint32_t* configs, size_t* num_configs)
+        {
+            configs[0] = 7;
+            *num_configs = 1;
+            return 0;
+        }));
+
+    std::promise<void> set_started;
+    std::atomic<bool> set_done{false};
+    EXPECT_CALL(*mock_device, set_interface(_,_,_))
+        .WillOnce(Invoke([&](struct hwc_composer_device_1*, size_t, hwc_display_contents_1_t**)
+        {
+            set_started.set_value();
+            std::this_thread::sleep_for(std::chrono::milliseconds{20});
+            set_done = true;
+            return 0;
+        }));
+    bool changed_after_set{false};
+    EXPECT_CALL(*mock_device, setActiveConfig_interface(mock_device.get(), HWC_DISPLAY_PRIMARY, 0))
+        .WillOnce(Invoke([&](struct hwc_composer_device_1*, int, int)
+        {
+            changed_after_set = set_done;
+            return 0;
+        }));
+
+    mga::RealHwcWrapper wrapper(mock_device, mock_report);
+    std::thread commit_thread{[&] { wrapper.set(primary_displays); }};
+    set_started.get_future().wait();
+    wrapper.set_active_config(mga::DisplayName::primary, mga::ConfigId{7});
+    commit_thread.join();
+
+    EXPECT_TRUE(changed_after_set);
+}
+
+TEST_F(HwcWrapper, does_not_come_between_a_prepared_frame_and_its_set)
+{
+    using namespace testing;
+    std::vector<std::string> calls;
+    std::mutex calls_mutex;
+    auto const record = [&](std::string const& call)
+    {
+        std::lock_guard<std::mutex> lk(calls_mutex);
+        calls.push_back(call);
+        return 0;
+    };
+    ON_CALL(*mock_device, prepare_interface(_,_,_))
+        .WillByDefault(InvokeWithoutArgs([&] { return record("prepare"); }));
+    ON_CALL(*mock_device, set_interface(_,_,_))
+        .WillByDefault(InvokeWithoutArgs([&] { return record("set"); }));
+    ON_CALL(*mock_device, eventControl_interface(_,_,_,_))
+        .WillByDefault(InvokeWithoutArgs([&] { return record("eventControl"); }));
+    ON_CALL(*mock_device, blank_interface(_,_,_))
+        .WillByDefault(InvokeWithoutArgs([&] { return record("blank"); }));
+
+    mga::RealHwcWrapper wrapper(mock_device, mock_report);
+    wrapper.prepare(primary_displays);
+
+    std::promise<void> started;
+    std::thread other_thread{[&]
+        {
+            started.set_value();
+            wrapper.vsync_signal_off(mga::DisplayName::primary);
+            wrapper.display_off(mga::DisplayName::primary);
+        }};
+    started.get_future().wait();
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    wrapper.set(primary_displays);
+    other_thread.join();
+
+    EXPECT_THAT(calls, ElementsAre("prepare", "set", "eventControl", "blank"));
+}
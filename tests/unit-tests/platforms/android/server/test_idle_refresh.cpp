@@ -0,0 +1,73 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/platforms/android/server/idle_refresh.h"
+#include "mir/test/doubles/mock_hwc_device_wrapper.h"
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <future>
+#include <thread>
+
+namespace mga=mir::graphics::android;
+namespace mtd=mir::test::doubles;
+
+namespace
+{
+struct IdleRefresh : testing::Test
+{
+    std::shared_ptr<testing::NiceMock<mtd::MockHWCDeviceWrapper>> const mock_wrapper{
+        std::make_shared<testing::NiceMock<mtd::MockHWCDeviceWrapper>>()};
+    mga::DisplayName const display{mga::DisplayName::primary};
+    mga::ConfigId const config{4};
+    mga::ConfigId const idle_config{7};
+    std::chrono::milliseconds const idle_time{5};
+};
+}
+
+TEST_F(IdleRefresh, drops_to_the_idle_config_and_back_for_the_next_frame)
+{
+    using namespace testing;
+    std::promise<void> idled;
+    EXPECT_CALL(*mock_wrapper, set_active_config(display, idle_config))
+        .WillOnce(InvokeWithoutArgs([&] { idled.set_value(); }))
+        .WillRepeatedly(Return());
+    EXPECT_CALL(*mock_wrapper, set_active_config(display, config))
+        .Times(AtLeast(1));
+
+    {
+        mga::IdleRefresh idle_refresh(mock_wrapper, idle_time);
+        EXPECT_THAT(idle_refresh.track(display, config, idle_config), Eq(config));
+        ASSERT_THAT(idled.get_future().wait_for(std::chrono::seconds{5}), Eq(std::future_status::ready));
+
+        //the hwc reports the idle config while idle, but frames are posted at the other one
+        EXPECT_THAT(idle_refresh.track(display, idle_config, idle_config), Eq(config));
+        idle_refresh.frame_posted(display);
+    }
+}
+
+TEST_F(IdleRefresh, leaves_displays_that_are_off_or_have_no_lower_rate)
+{
+    using namespace testing;
+    EXPECT_CALL(*mock_wrapper, set_active_config(_,_))
+        .Times(0);
+
+    mga::IdleRefresh idle_refresh(mock_wrapper, idle_time);
+    idle_refresh.track(mga::DisplayName::external, config, config);
+    idle_refresh.display_off(display);
+    idle_refresh.track(display, config, idle_config);
+    std::this_thread::sleep_for(idle_time * 4);
+}
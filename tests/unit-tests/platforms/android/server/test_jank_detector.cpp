@@ -0,0 +1,184 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/platforms/android/server/jank_detector.h"
+#include "mir/test/doubles/mock_hwc_report.h"
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+namespace mga = mir::graphics::android;
+namespace mtd = mir::test::doubles;
+using namespace std::chrono;
+
+namespace
+{
+struct JankDetector : public testing::Test
+{
+    JankDetector()
+    {
+        detector.vsync(primary, milliseconds{16});
+        detector.vsync(primary, milliseconds{32});
+    }
+
+    mga::JankDetector::CommitTimes commit_at(milliseconds start)
+    {
+        return {start, start + milliseconds{1}, start + milliseconds{2}, start + milliseconds{3}};
+    }
+
+    std::shared_ptr<testing::NiceMock<mtd::MockHwcReport>> const mock_report{
+        std::make_shared<testing::NiceMock<mtd::MockHwcReport>>()};
+    mga::JankDetector detector{mock_report};
+    mga::DisplayName const primary{mga::DisplayName::primary};
+};
+}
+
+TEST_F(JankDetector, counts_frames_presented_on_the_vsync_after_their_commit_as_on_time)
+{
+    using namespace testing;
+    EXPECT_CALL(*mock_report, report_missed_deadline(_,_,_,_))
+        .Times(0);
+
+    auto const frame = detector.committed(primary, commit_at(milliseconds{35}));
+    detector.vsync(primary, milliseconds{48});
+    detector.presented(primary, frame, milliseconds{48});
+    detector.vsync(primary, milliseconds{64});
+
+    auto const histogram = detector.histogram(primary);
+    EXPECT_THAT(histogram.on_time, Eq(1u));
+    EXPECT_THAT(histogram.late, Eq(0u));
+    EXPECT_THAT(histogram.skipped, Eq(0u));
+}
+
+TEST_F(JankDetector, counts_frames_on_time_once_it_has_learned_a_lower_rate)
+{
+    using namespace testing;
+    auto vsync = milliseconds{32};
+    for (int i = 0; i < 4; i++)
+    {
+        vsync += milliseconds{33};
+        detector.vsync(primary, vsync);
+    }
+
+    auto const frame = detector.committed(primary, commit_at(vsync + milliseconds{3}));
+    detector.vsync(primary, vsync + milliseconds{33});
+    detector.presented(primary, frame, vsync + milliseconds{33});
+    detector.vsync(primary, vsync + milliseconds{66});
+
+    auto const histogram = detector.histogram(primary);
+    EXPECT_THAT(histogram.on_time, Eq(1u));
+    EXPECT_THAT(histogram.late, Eq(0u));
+}
+
+TEST_F(JankDetector, reports_late_frames_with_the_stage_that_held_them_up)
+{
+    using namespace testing;
+    EXPECT_CALL(*mock_report, report_missed_deadline(
+        primary, mga::FrameOutcome::late, mga::FrameStage::gl_fallback, nanoseconds{milliseconds{16}}));
+
+    mga::JankDetector::CommitTimes const times{
+        milliseconds{35}, milliseconds{36}, milliseconds{50}, milliseconds{51}};
+    auto const frame = detector.committed(primary, times);
+    detector.vsync(primary, milliseconds{48});
+    detector.vsync(primary, milliseconds{64});
+    detector.presented(primary, frame, milliseconds{64});
+    detector.vsync(primary, milliseconds{80});
+
+    auto const histogram = detector.histogram(primary);
+    EXPECT_THAT(histogram.late, Eq(1u));
+    EXPECT_THAT(histogram.vsyncs_missed[0], Eq(1u));
+}
+
+TEST_F(JankDetector, blames_the_fence_wait_for_frames_committed_in_time_but_shown_late)
+{
+    using namespace testing;
+    EXPECT_CALL(*mock_report, report_missed_deadline(
+        primary, mga::FrameOutcome::late, mga::FrameStage::fence_wait, _));
+
+    auto const frame = detector.committed(primary, commit_at(milliseconds{35}));
+    detector.vsync(primary, milliseconds{48});
+    detector.vsync(primary, milliseconds{64});
+    detector.vsync(primary, milliseconds{80});
+    detector.presented(primary, frame, milliseconds{80});
+    detector.vsync(primary, milliseconds{96});
+
+    EXPECT_THAT(detector.histogram(primary).vsyncs_missed[1], Eq(1u));
+}
+
+TEST_F(JankDetector, counts_frames_replaced_on_the_same_vsync_as_skipped)
+{
+    using namespace testing;
+    EXPECT_CALL(*mock_report, report_missed_deadline(primary, mga::FrameOutcome::skipped, _, _));
+
+    auto const frame1 = detector.committed(primary, commit_at(milliseconds{35}));
+    auto const frame2 = detector.committed(primary, commit_at(milliseconds{40}));
+    detector.vsync(primary, milliseconds{48});
+    detector.presented(primary, frame1, milliseconds{48});
+    detector.presented(primary, frame2, milliseconds{48});
+    detector.vsync(primary, milliseconds{64});
+
+    auto const histogram = detector.histogram(primary);
+    EXPECT_THAT(histogram.skipped, Eq(1u));
+    EXPECT_THAT(histogram.on_time, Eq(1u));
+}
+
+TEST_F(JankDetector, ignores_frames_committed_before_the_vsync_rate_is_known)
+{
+    using namespace testing;
+    mga::JankDetector fresh_detector{mock_report};
+    auto const frame = fresh_detector.committed(primary, commit_at(milliseconds{35}));
+    fresh_detector.presented(primary, frame, milliseconds{48});
+    fresh_detector.vsync(primary, milliseconds{64});
+
+    auto const histogram = fresh_detector.histogram(primary);
+    EXPECT_THAT(histogram.on_time + histogram.late + histogram.skipped, Eq(0u));
+}
+
+TEST_F(JankDetector, passes_over_frames_that_were_never_seen_presented)
+{
+    using namespace testing;
+    EXPECT_CALL(*mock_report, report_missed_deadline(_,_,_,_))
+        .Times(0);
+
+    //the retire fence of the first frame was not waited for
+    detector.committed(primary, commit_at(milliseconds{20}));
+    auto const frame = detector.committed(primary, commit_at(milliseconds{35}));
+    detector.vsync(primary, milliseconds{48});
+    detector.presented(primary, frame, milliseconds{48});
+    detector.vsync(primary, milliseconds{64});
+
+    auto const histogram = detector.histogram(primary);
+    EXPECT_THAT(histogram.on_time, Eq(1u));
+    EXPECT_THAT(histogram.skipped, Eq(0u));
+}
+
+TEST_F(JankDetector, reports_the_histogram_every_few_seconds_of_frames)
+{
+    using namespace testing;
+    auto const frames = 300;
+    EXPECT_CALL(*mock_report, report_frame_histogram(primary,
+        AllOf(Field(&mga::FrameHistogram::on_time, Eq(static_cast<unsigned int>(frames))),
+              Field(&mga::FrameHistogram::late, Eq(0u)))));
+
+    auto vsync = milliseconds{32};
+    for (auto i = 0; i < frames; i++)
+    {
+        auto const frame = detector.committed(primary, commit_at(vsync + milliseconds{3}));
+        vsync += milliseconds{16};
+        detector.vsync(primary, vsync);
+        detector.presented(primary, frame, vsync);
+    }
+    detector.vsync(primary, vsync + milliseconds{16});
+}
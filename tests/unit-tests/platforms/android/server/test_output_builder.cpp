@@ -24,6 +24,7 @@
 #include "src/platforms/android/server/fb_device.h"
 #include "src/platforms/android/server/device_quirks.h"
 #include "src/platforms/android/server/hwc_layerlist.h"
+#include "src/platforms/android/server/hwc_cursor.h"
 #include "mir/test/doubles/mock_buffer.h"
 #include "mir/test/doubles/mock_display_report.h"
 #include "mir/test/fake_shared.h"
@@ -164,6 +165,26 @@ TEST_F(HalComponentFactory, allocates_correct_hwc_configuration_for_hwc_version_
     EXPECT_THAT(dynamic_cast<mga::HwcPowerModeControl*>(hwc_config.get()), Ne(nullptr));
 }
 
+TEST_F(HalComponentFactory, creates_cursor_for_hwc_version_14_and_later)
+{
+    using namespace testing;
+    EXPECT_CALL(*mock_resource_factory, create_hwc_wrapper(_))
+        .WillOnce(Return(std::make_tuple(mock_wrapper, mga::HwcVersion::hwc13)))
+        .WillOnce(Return(std::make_tuple(mock_wrapper, mga::HwcVersion::hwc14)));
+
+    mga::HalComponentFactory hwc13_factory(
+        mock_resource_factory,
+        mock_hwc_report,
+        quirks);
+    EXPECT_THAT(hwc13_factory.create_cursor(), Eq(nullptr));
+
+    mga::HalComponentFactory hwc14_factory(
+        mock_resource_factory,
+        mock_hwc_report,
+        quirks);
+    EXPECT_THAT(hwc14_factory.create_cursor(), Ne(nullptr));
+}
+
 TEST_F(HalComponentFactory, hwc_failure_falls_back_to_fb)
 {
     using namespace testing;
@@ -0,0 +1,51 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/platforms/android/server/render_thread.h"
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <stdexcept>
+#include <thread>
+
+namespace mga=mir::graphics::android;
+
+TEST(RenderThread, runs_tasks_on_the_same_other_thread)
+{
+    using namespace testing;
+    mga::RenderThread render_thread;
+    std::thread::id first_thread;
+    std::thread::id second_thread;
+
+    render_thread.run([&] { first_thread = std::this_thread::get_id(); });
+    render_thread.wait();
+    render_thread.run([&] { second_thread = std::this_thread::get_id(); });
+    render_thread.wait();
+
+    EXPECT_THAT(first_thread, Ne(std::this_thread::get_id()));
+    EXPECT_THAT(second_thread, Eq(first_thread));
+}
+
+TEST(RenderThread, rethrows_task_errors_on_wait)
+{
+    mga::RenderThread render_thread;
+    render_thread.run([] { throw std::runtime_error("render failed"); });
+    EXPECT_THROW({
+        render_thread.wait();
+    }, std::runtime_error);
+
+    render_thread.run([] {});
+    EXPECT_NO_THROW(render_thread.wait());
+}
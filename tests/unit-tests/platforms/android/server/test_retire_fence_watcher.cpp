@@ -0,0 +1,171 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/platforms/android/server/retire_fence_watcher.h"
+#include "sync_fence.h"
+
+#include <android/linux/sync.h>
+#include <fcntl.h>
+#include <atomic>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+namespace mg = mir::graphics;
+namespace mga = mir::graphics::android;
+
+namespace
+{
+struct MockFileOps : public mga::SyncFileOps
+{
+    MOCK_METHOD3(ioctl, int(int,int,void*));
+    MOCK_METHOD1(dup, int(int));
+    MOCK_METHOD1(close, int(int));
+};
+
+struct RetireFenceWatcher : public testing::Test
+{
+    RetireFenceWatcher()
+    {
+        using namespace testing;
+        ON_CALL(*mock_ops, ioctl(_, SYNC_IOC_FENCE_INFO, _))
+            .WillByDefault(Invoke([this](int, int, void* data)
+            {
+                //a fence merged from two points, the later of which signalled last
+                auto info = static_cast<sync_fence_info_data*>(data);
+                info->status = 1;
+                info->len = sizeof(sync_fence_info_data) + 2 * sizeof(sync_pt_info);
+                for (auto i = 0u; i < 2; i++)
+                {
+                    sync_pt_info point;
+                    memset(&point, 0, sizeof(point));
+                    point.len = sizeof(sync_pt_info);
+                    point.status = 1;
+                    point.timestamp_ns = point_times[i];
+                    memcpy(info->pt_info + i * sizeof(sync_pt_info), &point, sizeof(point));
+                }
+                return 0;
+            }));
+    }
+
+    mir::Fd fence()
+    {
+        return mir::Fd{open("/dev/null", O_RDONLY)};
+    }
+
+    uint64_t const point_times[2]{16000000, 33000000};
+    std::shared_ptr<testing::NiceMock<MockFileOps>> const mock_ops{
+        std::make_shared<testing::NiceMock<MockFileOps>>()};
+};
+}
+
+TEST_F(RetireFenceWatcher, reports_when_the_retire_fence_signalled)
+{
+    using namespace testing;
+    std::promise<std::tuple<mga::DisplayName, uint64_t, mg::Frame::Timestamp>> presented;
+    mga::RetireFenceWatcher watcher(mock_ops);
+    watcher.set_callback([&](mga::DisplayName name, uint64_t frame, mg::Frame::Timestamp time)
+        {
+            presented.set_value(std::make_tuple(name, frame, time));
+        });
+
+    watcher.watch(mga::DisplayName::external, 7, fence());
+
+    auto result = presented.get_future();
+    ASSERT_THAT(result.wait_for(std::chrono::seconds{5}), Eq(std::future_status::ready));
+    auto const present = result.get();
+    EXPECT_THAT(std::get<0>(present), Eq(mga::DisplayName::external));
+    EXPECT_THAT(std::get<1>(present), Eq(7u));
+    EXPECT_THAT(std::get<2>(present).nanoseconds, Eq(std::chrono::nanoseconds{point_times[1]}));
+}
+
+TEST_F(RetireFenceWatcher, does_not_wait_on_fences_without_a_callback)
+{
+    using namespace testing;
+    EXPECT_CALL(*mock_ops, ioctl(_,_,_))
+        .Times(0);
+
+    mga::RetireFenceWatcher watcher(mock_ops);
+    watcher.watch(mga::DisplayName::primary, 1, fence());
+    watcher.watch(mga::DisplayName::primary, 2, mir::Fd{-1});
+}
+
+TEST_F(RetireFenceWatcher, does_not_report_fences_that_did_not_signal)
+{
+    using namespace testing;
+    std::promise<void> waited;
+    ON_CALL(*mock_ops, ioctl(_, SYNC_IOC_WAIT, _))
+        .WillByDefault(Invoke([&](int, int, void*)
+        {
+            waited.set_value();
+            return -1;
+        }));
+    bool reported{false};
+
+    {
+        mga::RetireFenceWatcher watcher(mock_ops);
+        watcher.set_callback([&](mga::DisplayName, uint64_t, mg::Frame::Timestamp) { reported = true; });
+        watcher.watch(mga::DisplayName::primary, 1, fence());
+        waited.get_future().wait_for(std::chrono::seconds{5});
+    }
+
+    EXPECT_FALSE(reported);
+}
+
+TEST_F(RetireFenceWatcher, gives_up_on_the_oldest_fences_while_a_fence_does_not_signal)
+{
+    using namespace testing;
+    std::promise<void> wait_started;
+    std::promise<void> signal;
+    auto const signalled = signal.get_future().share();
+    std::atomic<bool> first_wait{true};
+    ON_CALL(*mock_ops, ioctl(_, SYNC_IOC_WAIT, _))
+        .WillByDefault(Invoke([&](int, int, void*)
+        {
+            if (first_wait.exchange(false))
+            {
+                wait_started.set_value();
+                signalled.wait();
+            }
+            return 0;
+        }));
+
+    std::mutex mutex;
+    std::vector<uint64_t> reported;
+    std::promise<void> last_reported;
+    mga::RetireFenceWatcher watcher(mock_ops);
+    watcher.set_callback([&](mga::DisplayName, uint64_t frame, mg::Frame::Timestamp)
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            reported.push_back(frame);
+            if (frame == 11)
+                last_reported.set_value();
+        });
+
+    watcher.watch(mga::DisplayName::primary, 1, fence());
+    wait_started.get_future().wait();
+    for (auto frame = 2u; frame <= 11u; frame++)
+        watcher.watch(mga::DisplayName::primary, frame, fence());
+    signal.set_value();
+
+    ASSERT_THAT(last_reported.get_future().wait_for(std::chrono::seconds{5}), Eq(std::future_status::ready));
+    std::lock_guard<std::mutex> lk(mutex);
+    EXPECT_THAT(reported, ElementsAre(1u, 8u, 9u, 10u, 11u));
+}
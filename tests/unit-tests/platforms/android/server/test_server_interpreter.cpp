@@ -200,9 +200,12 @@ TEST_F(ServerRenderWindow, throws_on_driver_unknown_inquiry)
     }, std::runtime_error);
 }
 
-TEST_F(ServerRenderWindow, reacts_to_buffer_age_query)
+TEST_F(ServerRenderWindow, reports_buffer_age_of_framebuffer)
 {
-    EXPECT_NO_THROW(render_window.driver_requests_info(NATIVE_WINDOW_BUFFER_AGE));
+    using namespace testing;
+    EXPECT_CALL(*mock_fb_bundle, buffer_age())
+        .WillOnce(Return(2u));
+    EXPECT_THAT(render_window.driver_requests_info(NATIVE_WINDOW_BUFFER_AGE), Eq(2));
 }
 
 TEST_F(ServerRenderWindow, reacts_to_queue_duration_queries)
@@ -0,0 +1,66 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/platforms/android/server/sleep_estimator.h"
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+namespace mga = mir::graphics::android;
+using namespace std::chrono;
+using namespace testing;
+
+TEST(SleepEstimator, sleeps_until_the_commit_would_just_make_the_vsync)
+{
+    mga::SleepEstimator estimator;
+    for (int i = 0; i < 10; i++)
+        estimator.frame_took(milliseconds{3});
+
+    EXPECT_THAT(estimator.sleep_before(milliseconds{16}), Eq(milliseconds{11}));
+}
+
+TEST(SleepEstimator, does_not_sleep_if_commits_take_too_long)
+{
+    mga::SleepEstimator estimator;
+    estimator.frame_took(milliseconds{15});
+
+    EXPECT_THAT(estimator.sleep_before(milliseconds{16}), Eq(milliseconds{0}));
+}
+
+TEST(SleepEstimator, allows_for_all_but_the_slowest_commits)
+{
+    mga::SleepEstimator estimator;
+    for (int i = 0; i < 18; i++)
+        estimator.frame_took(milliseconds{2});
+    estimator.frame_took(milliseconds{5});
+    estimator.frame_took(milliseconds{12});
+
+    EXPECT_THAT(estimator.expected_frame_duration(), Eq(nanoseconds{milliseconds{2}}));
+
+    for (int i = 0; i < 10; i++)
+        estimator.frame_took(milliseconds{5});
+    EXPECT_THAT(estimator.expected_frame_duration(), Eq(nanoseconds{milliseconds{5}}));
+}
+
+TEST(SleepEstimator, forgets_old_commits)
+{
+    mga::SleepEstimator estimator;
+    for (int i = 0; i < 60; i++)
+        estimator.frame_took(milliseconds{10});
+    for (int i = 0; i < 60; i++)
+        estimator.frame_took(milliseconds{1});
+
+    EXPECT_THAT(estimator.expected_frame_duration(), Eq(nanoseconds{milliseconds{1}}));
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/platforms/android/server/vsync_demand.h"
+#include "mir/test/doubles/mock_hwc_device_wrapper.h"
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <future>
+
+namespace mga = mir::graphics::android;
+namespace mtd = mir::test::doubles;
+
+namespace
+{
+struct VsyncDemand : public testing::Test
+{
+    void expect_vsync_signal_off(std::promise<void>& turned_off)
+    {
+        using namespace testing;
+        EXPECT_CALL(*mock_wrapper, vsync_signal_off(primary))
+            .WillOnce(InvokeWithoutArgs([&turned_off] { turned_off.set_value(); }));
+    }
+
+    bool wait_for(std::promise<void>& promise)
+    {
+        return promise.get_future().wait_for(std::chrono::seconds{5}) == std::future_status::ready;
+    }
+
+    std::shared_ptr<testing::NiceMock<mtd::MockHWCDeviceWrapper>> const mock_wrapper{
+        std::make_shared<testing::NiceMock<mtd::MockHWCDeviceWrapper>>()};
+    unsigned int const idle_frames{3};
+    mga::DisplayName const primary{mga::DisplayName::primary};
+};
+}
+
+TEST_F(VsyncDemand, turns_vsync_on_with_the_display_and_off_once_it_is_idle)
+{
+    using namespace testing;
+    mga::VsyncDemand demand(mock_wrapper, idle_frames);
+    EXPECT_CALL(*mock_wrapper, vsync_signal_on(primary));
+    demand.display_on(primary);
+    Mock::VerifyAndClearExpectations(mock_wrapper.get());
+
+    std::promise<void> turned_off;
+    expect_vsync_signal_off(turned_off);
+    for (auto i = 0u; i < idle_frames; i++)
+        demand.vsync(primary);
+
+    EXPECT_TRUE(wait_for(turned_off));
+}
+
+TEST_F(VsyncDemand, keeps_vsync_on_for_the_frames_requested)
+{
+    using namespace testing;
+    mga::VsyncDemand demand(mock_wrapper, idle_frames);
+    demand.display_on(primary);
+    demand.request(primary, 2);
+
+    EXPECT_CALL(*mock_wrapper, vsync_signal_off(_))
+        .Times(0);
+    for (auto i = 0u; i < idle_frames + 1; i++)
+        demand.vsync(primary);
+    Mock::VerifyAndClearExpectations(mock_wrapper.get());
+
+    std::promise<void> turned_off;
+    expect_vsync_signal_off(turned_off);
+    demand.vsync(primary);
+    EXPECT_TRUE(wait_for(turned_off));
+}
+
+TEST_F(VsyncDemand, turns_vsync_back_on_when_frames_are_requested)
+{
+    using namespace testing;
+    mga::VsyncDemand demand(mock_wrapper, idle_frames);
+    demand.display_on(primary);
+
+    std::promise<void> turned_off;
+    expect_vsync_signal_off(turned_off);
+    for (auto i = 0u; i < idle_frames; i++)
+        demand.vsync(primary);
+    ASSERT_TRUE(wait_for(turned_off));
+
+    std::promise<void> turned_on;
+    EXPECT_CALL(*mock_wrapper, vsync_signal_on(primary))
+        .WillOnce(InvokeWithoutArgs([&turned_on] { turned_on.set_value(); }));
+    demand.request(primary, 1);
+    EXPECT_TRUE(wait_for(turned_on));
+}
+
+TEST_F(VsyncDemand, leaves_vsync_off_while_the_display_is_off)
+{
+    using namespace testing;
+    mga::VsyncDemand demand(mock_wrapper, idle_frames);
+    demand.display_on(primary);
+    EXPECT_CALL(*mock_wrapper, vsync_signal_off(primary));
+    demand.display_off(primary);
+    Mock::VerifyAndClearExpectations(mock_wrapper.get());
+
+    EXPECT_CALL(*mock_wrapper, vsync_signal_on(_))
+        .Times(0);
+    demand.request(primary, 1);
+}
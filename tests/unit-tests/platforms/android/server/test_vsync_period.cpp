@@ -0,0 +1,74 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/platforms/android/server/vsync_period.h"
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+namespace mga = mir::graphics::android;
+using namespace std::chrono;
+using namespace testing;
+
+TEST(VsyncPeriod, learns_the_period_from_the_first_interval)
+{
+    mga::VsyncPeriod period;
+    EXPECT_THAT(period.period(), Eq(nanoseconds{0}));
+
+    EXPECT_THAT(period.vsyncs_in(milliseconds{16}), Eq(1));
+    EXPECT_THAT(period.period(), Eq(nanoseconds{milliseconds{16}}));
+}
+
+TEST(VsyncPeriod, counts_the_vsyncs_that_were_not_delivered)
+{
+    mga::VsyncPeriod period;
+    period.vsyncs_in(milliseconds{16});
+
+    EXPECT_THAT(period.vsyncs_in(milliseconds{64}), Eq(4));
+    EXPECT_THAT(period.period(), Eq(nanoseconds{milliseconds{16}}));
+}
+
+TEST(VsyncPeriod, learns_a_lower_rate_from_a_few_long_intervals_of_the_same_length)
+{
+    mga::VsyncPeriod period;
+    period.vsyncs_in(milliseconds{16});
+
+    for (int i = 0; i < 3; i++)
+        EXPECT_THAT(period.vsyncs_in(milliseconds{33}), Eq(2));
+    EXPECT_THAT(period.vsyncs_in(milliseconds{33}), Eq(1));
+    EXPECT_THAT(period.period(), Eq(nanoseconds{milliseconds{33}}));
+    EXPECT_THAT(period.vsyncs_in(milliseconds{33}), Eq(1));
+}
+
+TEST(VsyncPeriod, keeps_the_period_through_gaps_of_different_lengths)
+{
+    mga::VsyncPeriod period;
+    period.vsyncs_in(milliseconds{16});
+
+    for (auto gap : {33, 45, 33, 40, 33, 45})
+        period.vsyncs_in(milliseconds{gap});
+    EXPECT_THAT(period.period(), Eq(nanoseconds{milliseconds{16}}));
+}
+
+TEST(VsyncPeriod, learns_the_period_again_after_a_reset)
+{
+    mga::VsyncPeriod period;
+    period.vsyncs_in(milliseconds{16});
+
+    period.reset();
+    EXPECT_THAT(period.period(), Eq(nanoseconds{0}));
+    EXPECT_THAT(period.vsyncs_in(milliseconds{33}), Eq(1));
+    EXPECT_THAT(period.period(), Eq(nanoseconds{milliseconds{33}}));
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/platforms/android/server/vsync_queue.h"
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <thread>
+#include <vector>
+
+namespace mg = mir::graphics;
+namespace mga = mir::graphics::android;
+using namespace testing;
+
+namespace
+{
+mga::VsyncQueue::Vsync vsync_at(long nanoseconds)
+{
+    return {mga::DisplayName::primary, mg::Frame::Timestamp{CLOCK_MONOTONIC, std::chrono::nanoseconds{nanoseconds}}};
+}
+}
+
+TEST(VsyncQueue, pops_vsyncs_in_the_order_they_were_pushed)
+{
+    mga::VsyncQueue queue;
+    mga::VsyncQueue::Vsync vsync;
+    EXPECT_FALSE(queue.pop(vsync));
+
+    EXPECT_TRUE(queue.push(vsync_at(1)));
+    EXPECT_TRUE(queue.push({mga::DisplayName::external, mg::Frame::Timestamp{CLOCK_MONOTONIC, std::chrono::nanoseconds{2}}}));
+
+    ASSERT_TRUE(queue.pop(vsync));
+    EXPECT_THAT(vsync.name, Eq(mga::DisplayName::primary));
+    EXPECT_THAT(vsync.timestamp.nanoseconds.count(), Eq(1));
+    ASSERT_TRUE(queue.pop(vsync));
+    EXPECT_THAT(vsync.name, Eq(mga::DisplayName::external));
+    EXPECT_THAT(vsync.timestamp.nanoseconds.count(), Eq(2));
+    EXPECT_FALSE(queue.pop(vsync));
+    EXPECT_THAT(queue.pushed(), Eq(2u));
+}
+
+TEST(VsyncQueue, drops_vsyncs_that_do_not_fit)
+{
+    mga::VsyncQueue queue;
+    auto pushed = 0;
+    while (queue.push(vsync_at(pushed)))
+        pushed++;
+    EXPECT_THAT(pushed, Gt(0));
+
+    mga::VsyncQueue::Vsync vsync;
+    ASSERT_TRUE(queue.pop(vsync));
+    EXPECT_THAT(vsync.timestamp.nanoseconds.count(), Eq(0));
+    EXPECT_TRUE(queue.push(vsync_at(pushed)));
+}
+
+TEST(VsyncQueue, passes_vsyncs_between_threads)
+{
+    mga::VsyncQueue queue;
+    long const vsyncs{1000};
+
+    std::thread producer([&]
+    {
+        for (long i = 0; i < vsyncs;)
+        {
+            if (queue.push(vsync_at(i)))
+                i++;
+            else
+                std::this_thread::yield();
+        }
+    });
+
+    long next{0};
+    mga::VsyncQueue::Vsync vsync;
+    while (next < vsyncs)
+    {
+        if (!queue.pop(vsync))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_THAT(vsync.timestamp.nanoseconds.count(), Eq(next));
+        next++;
+    }
+    producer.join();
+}
+
+//the hwc may deliver the vsyncs of each display on a thread of its own
+TEST(VsyncQueue, takes_vsyncs_from_several_threads)
+{
+    mga::VsyncQueue queue;
+    long const vsyncs{1000};
+    long const producers{3};
+
+    std::vector<std::thread> threads;
+    for (long p = 0; p < producers; p++)
+    {
+        threads.emplace_back([&queue, p]
+        {
+            for (long i = 0; i < vsyncs;)
+            {
+                if (queue.push(vsync_at(p * vsyncs + i)))
+                    i++;
+                else
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<long> next(producers, 0);
+    long popped{0};
+    mga::VsyncQueue::Vsync vsync;
+    while (popped < producers * vsyncs)
+    {
+        if (!queue.pop(vsync))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        auto const value = vsync.timestamp.nanoseconds.count();
+        auto const producer = value / vsyncs;
+        EXPECT_THAT(value % vsyncs, Eq(next[producer]));
+        next[producer] = value % vsyncs + 1;
+        popped++;
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_THAT(queue.pushed(), Eq(static_cast<uint64_t>(producers * vsyncs)));
+}